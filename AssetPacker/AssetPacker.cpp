@@ -0,0 +1,77 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::vector<uint8_t> readWholeFile(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + path.string() + "!");
+    }
+    std::vector<uint8_t> data(static_cast<size_t>(std::filesystem::file_size(path)));
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file)
+    {
+        throw std::runtime_error("failed to read " + path.string() + "!");
+    }
+    return data;
+}
+
+// Adds every file below directory, named by its path relative to directory.
+void collectAssets(const std::filesystem::path &directory, std::vector<AssetPack::Asset> &assets)
+{
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(directory))
+    {
+        if (entry.is_regular_file())
+        {
+            AssetPack::Asset asset;
+            asset.name = entry.path().lexically_relative(directory).generic_string();
+            asset.data = readWholeFile(entry.path());
+            assets.push_back(std::move(asset));
+        }
+    }
+}
+} // namespace
+
+// Usage: AssetPacker <output pack> <directory>...
+// Names must be unique across all the directories.
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <output pack> <directory>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        std::vector<AssetPack::Asset> assets;
+        for (int i = 2; i < argc; i++)
+        {
+            collectAssets(argv[i], assets);
+        }
+        size_t totalSize = 0;
+        for (const AssetPack::Asset &asset : assets)
+        {
+            totalSize += asset.data.size();
+        }
+        AssetPack::write(argv[1], std::move(assets));
+        std::cout << "Packed " << totalSize << " bytes into " << argv[1] << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
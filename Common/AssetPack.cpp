@@ -0,0 +1,236 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+constexpr char fileMagic[8] = {'A', 'S', 'S', 'E', 'T', 'P', 'A', 'K'};
+constexpr uint32_t fileVersion = 1;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+AssetPack::AssetPack(const std::string &path)
+{
+    map(path);
+    try
+    {
+        validate(path);
+    }
+    catch (...)
+    {
+        unmap();
+        throw;
+    }
+}
+
+AssetPack::~AssetPack()
+{
+    unmap();
+}
+
+bool AssetPack::contains(std::string_view name) const
+{
+    return find(name) != nullptr;
+}
+
+std::span<const uint8_t> AssetPack::get(std::string_view name) const
+{
+    const TocEntry *entry = find(name);
+    if (entry == nullptr)
+    {
+        throw std::runtime_error("asset not found: " + std::string(name));
+    }
+    return {data + entry->offset, static_cast<size_t>(entry->size)};
+}
+
+size_t AssetPack::getAssetCount() const
+{
+    return entries.size();
+}
+
+void AssetPack::write(const std::string &path, std::vector<Asset> assets)
+{
+    std::sort(assets.begin(), assets.end(), [](const Asset &a, const Asset &b) { return a.name < b.name; });
+    for (size_t i = 1; i < assets.size(); i++)
+    {
+        if (assets[i].name == assets[i - 1].name)
+        {
+            throw std::runtime_error("duplicate asset name: " + assets[i].name);
+        }
+    }
+
+    std::vector<TocEntry> toc(assets.size());
+    std::string nameTable;
+    for (size_t i = 0; i < assets.size(); i++)
+    {
+        toc[i].nameOffset = static_cast<uint32_t>(nameTable.size());
+        toc[i].nameLength = static_cast<uint32_t>(assets[i].name.size());
+        nameTable += assets[i].name;
+    }
+
+    FileHeader header{};
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.entryCount = static_cast<uint32_t>(assets.size());
+    header.namesOffset = sizeof(FileHeader) + sizeof(TocEntry) * toc.size();
+    uint64_t offset = header.namesOffset + nameTable.size();
+    for (size_t i = 0; i < assets.size(); i++)
+    {
+        toc[i].offset = alignUp(offset, dataAlignment);
+        toc[i].size = assets[i].data.size();
+        offset = toc[i].offset + toc[i].size;
+    }
+    header.fileSize = offset;
+
+    // Same as PipelineCache::save: never leave a half written pack under the real name.
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open " + temporaryPath + "!");
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(toc.data()),
+                   static_cast<std::streamsize>(sizeof(TocEntry) * toc.size()));
+        file.write(nameTable.data(), static_cast<std::streamsize>(nameTable.size()));
+        uint64_t position = header.namesOffset + nameTable.size();
+        const char padding[dataAlignment] = {};
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            file.write(padding, static_cast<std::streamsize>(toc[i].offset - position));
+            file.write(reinterpret_cast<const char *>(assets[i].data.data()),
+                       static_cast<std::streamsize>(assets[i].data.size()));
+            position = toc[i].offset + toc[i].size;
+        }
+        if (!file)
+        {
+            throw std::runtime_error("failed to write " + temporaryPath + "!");
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        throw std::runtime_error("failed to replace " + path + ": " + error.message());
+    }
+}
+
+void AssetPack::map(const std::string &path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("failed to open asset pack " + path + "!");
+    }
+    LARGE_INTEGER fileSize{};
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    // The view keeps the mapping alive, neither handle is needed once it exists.
+    HANDLE mapping = size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        throw std::runtime_error("failed to map asset pack " + path + "!");
+    }
+    data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw std::runtime_error("failed to open asset pack " + path + "!");
+    }
+    struct stat status{};
+    fstat(file, &status);
+    size = static_cast<size_t>(status.st_size);
+    void *mapping = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    // The mapping holds its own reference to the file.
+    close(file);
+    data = mapping != MAP_FAILED ? static_cast<const uint8_t *>(mapping) : nullptr;
+#endif
+    if (data == nullptr)
+    {
+        throw std::runtime_error("failed to map asset pack " + path + "!");
+    }
+}
+
+void AssetPack::unmap()
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<uint8_t *>(data), size);
+#endif
+    data = nullptr;
+}
+
+void AssetPack::validate(const std::string &path)
+{
+    // Everything is checked once here so lookups can trust the table of contents.
+    FileHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("invalid asset pack " + path + "!");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version != fileVersion ||
+        header.fileSize != size || header.namesOffset < sizeof(FileHeader) || header.namesOffset > size ||
+        (header.namesOffset - sizeof(FileHeader)) / sizeof(TocEntry) < header.entryCount)
+    {
+        throw std::runtime_error("invalid asset pack " + path + "!");
+    }
+
+    entries = {reinterpret_cast<const TocEntry *>(data + sizeof(FileHeader)), header.entryCount};
+    names = reinterpret_cast<const char *>(data + header.namesOffset);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const TocEntry &entry = entries[i];
+        if (header.namesOffset + entry.nameOffset + entry.nameLength > size || entry.offset > size ||
+            entry.size > size - entry.offset || (i > 0 && getName(entries[i - 1]) >= getName(entry)))
+        {
+            throw std::runtime_error("invalid asset pack " + path + "!");
+        }
+    }
+}
+
+std::string_view AssetPack::getName(const TocEntry &entry) const
+{
+    return {names + entry.nameOffset, entry.nameLength};
+}
+
+const AssetPack::TocEntry *AssetPack::find(std::string_view name) const
+{
+    auto isBefore = [this](const TocEntry &entry, std::string_view value) { return getName(entry) < value; };
+    auto it = std::lower_bound(entries.begin(), entries.end(), name, isBefore);
+    if (it == entries.end() || getName(*it) != name)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A read-only archive of every asset an application loads, memory-mapped for its whole lifetime. get() hands out
+// spans straight into the mapping, so shader code goes to vkCreateShaderModule and buffer contents to the staging
+// upload without being copied into an intermediate std::vector first.
+//
+// Layout: a FileHeader, a table of contents sorted by name, the names, then the blobs. Every blob starts on a
+// dataAlignment boundary, which covers the 4 byte alignment pCode needs as well as anything copied with SIMD.
+class AssetPack
+{
+  public:
+    static constexpr uint64_t dataAlignment = 64;
+
+    struct Asset
+    {
+        // Relative path with '/' separators, e.g. "shaders/shader.vert.spv".
+        std::string name;
+        std::vector<uint8_t> data;
+    };
+
+    // Maps the pack at path, throws if it can not be opened or is not a valid pack.
+    explicit AssetPack(const std::string &path);
+    ~AssetPack();
+
+    AssetPack(const AssetPack &) = delete;
+    AssetPack &operator=(const AssetPack &) = delete;
+
+    bool contains(std::string_view name) const;
+    // The asset's bytes, valid as long as the pack. Throws if there is no asset with that name.
+    std::span<const uint8_t> get(std::string_view name) const;
+    size_t getAssetCount() const;
+
+    // Writes a pack holding assets to path, replacing any existing file. Names must be unique.
+    static void write(const std::string &path, std::vector<Asset> assets);
+
+  private:
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t namesOffset;
+        uint64_t fileSize;
+    };
+
+    struct TocEntry
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+    };
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    std::span<const TocEntry> entries;
+    const char *names = nullptr;
+
+    void map(const std::string &path);
+    void unmap();
+    void validate(const std::string &path);
+    std::string_view getName(const TocEntry &entry) const;
+    const TocEntry *find(std::string_view name) const;
+};
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "CacheFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+uint64_t CacheFile::hash(const char *data, size_t size)
+{
+    uint64_t value = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        value = (value ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+    return value;
+}
+
+bool CacheFile::write(const std::string &path, const std::string &name, const void *header, size_t headerSize,
+                      const char *data, size_t dataSize)
+{
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(static_cast<const char *>(header), static_cast<std::streamsize>(headerSize));
+        file.write(data, static_cast<std::streamsize>(dataSize));
+        file.flush();
+        if (!file)
+        {
+            std::cerr << "failed to write " << name << " " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::cerr << "failed to replace " << name << " " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
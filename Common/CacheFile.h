@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Helpers for the on-disk caches (pipeline cache, device capabilities): a header followed by a blob of data, checked
+// with a hash on load and written so a crash mid-write never leaves a truncated file behind.
+class CacheFile
+{
+  public:
+    // FNV-1a, enough to catch truncated or corrupted files.
+    static uint64_t hash(const char *data, size_t size);
+
+    // Writes header and data to a temporary file next to path and renames it over path. The caches are an optimisation,
+    // so failures are reported under name and returned instead of thrown.
+    static bool write(const std::string &path, const std::string &name, const void *header, size_t headerSize,
+                      const char *data, size_t dataSize);
+};
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "CookedTexture.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+constexpr char fileMagic[8] = {'C', 'O', 'O', 'K', 'T', 'E', 'X', '1'};
+constexpr uint32_t fileVersion = 1;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+CookedTexture::CookedTexture(std::span<const uint8_t> data) : data(data)
+{
+    // Everything is checked once here so getLevel can trust the level table.
+    if (data.size() < sizeof(header))
+    {
+        throw std::runtime_error("invalid cooked texture!");
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version != fileVersion)
+    {
+        throw std::runtime_error("invalid cooked texture!");
+    }
+    VkFormat format = getFormat();
+    getBlockBytes(format);
+    if (header.width == 0 || header.height == 0 || header.levelCount == 0 ||
+        header.levelCount > static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height))) ||
+        data.size() < sizeof(header) + sizeof(LevelEntry) * header.levelCount)
+    {
+        throw std::runtime_error("invalid cooked texture!");
+    }
+    levels = {reinterpret_cast<const LevelEntry *>(data.data() + sizeof(header)), header.levelCount};
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        const LevelEntry &entry = levels[level];
+        uint64_t expectedSize =
+            getLevelSize(format, std::max(header.width >> level, 1u), std::max(header.height >> level, 1u));
+        if (entry.size != expectedSize || entry.offset % dataAlignment != 0 || entry.offset > data.size() ||
+            entry.size > data.size() - entry.offset)
+        {
+            throw std::runtime_error("invalid cooked texture!");
+        }
+    }
+}
+
+VkFormat CookedTexture::getFormat() const
+{
+    return static_cast<VkFormat>(header.format);
+}
+
+VkExtent2D CookedTexture::getExtent() const
+{
+    return {header.width, header.height};
+}
+
+uint32_t CookedTexture::getLevelCount() const
+{
+    return header.levelCount;
+}
+
+CookedTexture::Level CookedTexture::getLevel(uint32_t level) const
+{
+    const LevelEntry &entry = levels[level];
+    return {std::max(header.width >> level, 1u), std::max(header.height >> level, 1u),
+            data.subspan(static_cast<size_t>(entry.offset), static_cast<size_t>(entry.size))};
+}
+
+uint32_t CookedTexture::getBlockBytes(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        throw std::runtime_error("unsupported cooked texture format " + std::to_string(format) + "!");
+    }
+}
+
+uint64_t CookedTexture::getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+void CookedTexture::write(const std::string &path, VkFormat format, VkExtent2D extent,
+                          const std::vector<std::vector<uint8_t>> &levels)
+{
+    FileHeader header{};
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.format = static_cast<uint32_t>(format);
+    header.width = extent.width;
+    header.height = extent.height;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+
+    std::vector<LevelEntry> entries(levels.size());
+    uint64_t offset = sizeof(header) + sizeof(LevelEntry) * entries.size();
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        entries[i].offset = alignUp(offset, dataAlignment);
+        entries[i].size = levels[i].size();
+        offset = entries[i].offset + entries[i].size;
+    }
+
+    // Same as AssetPack::write: never leave a half written texture under the real name.
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open " + temporaryPath + "!");
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()),
+                   static_cast<std::streamsize>(sizeof(LevelEntry) * entries.size()));
+        uint64_t position = sizeof(header) + sizeof(LevelEntry) * entries.size();
+        const char padding[dataAlignment] = {};
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            file.write(padding, static_cast<std::streamsize>(entries[i].offset - position));
+            file.write(reinterpret_cast<const char *>(levels[i].data()),
+                       static_cast<std::streamsize>(levels[i].size()));
+            position = entries[i].offset + entries[i].size;
+        }
+        if (!file)
+        {
+            throw std::runtime_error("failed to write " + temporaryPath + "!");
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        throw std::runtime_error("failed to replace " + path + ": " + error.message());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// A texture cooked offline by TextureCooker: every mip level block compressed, ready to be copied into a
+// VK_IMAGE_TILING_OPTIMAL image as it is. Parsing hands out spans into the caller's data, e.g. an AssetPack asset.
+//
+// Layout, KTX2 without its data format descriptor and key/value data: a FileHeader, a LevelEntry per mip level from
+// the largest down, then the levels in the same order, each on a dataAlignment boundary.
+class CookedTexture
+{
+  public:
+    static constexpr uint64_t dataAlignment = 16;
+
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        std::span<const uint8_t> data;
+    };
+
+    // data must outlive the texture. Throws if it is not a valid cooked texture.
+    explicit CookedTexture(std::span<const uint8_t> data);
+
+    VkFormat getFormat() const;
+    VkExtent2D getExtent() const;
+    uint32_t getLevelCount() const;
+    Level getLevel(uint32_t level) const;
+
+    // Bytes per 4x4 block of the block compressed formats TextureCooker writes, throws for any other format.
+    static uint32_t getBlockBytes(VkFormat format);
+    // Bytes of a width x height level, partial blocks at the edges included.
+    static uint64_t getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+    // Writes levels, largest first, to path, replacing any existing file.
+    static void write(const std::string &path, VkFormat format, VkExtent2D extent,
+                      const std::vector<std::vector<uint8_t>> &levels);
+
+  private:
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t reserved;
+    };
+
+    struct LevelEntry
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    std::span<const uint8_t> data;
+    FileHeader header;
+    std::span<const LevelEntry> levels;
+};
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "CpuProfiler.h"
+
+#ifdef ENABLE_PROFILER
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+void writeJsonString(std::ostream &stream, const char *text)
+{
+    stream << '"';
+    for (; *text; text++)
+    {
+        if (*text == '"' || *text == '\\')
+        {
+            stream << '\\';
+        }
+        stream << *text;
+    }
+    stream << '"';
+}
+} // namespace
+
+// The only lock, taken once per thread on its first event, by setThreadName and by writeChromeTrace.
+struct CpuProfiler::Registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::map<uint32_t, std::string> threadNames;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+CpuProfiler::Registry &CpuProfiler::getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+CpuProfiler::ThreadBuffer::~ThreadBuffer()
+{
+    for (std::atomic<Event *> &chunk : chunks)
+    {
+        delete[] chunk.load();
+    }
+}
+
+uint64_t CpuProfiler::now()
+{
+    static const std::chrono::steady_clock::time_point epoch = getRegistry().epoch;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+CpuProfiler::ThreadBuffer &CpuProfiler::getThreadBuffer()
+{
+    // Owned by the registry, so the events of threads that have exited are still written out.
+    thread_local ThreadBuffer *threadBuffer = nullptr;
+    if (!threadBuffer)
+    {
+        Registry &registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer = registry.buffers.back().get();
+        threadBuffer->threadId = static_cast<uint32_t>(registry.buffers.size());
+    }
+    return *threadBuffer;
+}
+
+void CpuProfiler::record(const char *name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer &buffer = getThreadBuffer();
+    size_t index = buffer.eventCount.load(std::memory_order_relaxed);
+    size_t chunkIndex = index / ThreadBuffer::chunkSize;
+    if (chunkIndex == ThreadBuffer::maxChunks)
+    {
+        // Full, keep the beginning of the trace.
+        return;
+    }
+    Event *chunk = buffer.chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (!chunk)
+    {
+        chunk = new Event[ThreadBuffer::chunkSize];
+        buffer.chunks[chunkIndex].store(chunk, std::memory_order_release);
+    }
+    chunk[index % ThreadBuffer::chunkSize] = Event{name, begin, end};
+    buffer.eventCount.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(std::string name)
+{
+    uint32_t threadId = getThreadBuffer().threadId;
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threadNames[threadId] = std::move(name);
+}
+
+void CpuProfiler::writeChromeTrace(const std::filesystem::path &path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open " + path.string() + " for writing!");
+    }
+
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    // Timestamps are in microseconds, with three decimals to keep the nanoseconds.
+    file << std::fixed;
+    file.precision(3);
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &[threadId, name] : registry.threadNames)
+    {
+        file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId
+             << ",\"args\":{\"name\":";
+        writeJsonString(file, name.c_str());
+        file << "}}";
+        first = false;
+    }
+    for (const std::unique_ptr<ThreadBuffer> &buffer : registry.buffers)
+    {
+        size_t eventCount = buffer->eventCount.load(std::memory_order_acquire);
+        for (size_t i = 0; i < eventCount; i++)
+        {
+            const Event &event = buffer->chunks[i / ThreadBuffer::chunkSize].load(
+                std::memory_order_acquire)[i % ThreadBuffer::chunkSize];
+            file << (first ? "\n" : ",\n") << "{\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << event.begin / 1000.0
+                 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    if (!file)
+    {
+        throw std::runtime_error("failed to write " + path.string() + "!");
+    }
+}
+#endif
\ No newline at end of file
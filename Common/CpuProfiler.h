@@ -0,0 +1,90 @@
+#pragma once
+
+// CPU instrumentation that compiles to nothing unless ENABLE_PROFILER is defined (the ENABLE_PROFILER CMake option).
+// Always go through the macros, never use CpuProfiler directly, so release builds without it carry no trace of it.
+//
+//   PROFILE_ZONE("name");        times the rest of the enclosing scope
+//   PROFILE_FUNCTION();          PROFILE_ZONE with the function's name
+//   PROFILE_THREAD_NAME(name);   labels the calling thread in the trace
+//   PROFILE_WRITE_TRACE(path);   writes every event so far as Chrome trace JSON, for chrome://tracing or Perfetto
+//
+// Zone names are stored as pointers, they must be string literals or otherwise outlive the profiler.
+#ifdef ENABLE_PROFILER
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+class CpuProfiler
+{
+  public:
+    class Zone
+    {
+      public:
+        explicit Zone(const char *name) : name(name), begin(now())
+        {
+        }
+        ~Zone()
+        {
+            record(name, begin, now());
+        }
+
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+      private:
+        const char *name;
+        uint64_t begin;
+    };
+
+    // Nanoseconds since the profiler was first used.
+    static uint64_t now();
+
+    static void record(const char *name, uint64_t begin, uint64_t end);
+    static void setThreadName(std::string name);
+
+    // Safe to call while other threads keep recording, their events recorded after the call started may be missing.
+    // Throws if the file can not be written.
+    static void writeChromeTrace(const std::filesystem::path &path);
+
+  private:
+    struct Event
+    {
+        const char *name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Written only by its thread and read by writeChromeTrace without locks: events are appended to chunks that are
+    // never moved or freed, and eventCount is published after the event is complete.
+    struct ThreadBuffer
+    {
+        static constexpr size_t chunkSize = 4096;
+        static constexpr size_t maxChunks = 1024;
+
+        uint32_t threadId;
+        std::atomic<Event *> chunks[maxChunks] = {};
+        std::atomic<size_t> eventCount{0};
+
+        ~ThreadBuffer();
+    };
+
+    struct Registry;
+
+    static Registry &getRegistry();
+    static ThreadBuffer &getThreadBuffer();
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD_NAME(name) CpuProfiler::setThreadName(name)
+#define PROFILE_WRITE_TRACE(path) CpuProfiler::writeChromeTrace(path)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_WRITE_TRACE(path) ((void)0)
+#endif
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include "DeviceSelector.h"
+#include "CacheFile.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+constexpr char fileMagic[8] = {'V', 'K', 'D', 'E', 'V', 'C', 'A', 'P'};
+constexpr uint32_t fileVersion = 1;
+
+uint64_t getTypeScore(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+const char *getTypeName(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+template <typename T> void append(std::string &data, const T *values, size_t count)
+{
+    data.append(reinterpret_cast<const char *>(values), sizeof(T) * count);
+}
+
+template <typename T> bool read(const std::string &data, size_t &offset, T *values, size_t count)
+{
+    if (data.size() - offset < sizeof(T) * count)
+    {
+        return false;
+    }
+    memcpy(values, data.data() + offset, sizeof(T) * count);
+    offset += sizeof(T) * count;
+    return true;
+}
+} // namespace
+
+bool DeviceSelector::Capabilities::hasExtension(const char *name) const
+{
+    return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties &extension) {
+        return strcmp(extension.extensionName, name) == 0;
+    });
+}
+
+VkDeviceSize DeviceSelector::Capabilities::getLargestDeviceLocalHeap() const
+{
+    VkDeviceSize largest = 0;
+    for (uint32_t i = 0; i < memory.memoryHeapCount; i++)
+    {
+        if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            largest = std::max(largest, memory.memoryHeaps[i].size);
+        }
+    }
+    return largest;
+}
+
+bool DeviceSelector::Capabilities::hasDedicatedTransferFamily() const
+{
+    return std::any_of(queueFamilies.begin(), queueFamilies.end(), [](const VkQueueFamilyProperties &family) {
+        return (family.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+               !(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    });
+}
+
+bool DeviceSelector::Capabilities::hasDedicatedComputeFamily() const
+{
+    return std::any_of(queueFamilies.begin(), queueFamilies.end(), [](const VkQueueFamilyProperties &family) {
+        return (family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    });
+}
+
+DeviceSelector::DeviceSelector(std::string cachePath) : cachePath(std::move(cachePath))
+{
+}
+
+const DeviceSelector::Candidate *DeviceSelector::select(std::span<const VkPhysicalDevice> devices,
+                                                        const Requirements &requirements, const Filter &filter)
+{
+    PROFILE_FUNCTION();
+    std::vector<Capabilities> cache = loadCache();
+    bool probed = false;
+
+    candidates.clear();
+    for (VkPhysicalDevice device : devices)
+    {
+        Candidate &candidate = candidates.emplace_back();
+        candidate.device = device;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        auto entry = std::find_if(cache.begin(), cache.end(), [&properties](const Capabilities &capabilities) {
+            return isSameDriver(capabilities.properties, properties);
+        });
+        if (entry != cache.end())
+        {
+            candidate.capabilities = *entry;
+            candidate.capabilities.properties = properties;
+            candidate.cached = true;
+        }
+        else
+        {
+            candidate.capabilities = probe(device);
+            // A driver update replaces the entry of the old driver.
+            std::erase_if(cache, [&properties](const Capabilities &capabilities) {
+                return capabilities.properties.vendorID == properties.vendorID &&
+                       capabilities.properties.deviceID == properties.deviceID;
+            });
+            cache.push_back(candidate.capabilities);
+            probed = true;
+        }
+
+        candidate.rejection = check(candidate.capabilities, requirements);
+        if (candidate.rejection.empty() && filter)
+        {
+            candidate.rejection = filter(device, candidate.capabilities);
+        }
+        if (candidate.rejection.empty())
+        {
+            candidate.score = score(candidate.capabilities);
+        }
+    }
+    if (probed)
+    {
+        saveCache(cache);
+    }
+
+    const Candidate *best = nullptr;
+    for (const Candidate &candidate : candidates)
+    {
+        if (candidate.rejection.empty() && (!best || candidate.score > best->score))
+        {
+            best = &candidate;
+        }
+    }
+    return best;
+}
+
+const std::vector<DeviceSelector::Candidate> &DeviceSelector::getCandidates() const
+{
+    return candidates;
+}
+
+void DeviceSelector::printCandidates(std::ostream &stream) const
+{
+    for (const Candidate &candidate : candidates)
+    {
+        const VkPhysicalDeviceProperties &properties = candidate.capabilities.properties;
+        stream << "\t" << properties.deviceName << " (" << getTypeName(properties.deviceType) << ", "
+               << candidate.capabilities.getLargestDeviceLocalHeap() / (1024 * 1024) << " MiB, "
+               << (candidate.cached ? "cached" : "probed") << "): ";
+        if (candidate.rejection.empty())
+        {
+            stream << "score " << candidate.score << std::endl;
+        }
+        else
+        {
+            stream << candidate.rejection << std::endl;
+        }
+    }
+}
+
+DeviceSelector::Capabilities DeviceSelector::probe(VkPhysicalDevice device)
+{
+    PROFILE_FUNCTION();
+    Capabilities capabilities;
+    vkGetPhysicalDeviceProperties(device, &capabilities.properties);
+    vkGetPhysicalDeviceFeatures(device, &capabilities.features);
+    if (capabilities.properties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+        capabilities.timelineSemaphore = vulkan12Features.timelineSemaphore == VK_TRUE;
+        capabilities.drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+    }
+    vkGetPhysicalDeviceMemoryProperties(device, &capabilities.memory);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    capabilities.queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, capabilities.queueFamilies.data());
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    capabilities.extensions.resize(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, capabilities.extensions.data());
+    capabilities.extensions.resize(extensionCount);
+    return capabilities;
+}
+
+uint64_t DeviceSelector::score(const Capabilities &capabilities)
+{
+    // The type dominates, a GPU with less memory still beats a slower class of device. 1000 points per GiB of device
+    // local memory come next, a dedicated queue family is worth about 2 GiB.
+    uint64_t score = getTypeScore(capabilities.properties.deviceType) * 1'000'000'000ull;
+    score += capabilities.getLargestDeviceLocalHeap() * 1000 / (1024ull * 1024 * 1024);
+    if (capabilities.hasDedicatedTransferFamily())
+    {
+        score += 2000;
+    }
+    if (capabilities.hasDedicatedComputeFamily())
+    {
+        score += 2000;
+    }
+
+    auto graphicsFamily = std::find_if(
+        capabilities.queueFamilies.begin(), capabilities.queueFamilies.end(),
+        [](const VkQueueFamilyProperties &family) { return (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0; });
+    if (graphicsFamily != capabilities.queueFamilies.end() && graphicsFamily->timestampValidBits > 0)
+    {
+        score += 500;
+    }
+    if (capabilities.drawIndirectCount)
+    {
+        score += 250;
+    }
+    if (capabilities.features.multiDrawIndirect)
+    {
+        score += 250;
+    }
+    if (capabilities.features.pipelineStatisticsQuery)
+    {
+        score += 100;
+    }
+    score += capabilities.properties.limits.maxImageDimension2D / 64;
+    return score;
+}
+
+std::string DeviceSelector::check(const Capabilities &capabilities, const Requirements &requirements)
+{
+    const VkPhysicalDeviceProperties &properties = capabilities.properties;
+    if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU && !requirements.allowSoftware)
+    {
+        return "software implementation";
+    }
+    if (properties.apiVersion < requirements.apiVersion)
+    {
+        return "Vulkan " + std::to_string(VK_VERSION_MAJOR(properties.apiVersion)) + "." +
+               std::to_string(VK_VERSION_MINOR(properties.apiVersion)) + " only";
+    }
+    if (requirements.timelineSemaphore && !capabilities.timelineSemaphore)
+    {
+        return "no timeline semaphores";
+    }
+    // VkPhysicalDeviceFeatures is nothing but VkBool32 members.
+    constexpr size_t featureCount = sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32);
+    const VkBool32 *required = reinterpret_cast<const VkBool32 *>(&requirements.features);
+    const VkBool32 *supported = reinterpret_cast<const VkBool32 *>(&capabilities.features);
+    for (size_t i = 0; i < featureCount; i++)
+    {
+        if (required[i] && !supported[i])
+        {
+            return "missing feature #" + std::to_string(i) + " of VkPhysicalDeviceFeatures";
+        }
+    }
+    for (const char *extension : requirements.extensions)
+    {
+        if (!capabilities.hasExtension(extension))
+        {
+            return std::string("missing ") + extension;
+        }
+    }
+    if (std::none_of(capabilities.queueFamilies.begin(), capabilities.queueFamilies.end(),
+                     [](const VkQueueFamilyProperties &family) { return (family.queueFlags & VK_QUEUE_GRAPHICS_BIT); }))
+    {
+        return "no graphics queue";
+    }
+    return {};
+}
+
+std::vector<DeviceSelector::Capabilities> DeviceSelector::loadCache() const
+{
+    std::vector<Capabilities> entries;
+    if (cachePath.empty())
+    {
+        return entries;
+    }
+    std::ifstream file(cachePath, std::ios::binary);
+    FileHeader header{};
+    if (!file.is_open() || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version != fileVersion ||
+        header.dataSize >= (1ull << 28))
+    {
+        return entries;
+    }
+    std::string data(static_cast<size_t>(header.dataSize), '\0');
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size())) ||
+        header.dataHash != CacheFile::hash(data.data(), data.size()))
+    {
+        std::cout << "Discarding device cache " << cachePath << ", it is damaged" << std::endl;
+        return entries;
+    }
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < header.entryCount; i++)
+    {
+        EntryHeader entry;
+        if (!read(data, offset, &entry, 1))
+        {
+            return {};
+        }
+        Capabilities &capabilities = entries.emplace_back();
+        capabilities.properties.vendorID = entry.vendorID;
+        capabilities.properties.deviceID = entry.deviceID;
+        capabilities.properties.driverVersion = entry.driverVersion;
+        capabilities.properties.apiVersion = entry.apiVersion;
+        capabilities.features = entry.features;
+        capabilities.timelineSemaphore = entry.timelineSemaphore != 0;
+        capabilities.drawIndirectCount = entry.drawIndirectCount != 0;
+        capabilities.memory = entry.memory;
+        capabilities.queueFamilies.resize(entry.queueFamilyCount);
+        capabilities.extensions.resize(entry.extensionCount);
+        if (!read(data, offset, capabilities.queueFamilies.data(), capabilities.queueFamilies.size()) ||
+            !read(data, offset, capabilities.extensions.data(), capabilities.extensions.size()))
+        {
+            return {};
+        }
+    }
+    return entries;
+}
+
+void DeviceSelector::saveCache(const std::vector<Capabilities> &entries) const
+{
+    if (cachePath.empty())
+    {
+        return;
+    }
+
+    std::string data;
+    for (const Capabilities &capabilities : entries)
+    {
+        EntryHeader entry{};
+        entry.vendorID = capabilities.properties.vendorID;
+        entry.deviceID = capabilities.properties.deviceID;
+        entry.driverVersion = capabilities.properties.driverVersion;
+        entry.apiVersion = capabilities.properties.apiVersion;
+        entry.timelineSemaphore = capabilities.timelineSemaphore;
+        entry.drawIndirectCount = capabilities.drawIndirectCount;
+        entry.queueFamilyCount = static_cast<uint32_t>(capabilities.queueFamilies.size());
+        entry.extensionCount = static_cast<uint32_t>(capabilities.extensions.size());
+        entry.features = capabilities.features;
+        entry.memory = capabilities.memory;
+        append(data, &entry, 1);
+        append(data, capabilities.queueFamilies.data(), capabilities.queueFamilies.size());
+        append(data, capabilities.extensions.data(), capabilities.extensions.size());
+    }
+
+    FileHeader header{};
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.dataSize = data.size();
+    header.dataHash = CacheFile::hash(data.data(), data.size());
+
+    CacheFile::write(cachePath, "device cache", &header, sizeof(header), data.data(), data.size());
+}
+
+bool DeviceSelector::isSameDriver(const VkPhysicalDeviceProperties &a, const VkPhysicalDeviceProperties &b)
+{
+    return a.vendorID == b.vendorID && a.deviceID == b.deviceID && a.driverVersion == b.driverVersion &&
+           a.apiVersion == b.apiVersion;
+}
\ No newline at end of file
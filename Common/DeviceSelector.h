@@ -0,0 +1,117 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+// Picks the physical device to run on by scoring every device that meets the application's requirements. What a device
+// supports is probed once and cached on disk, keyed by vendor, device, driver and API version, so later launches only
+// read the device properties instead of enumerating features, memory heaps, queue families and extensions again.
+//
+// The score ranks by device type first (discrete, integrated, virtual, other, then CPU), then by the largest device
+// local heap, then rewards a transfer-only queue family, a compute family without graphics, timestamps and a few
+// optional features and limits. CPU implementations such as lavapipe or SwiftShader are only considered when the
+// requirements allow it, as a fallback for machines without a GPU.
+class DeviceSelector
+{
+  public:
+    struct Capabilities
+    {
+        // Queried on every launch, it carries the cache key.
+        VkPhysicalDeviceProperties properties{};
+        VkPhysicalDeviceFeatures features{};
+        // The Vulkan 1.2 features the applications use, false on older devices.
+        bool timelineSemaphore = false;
+        bool drawIndirectCount = false;
+        VkPhysicalDeviceMemoryProperties memory{};
+        std::vector<VkQueueFamilyProperties> queueFamilies;
+        std::vector<VkExtensionProperties> extensions;
+
+        bool hasExtension(const char *name) const;
+        VkDeviceSize getLargestDeviceLocalHeap() const;
+        // A family with the flag but neither graphics nor compute (transfer), or without graphics (compute).
+        bool hasDedicatedTransferFamily() const;
+        bool hasDedicatedComputeFamily() const;
+    };
+
+    struct Requirements
+    {
+        uint32_t apiVersion = VK_API_VERSION_1_0;
+        // Every feature set to VK_TRUE has to be supported.
+        VkPhysicalDeviceFeatures features{};
+        bool timelineSemaphore = false;
+        std::vector<const char *> extensions;
+        // Accept CPU implementations, they rank below every GPU.
+        bool allowSoftware = false;
+    };
+
+    struct Candidate
+    {
+        VkPhysicalDevice device = VK_NULL_HANDLE;
+        Capabilities capabilities;
+        uint64_t score = 0;
+        // Why the device can not be used, empty when it can.
+        std::string rejection;
+        // The capabilities came from the cache rather than from the driver.
+        bool cached = false;
+    };
+
+    // Checks that depend on more than the device, like presenting to a surface. Returns why the device can not be
+    // used, or an empty string.
+    using Filter = std::function<std::string(VkPhysicalDevice device, const Capabilities &capabilities)>;
+
+    // An empty path probes every device on every launch.
+    explicit DeviceSelector(std::string cachePath);
+
+    // Probes every device, or looks it up in the cache, and returns the best scoring one that meets the requirements
+    // and passes the filter, nullptr when there is none. Newly probed devices are written back to the cache.
+    const Candidate *select(std::span<const VkPhysicalDevice> devices, const Requirements &requirements,
+                            const Filter &filter = {});
+
+    // Every device seen by the last select, in enumeration order.
+    const std::vector<Candidate> &getCandidates() const;
+    // One line per device with its score or why it was rejected.
+    void printCandidates(std::ostream &stream) const;
+
+    static Capabilities probe(VkPhysicalDevice device);
+    static uint64_t score(const Capabilities &capabilities);
+    // Why the capabilities fall short of the requirements, empty when they do not.
+    static std::string check(const Capabilities &capabilities, const Requirements &requirements);
+
+  private:
+    // Prefix of the cache file, the entries follow and are covered by the hash.
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    struct EntryHeader
+    {
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint32_t apiVersion;
+        uint32_t timelineSemaphore;
+        uint32_t drawIndirectCount;
+        uint32_t queueFamilyCount;
+        uint32_t extensionCount;
+        VkPhysicalDeviceFeatures features;
+        VkPhysicalDeviceMemoryProperties memory;
+    };
+
+    std::string cachePath;
+    std::vector<Candidate> candidates;
+
+    // Only the key fields of the cached properties are filled in.
+    std::vector<Capabilities> loadCache() const;
+    void saveCache(const std::vector<Capabilities> &entries) const;
+    static bool isSameDriver(const VkPhysicalDeviceProperties &a, const VkPhysicalDeviceProperties &b);
+};
\ No newline at end of file
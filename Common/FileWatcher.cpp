@@ -0,0 +1,149 @@
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher(std::filesystem::path directory, std::chrono::milliseconds pollInterval)
+    : directory(std::move(directory)), pollInterval(pollInterval)
+{
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0)
+    {
+        addWatches(this->directory);
+        thread = std::thread(&FileWatcher::watchInotify, this);
+        return;
+    }
+#endif
+    scan(false);
+    thread = std::thread(&FileWatcher::watchPolling, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    running = false;
+    thread.join();
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+    }
+#endif
+}
+
+std::vector<std::string> FileWatcher::takeChanges()
+{
+    std::lock_guard<std::mutex> lock(changesMutex);
+    std::vector<std::string> result(changes.begin(), changes.end());
+    changes.clear();
+    return result;
+}
+
+#ifdef __linux__
+void FileWatcher::addWatches(const std::filesystem::path &root)
+{
+    // inotify is not recursive, every directory needs its own watch.
+    std::error_code error;
+    std::vector<std::filesystem::path> directories = {root};
+    for (auto it = std::filesystem::recursive_directory_iterator(root, error);
+         !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (it->is_directory())
+        {
+            directories.push_back(it->path());
+        }
+    }
+    for (const std::filesystem::path &path : directories)
+    {
+        // Editors that save through a temporary file show up as IN_MOVED_TO instead of IN_CLOSE_WRITE.
+        int watch = inotify_add_watch(inotifyFd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch >= 0)
+        {
+            watchedDirectories[watch] = path;
+        }
+    }
+}
+
+void FileWatcher::watchInotify()
+{
+    alignas(inotify_event) char buffer[4096];
+    while (running)
+    {
+        // Wake up regularly to notice the destructor.
+        pollfd descriptor{inotifyFd, POLLIN, 0};
+        if (poll(&descriptor, 1, static_cast<int>(pollInterval.count())) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *position = buffer; position < buffer + length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(position);
+                position += sizeof(inotify_event) + event->len;
+
+                auto directoryIt = watchedDirectories.find(event->wd);
+                if (directoryIt == watchedDirectories.end() || event->len == 0)
+                {
+                    continue;
+                }
+                std::filesystem::path path = directoryIt->second / event->name;
+                if (event->mask & IN_ISDIR)
+                {
+                    addWatches(path);
+                }
+                else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                {
+                    addChange(path);
+                }
+            }
+        }
+    }
+}
+#endif
+
+void FileWatcher::scan(bool report)
+{
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+         !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (!it->is_regular_file())
+        {
+            continue;
+        }
+        std::filesystem::file_time_type writeTime = it->last_write_time(error);
+        if (error)
+        {
+            // Deleted between listing and reading, the next scan catches up.
+            error.clear();
+            continue;
+        }
+        auto [entry, inserted] = writeTimes.try_emplace(it->path().string(), writeTime);
+        if ((inserted || entry->second != writeTime) && report)
+        {
+            addChange(it->path());
+        }
+        entry->second = writeTime;
+    }
+}
+
+void FileWatcher::watchPolling()
+{
+    while (running)
+    {
+        std::this_thread::sleep_for(pollInterval);
+        scan(true);
+    }
+}
+
+void FileWatcher::addChange(const std::filesystem::path &path)
+{
+    std::lock_guard<std::mutex> lock(changesMutex);
+    changes.insert(path.lexically_relative(directory).generic_string());
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reports files that are written below a directory, from a background thread so the caller never blocks on the file
+// system. Uses inotify on Linux and compares modification times every pollInterval everywhere else, or when inotify
+// is unavailable.
+class FileWatcher
+{
+  public:
+    FileWatcher(std::filesystem::path directory, std::chrono::milliseconds pollInterval);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // Files written since the last call, relative to the directory with '/' separators. Each file is reported once
+    // however many times it was written.
+    std::vector<std::string> takeChanges();
+
+  private:
+    std::filesystem::path directory;
+    std::chrono::milliseconds pollInterval;
+    std::atomic<bool> running{true};
+    std::mutex changesMutex;
+    std::set<std::string> changes;
+    std::thread thread;
+
+#ifdef __linux__
+    int inotifyFd = -1;
+    std::map<int, std::filesystem::path> watchedDirectories;
+
+    void addWatches(const std::filesystem::path &root);
+    void watchInotify();
+#endif
+    std::map<std::string, std::filesystem::file_time_type> writeTimes;
+
+    void scan(bool report);
+    void watchPolling();
+
+    void addChange(const std::filesystem::path &path);
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "FrameCommandAllocator.h"
+
+#include <stdexcept>
+
+FrameCommandAllocator::FrameCommandAllocator(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount)
+    : device(device), frames(frameCount)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    // Transient tells the driver the buffers are short lived, no RESET_COMMAND_BUFFER_BIT since only whole pools are
+    // reset.
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for (Frame &frame : frames)
+    {
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create frame command pool!");
+        }
+    }
+}
+
+FrameCommandAllocator::~FrameCommandAllocator()
+{
+    // Destroying a pool frees the buffers allocated from it.
+    for (Frame &frame : frames)
+    {
+        vkDestroyCommandPool(device, frame.pool, nullptr);
+    }
+}
+
+void FrameCommandAllocator::beginFrame(uint32_t frameIndex)
+{
+    Frame &frame = frames.at(frameIndex);
+    if (vkResetCommandPool(device, frame.pool, 0) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to reset frame command pool!");
+    }
+    frame.usedPrimaries = 0;
+    frame.usedSecondaries = 0;
+    currentFrame = frameIndex;
+}
+
+VkCommandBuffer FrameCommandAllocator::allocatePrimary()
+{
+    Frame &frame = frames[currentFrame];
+    return allocate(frame.primaries, frame.usedPrimaries, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+}
+
+VkCommandBuffer FrameCommandAllocator::allocateSecondary()
+{
+    Frame &frame = frames[currentFrame];
+    return allocate(frame.secondaries, frame.usedSecondaries, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+}
+
+uint32_t FrameCommandAllocator::getFrameCount() const
+{
+    return static_cast<uint32_t>(frames.size());
+}
+
+VkCommandBuffer FrameCommandAllocator::allocate(std::vector<VkCommandBuffer> &buffers, size_t &used,
+                                                VkCommandBufferLevel level)
+{
+    if (used == buffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frames[currentFrame].pool;
+        allocInfo.level = level;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+        buffers.push_back(commandBuffer);
+    }
+    // The pool reset returned every buffer to the initial state, reusing them needs no per-buffer reset.
+    return buffers[used++];
+}
\ No newline at end of file
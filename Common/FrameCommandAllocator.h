@@ -0,0 +1,46 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Command buffers for frames that are re-recorded every time they are drawn. Every frame in flight owns a transient
+// command pool that is reset as a whole once the frame's fence has signalled, which is far cheaper than resetting or
+// freeing buffers one by one. Buffers are kept across resets, so after the first few frames nothing is allocated.
+//
+// A pool may only be used from one thread at a time, threads recording in parallel need an allocator each.
+class FrameCommandAllocator
+{
+  public:
+    FrameCommandAllocator(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount);
+    ~FrameCommandAllocator();
+
+    FrameCommandAllocator(const FrameCommandAllocator &) = delete;
+    FrameCommandAllocator &operator=(const FrameCommandAllocator &) = delete;
+
+    // Resets the pool of the given frame and makes it current. The GPU must be done with the frame's previous
+    // submission, i.e. its fence has been waited on.
+    void beginFrame(uint32_t frameIndex);
+
+    // Both return a buffer of the current frame in the initial state, ready for vkBeginCommandBuffer.
+    VkCommandBuffer allocatePrimary();
+    VkCommandBuffer allocateSecondary();
+
+    uint32_t getFrameCount() const;
+
+  private:
+    struct Frame
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> primaries;
+        std::vector<VkCommandBuffer> secondaries;
+        size_t usedPrimaries = 0;
+        size_t usedSecondaries = 0;
+    };
+
+    VkDevice device;
+    std::vector<Frame> frames;
+    uint32_t currentFrame = 0;
+
+    VkCommandBuffer allocate(std::vector<VkCommandBuffer> &buffers, size_t &used, VkCommandBufferLevel level);
+};
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+const char *const statisticNames[] = {"primitives", "vertex invocations", "fragment invocations",
+                                      "compute invocations"};
+
+constexpr uint32_t noStatisticsQuery = UINT32_MAX;
+} // namespace
+
+GpuProfiler::Zone::Zone(GpuProfiler *profiler, VkCommandBuffer commandBuffer, const char *name, bool statistics)
+    : profiler(profiler), commandBuffer(commandBuffer), zoneIndex(UINT32_MAX)
+{
+    if (profiler)
+    {
+        zoneIndex = profiler->beginZone(commandBuffer, name, statistics);
+    }
+}
+
+GpuProfiler::Zone::~Zone()
+{
+    if (profiler && zoneIndex != UINT32_MAX)
+    {
+        profiler->endZone(commandBuffer, zoneIndex);
+    }
+}
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex,
+                         uint32_t frameCount, bool pipelineStatistics)
+    : device(device), pipelineStatistics(pipelineStatistics), frames(frameCount)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilies.at(queueFamilyIndex).timestampValidBits;
+    timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t{1} << validBits) - 1;
+    if (timestampMask == 0)
+    {
+        return;
+    }
+
+    for (FrameQueries &frame : frames)
+    {
+        VkQueryPoolCreateInfo timestampInfo{};
+        timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        timestampInfo.queryCount = 2 + 2 * maxZonesPerFrame;
+        if (vkCreateQueryPool(device, &timestampInfo, nullptr, &frame.timestampPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+
+        if (pipelineStatistics)
+        {
+            VkQueryPoolCreateInfo statisticsInfo{};
+            statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statisticsInfo.queryCount = maxZonesPerFrame;
+            statisticsInfo.pipelineStatistics = statisticFlags;
+            if (vkCreateQueryPool(device, &statisticsInfo, nullptr, &frame.statisticsPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (FrameQueries &frame : frames)
+    {
+        vkDestroyQueryPool(device, frame.timestampPool, nullptr);
+        vkDestroyQueryPool(device, frame.statisticsPool, nullptr);
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (timestampMask == 0)
+    {
+        return;
+    }
+    currentFrame = &frames.at(frameIndex);
+    if (currentFrame->recorded)
+    {
+        collect(*currentFrame);
+    }
+
+    currentFrame->zones.clear();
+    currentFrame->statisticsQueryCount = 0;
+    currentFrame->recorded = true;
+    vkCmdResetQueryPool(commandBuffer, currentFrame->timestampPool, 0, 2 + 2 * maxZonesPerFrame);
+    if (currentFrame->statisticsPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, currentFrame->statisticsPool, 0, maxZonesPerFrame);
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->timestampPool, 0);
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+{
+    if (currentFrame)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->timestampPool, 1);
+        currentFrame = nullptr;
+    }
+}
+
+void GpuProfiler::collectFinishedFrames()
+{
+    for (FrameQueries &frame : frames)
+    {
+        if (frame.recorded && &frame != currentFrame)
+        {
+            collect(frame);
+        }
+    }
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::getPipelineStatisticFlags() const
+{
+    return pipelineStatistics && timestampMask != 0 ? statisticFlags : 0;
+}
+
+void GpuProfiler::printStatistics(std::ostream &stream) const
+{
+    if (timestampMask == 0)
+    {
+        stream << "GPU profiler: the graphics queue does not support timestamps" << std::endl;
+        return;
+    }
+    if (frameMilliseconds.empty())
+    {
+        return;
+    }
+
+    std::vector<double> sorted(frameMilliseconds.begin(), frameMilliseconds.end());
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double fraction) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+    };
+    stream << "GPU frame time over the last " << sorted.size() << " frames: p50 " << percentile(0.50) << " ms, p95 "
+           << percentile(0.95) << " ms, p99 " << percentile(0.99) << " ms" << std::endl;
+
+    for (const auto &[name, statistics] : zoneStatistics)
+    {
+        stream << "\t" << name << ": " << statistics.totalMilliseconds / statistics.sampleCount << " ms";
+        if (statistics.statisticsSampleCount > 0)
+        {
+            for (uint32_t i = 0; i < statisticCount; i++)
+            {
+                stream << ", " << statistics.totalStatistics[i] / statistics.statisticsSampleCount << " "
+                       << statisticNames[i];
+            }
+        }
+        stream << std::endl;
+    }
+}
+
+std::vector<double> GpuProfiler::getFrameMilliseconds() const
+{
+    return std::vector<double>(frameMilliseconds.begin(), frameMilliseconds.end());
+}
+
+std::map<std::string, double> GpuProfiler::getZoneMilliseconds() const
+{
+    std::map<std::string, double> result;
+    for (const auto &[name, statistics] : zoneStatistics)
+    {
+        result[name] = statistics.totalMilliseconds / statistics.sampleCount;
+    }
+    return result;
+}
+
+std::map<std::string, uint64_t> GpuProfiler::getZoneVertexInvocations() const
+{
+    std::map<std::string, uint64_t> result;
+    for (const auto &[name, statistics] : zoneStatistics)
+    {
+        if (statistics.statisticsSampleCount > 0)
+        {
+            result[name] = statistics.totalStatistics[vertexInvocationsStatistic] / statistics.statisticsSampleCount;
+        }
+    }
+    return result;
+}
+
+uint32_t GpuProfiler::beginZone(VkCommandBuffer commandBuffer, const char *name, bool statistics)
+{
+    if (!currentFrame || currentFrame->zones.size() == maxZonesPerFrame)
+    {
+        return UINT32_MAX;
+    }
+
+    uint32_t zoneIndex = static_cast<uint32_t>(currentFrame->zones.size());
+    RecordedZone zone{name, noStatisticsQuery};
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->timestampPool,
+                        2 + 2 * zoneIndex);
+    // Only one query of a type may be active in a command buffer, so nested zones go without statistics.
+    if (statistics && currentFrame->statisticsPool != VK_NULL_HANDLE && !statisticsQueryActive)
+    {
+        statisticsQueryActive = true;
+        zone.statisticsQuery = currentFrame->statisticsQueryCount++;
+        vkCmdBeginQuery(commandBuffer, currentFrame->statisticsPool, zone.statisticsQuery, 0);
+    }
+    currentFrame->zones.push_back(zone);
+    return zoneIndex;
+}
+
+void GpuProfiler::endZone(VkCommandBuffer commandBuffer, uint32_t zoneIndex)
+{
+    const RecordedZone &zone = currentFrame->zones[zoneIndex];
+    if (zone.statisticsQuery != noStatisticsQuery)
+    {
+        vkCmdEndQuery(commandBuffer, currentFrame->statisticsPool, zone.statisticsQuery);
+        statisticsQueryActive = false;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->timestampPool,
+                        3 + 2 * zoneIndex);
+}
+
+void GpuProfiler::collect(FrameQueries &frame)
+{
+    frame.recorded = false;
+
+    // Without VK_QUERY_RESULT_WAIT_BIT this never blocks. The frame's fence has signalled, so the results are there
+    // unless the frame was never submitted.
+    uint32_t timestampCount = 2 + 2 * static_cast<uint32_t>(frame.zones.size());
+    std::vector<uint64_t> timestamps(timestampCount);
+    if (vkGetQueryPoolResults(device, frame.timestampPool, 0, timestampCount, timestamps.size() * sizeof(uint64_t),
+                              timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    {
+        return;
+    }
+    std::vector<uint64_t> statistics(frame.statisticsQueryCount * statisticCount);
+    if (frame.statisticsQueryCount > 0 &&
+        vkGetQueryPoolResults(device, frame.statisticsPool, 0, frame.statisticsQueryCount,
+                              statistics.size() * sizeof(uint64_t), statistics.data(),
+                              statisticCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    {
+        return;
+    }
+
+    frameMilliseconds.push_back(toMilliseconds(timestamps[0], timestamps[1]));
+    if (frameMilliseconds.size() > frameHistorySize)
+    {
+        frameMilliseconds.pop_front();
+    }
+
+    for (size_t i = 0; i < frame.zones.size(); i++)
+    {
+        const RecordedZone &zone = frame.zones[i];
+        ZoneStatistics &zoneTotals = zoneStatistics[zone.name];
+        zoneTotals.totalMilliseconds += toMilliseconds(timestamps[2 + 2 * i], timestamps[3 + 2 * i]);
+        zoneTotals.sampleCount++;
+        if (zone.statisticsQuery != noStatisticsQuery)
+        {
+            // The results of one query are in flag bit order, the same order as statisticNames.
+            for (uint32_t j = 0; j < statisticCount; j++)
+            {
+                zoneTotals.totalStatistics[j] += statistics[zone.statisticsQuery * statisticCount + j];
+            }
+            zoneTotals.statisticsSampleCount++;
+        }
+    }
+}
+
+double GpuProfiler::toMilliseconds(uint64_t begin, uint64_t end) const
+{
+    // Masking makes the difference right across a wrap of a counter narrower than 64 bits.
+    return static_cast<double>((end - begin) & timestampMask) * timestampPeriod / 1e6;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measures GPU time per frame and per named zone with timestamp queries, and optionally counts shader invocations
+// per zone with pipeline statistics queries. Every frame in flight has its own query pools, whose results are read
+// in beginFrame once the caller has waited on that frame's fence, so reading them never stalls.
+class GpuProfiler
+{
+  public:
+    // Records a zone for as long as it is in scope. A null profiler makes it a no-op, so call sites need no checks.
+    class Zone
+    {
+      public:
+        // With statistics the zone also counts invocations, if the device supports pipeline statistics queries and
+        // no enclosing zone counts them already. A zone with statistics must not be opened around secondary command
+        // buffers unless those inherit getPipelineStatisticFlags().
+        Zone(GpuProfiler *profiler, VkCommandBuffer commandBuffer, const char *name, bool statistics = false);
+        ~Zone();
+
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+      private:
+        GpuProfiler *profiler;
+        VkCommandBuffer commandBuffer;
+        uint32_t zoneIndex;
+    };
+
+    // pipelineStatistics requires the pipelineStatisticsQuery feature to be enabled on device.
+    GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount,
+                bool pipelineStatistics);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+    // Must be recorded first into the frame's command buffer, outside a render pass, after the frame's fence was
+    // waited on. Collects the results of the frame that last used frameIndex.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    // Collects every frame that has finished but whose slot has not come round again, for use once the device is idle.
+    void collectFinishedFrames();
+
+    // Zero when pipeline statistics are not collected.
+    VkQueryPipelineStatisticFlags getPipelineStatisticFlags() const;
+
+    // GPU frame time percentiles over the last frameHistorySize frames, then the average time and invocation counts of
+    // every zone.
+    void printStatistics(std::ostream &stream) const;
+
+    // GPU time of the last frameHistorySize collected frames, oldest first.
+    std::vector<double> getFrameMilliseconds() const;
+    // Average GPU time of every zone by name.
+    std::map<std::string, double> getZoneMilliseconds() const;
+    // Average vertex shader invocations of every zone that counts them, by name.
+    std::map<std::string, uint64_t> getZoneVertexInvocations() const;
+
+  private:
+    static constexpr uint32_t maxZonesPerFrame = 32;
+    static constexpr size_t frameHistorySize = 1000;
+    static constexpr VkQueryPipelineStatisticFlags statisticFlags =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+    static constexpr uint32_t statisticCount = 4;
+    // Index of VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT in the results of one query.
+    static constexpr uint32_t vertexInvocationsStatistic = 1;
+
+    struct RecordedZone
+    {
+        const char *name;
+        // Index of the zone's statistics query, or UINT32_MAX without one.
+        uint32_t statisticsQuery;
+    };
+
+    struct FrameQueries
+    {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        // Zones recorded into this frame, zone i owns timestamps 2 + 2i and 3 + 2i.
+        std::vector<RecordedZone> zones;
+        uint32_t statisticsQueryCount = 0;
+        bool recorded = false;
+    };
+
+    struct ZoneStatistics
+    {
+        double totalMilliseconds = 0.0;
+        uint64_t totalStatistics[statisticCount] = {};
+        uint64_t sampleCount = 0;
+        uint64_t statisticsSampleCount = 0;
+    };
+
+    VkDevice device;
+    // Nanoseconds per timestamp tick.
+    double timestampPeriod;
+    // Zero when the queue family can not write timestamps, which turns the profiler off.
+    uint64_t timestampMask;
+    bool pipelineStatistics;
+    std::vector<FrameQueries> frames;
+    FrameQueries *currentFrame = nullptr;
+    bool statisticsQueryActive = false;
+    std::deque<double> frameMilliseconds;
+    std::map<std::string, ZoneStatistics> zoneStatistics;
+
+    uint32_t beginZone(VkCommandBuffer commandBuffer, const char *name, bool statistics);
+    void endZone(VkCommandBuffer commandBuffer, uint32_t zoneIndex);
+    void collect(FrameQueries &frame);
+    double toMilliseconds(uint64_t begin, uint64_t end) const;
+};
\ No newline at end of file
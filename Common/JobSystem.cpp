@@ -0,0 +1,209 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+constexpr uint32_t dequeCapacity = 4096;
+} // namespace
+
+JobSystem::WorkStealingDeque::WorkStealingDeque(uint32_t capacity) : buffer(capacity), mask(capacity - 1)
+{
+}
+
+bool JobSystem::WorkStealingDeque::push(Job *job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t > mask)
+    {
+        return false;
+    }
+    buffer[b & mask].store(job, std::memory_order_relaxed);
+    // Publishes the job to thieves, they acquire bottom before reading the slot.
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job *JobSystem::WorkStealingDeque::pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // Empty.
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = buffer[b & mask].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // Last job, race the thieves for it.
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job *JobSystem::WorkStealingDeque::steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+    {
+        return nullptr;
+    }
+
+    Job *job = buffer[t & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        // Lost against the owner or another thief.
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        deques.push_back(std::make_unique<WorkStealingDeque>(dequeCapacity));
+    }
+    for (uint32_t i = 1; i < workerCount; i++)
+    {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+uint32_t JobSystem::getWorkerCount() const
+{
+    return static_cast<uint32_t>(deques.size());
+}
+
+void JobSystem::parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t workerIndex)> &function)
+{
+    Batch batch;
+    batch.remaining.store(count, std::memory_order_relaxed);
+    std::vector<Job> jobs(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        jobs[i].function = [&function, i](uint32_t workerIndex) { function(i, workerIndex); };
+        jobs[i].batch = &batch;
+    }
+
+    for (Job &job : jobs)
+    {
+        queuedJobs.fetch_add(1, std::memory_order_relaxed);
+        if (!deques[0]->push(&job))
+        {
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            execute(&job, 0);
+        }
+    }
+    {
+        // Taking the lock orders the wake-up after any worker that is about to check queuedJobs and go to sleep.
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeCondition.notify_all();
+
+    while (batch.remaining.load(std::memory_order_acquire) != 0)
+    {
+        if (Job *job = findJob(0))
+        {
+            execute(job, 0);
+        }
+        else
+        {
+            // Everything is taken, the remaining jobs are running on other workers.
+            std::this_thread::yield();
+        }
+    }
+
+    // Only now that no worker holds a job of this batch any more may it go out of scope.
+    if (batch.error)
+    {
+        std::rethrow_exception(batch.error);
+    }
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex)
+{
+    PROFILE_THREAD_NAME("job worker " + std::to_string(workerIndex));
+    while (true)
+    {
+        if (Job *job = findJob(workerIndex))
+        {
+            execute(job, workerIndex);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeCondition.wait(lock, [this]() { return stopping || queuedJobs.load(std::memory_order_relaxed) != 0; });
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
+
+JobSystem::Job *JobSystem::findJob(uint32_t workerIndex)
+{
+    Job *job = deques[workerIndex]->pop();
+    // Own jobs first, they are the most recently pushed ones and likely still in cache.
+    for (size_t i = 1; job == nullptr && i < deques.size(); i++)
+    {
+        job = deques[(workerIndex + i) % deques.size()]->steal();
+    }
+    if (job != nullptr)
+    {
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void JobSystem::execute(Job *job, uint32_t workerIndex)
+{
+    Batch *batch = job->batch;
+    try
+    {
+        job->function(workerIndex);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(batch->errorMutex);
+        if (!batch->error)
+        {
+            batch->error = std::current_exception();
+        }
+    }
+    // Publishes the error as well, the batch must not be touched afterwards.
+    batch->remaining.fetch_sub(1, std::memory_order_release);
+}
\ No newline at end of file
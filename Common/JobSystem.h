@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that share work through work-stealing deques. Every worker, including the thread that
+// created the job system, owns a deque: it pushes and pops at the bottom, idle workers steal from the top of someone
+// else's, so a worker that runs out of jobs takes over the oldest remaining ones instead of waiting on a shared lock.
+//
+// Worker 0 is the creating thread, it only does work while it is inside parallelFor.
+class JobSystem
+{
+  public:
+    // workerCount includes the calling thread, 0 uses one worker per hardware thread.
+    explicit JobSystem(uint32_t workerCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    uint32_t getWorkerCount() const;
+
+    // Calls function(index, workerIndex) for every index in [0, count) and returns once all calls have finished.
+    // workerIndex identifies the thread running the call, so per-worker resources can be used without locking.
+    // Must be called from the thread that created the job system. If calls throw, the first exception is rethrown once
+    // all calls have finished.
+    void parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t workerIndex)> &function);
+
+  private:
+    // The jobs of one parallelFor call.
+    struct Batch
+    {
+        std::atomic<uint32_t> remaining;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    struct Job
+    {
+        std::function<void(uint32_t workerIndex)> function;
+        Batch *batch;
+    };
+
+    // Chase-Lev deque with the memory orderings from Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+    // Models". push and pop may only be called by the owner, steal by anyone.
+    class WorkStealingDeque
+    {
+      public:
+        explicit WorkStealingDeque(uint32_t capacity);
+
+        // Fails when the deque is full, the caller runs the job itself then.
+        bool push(Job *job);
+        Job *pop();
+        Job *steal();
+
+      private:
+        std::atomic<int64_t> top{0};
+        std::atomic<int64_t> bottom{0};
+        std::vector<std::atomic<Job *>> buffer;
+        int64_t mask;
+    };
+
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+    // Jobs pushed but not yet taken, idle workers sleep while it is 0.
+    std::atomic<uint32_t> queuedJobs{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+
+    void workerLoop(uint32_t workerIndex);
+    Job *findJob(uint32_t workerIndex);
+    void execute(Job *job, uint32_t workerIndex);
+};
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "PipelineCache.h"
+#include "CacheFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+constexpr char fileMagic[8] = {'V', 'K', 'P', 'C', 'A', 'C', 'H', 'E'};
+
+// The header every implementation puts at the start of vkGetPipelineCacheData, see VkPipelineCacheHeaderVersionOne.
+struct VulkanCacheHeader
+{
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+} // namespace
+
+PipelineCache::PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, std::string path)
+    : device(device), path(std::move(path))
+{
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::string data;
+    if (!this->path.empty())
+    {
+        std::ifstream file(this->path, std::ios::binary);
+        FileHeader header{};
+        if (file.is_open() && file.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+            header.dataSize < (1ull << 31))
+        {
+            data.resize(static_cast<size_t>(header.dataSize));
+            if (!file.read(data.data(), static_cast<std::streamsize>(data.size())) || !isCompatible(header, data))
+            {
+                std::cout << "Discarding pipeline cache " << this->path << ", it belongs to another device or driver"
+                          << std::endl;
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+    loadedSize = data.size();
+}
+
+PipelineCache::~PipelineCache()
+{
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+VkPipelineCache PipelineCache::get() const
+{
+    return pipelineCache;
+}
+
+size_t PipelineCache::getLoadedSize() const
+{
+    return loadedSize;
+}
+
+bool PipelineCache::save() const
+{
+    if (path.empty())
+    {
+        return false;
+    }
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+    {
+        return false;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+    {
+        return false;
+    }
+    data.resize(dataSize);
+
+    FileHeader header{};
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.driverVersion = properties.driverVersion;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = CacheFile::hash(data.data(), data.size());
+
+    return CacheFile::write(path, "pipeline cache", &header, sizeof(header), data.data(), data.size());
+}
+
+bool PipelineCache::isCompatible(const FileHeader &header, const std::string &data) const
+{
+    if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.driverVersion != properties.driverVersion ||
+        header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+        header.dataHash != CacheFile::hash(data.data(), data.size()))
+    {
+        return false;
+    }
+
+    // Cross-check the driver's own header as well, in case the blob was produced by a different layer or ICD.
+    VulkanCacheHeader vulkanHeader;
+    if (data.size() < sizeof(vulkanHeader))
+    {
+        return false;
+    }
+    memcpy(&vulkanHeader, data.data(), sizeof(vulkanHeader));
+    return vulkanHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vulkanHeader.vendorID == properties.vendorID && vulkanHeader.deviceID == properties.deviceID &&
+           memcmp(vulkanHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A VkPipelineCache that is seeded from a file at startup and written back with save(). The file is only used when it
+// was written by the same device and driver version, anything else starts from an empty cache.
+class PipelineCache
+{
+  public:
+    // An empty path keeps the cache in memory only.
+    PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, std::string path);
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache &) = delete;
+    PipelineCache &operator=(const PipelineCache &) = delete;
+
+    VkPipelineCache get() const;
+
+    // Bytes of cache data accepted from disk, 0 on a cold start.
+    size_t getLoadedSize() const;
+
+    // Writes the cache to a temporary file next to the target and renames it over the target, so a crash mid-write
+    // never leaves a truncated cache behind. Failures are reported and otherwise ignored, the cache is an optimisation.
+    bool save() const;
+
+  private:
+    // Prefix written in front of the driver's blob. The blob's own header carries vendor, device and cache UUID but not
+    // the driver version, and drivers are not required to reject stale data gracefully.
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t driverVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    VkDevice device;
+    VkPhysicalDeviceProperties properties;
+    std::string path;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    size_t loadedSize = 0;
+
+    bool isCompatible(const FileHeader &header, const std::string &data) const;
+};
\ No newline at end of file
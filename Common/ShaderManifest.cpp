@@ -0,0 +1,59 @@
+#include "ShaderManifest.h"
+
+#include <sstream>
+#include <stdexcept>
+
+ShaderManifest::ShaderManifest(std::string_view text)
+{
+    std::istringstream stream{std::string(text)};
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        Constant constant;
+        if (!(fields >> constant.shader >> constant.id >> constant.type >> constant.name >> constant.defaultValue))
+        {
+            throw std::runtime_error("malformed shader manifest line: " + line);
+        }
+        constants.push_back(std::move(constant));
+    }
+}
+
+uint32_t ShaderManifest::getConstantId(std::string_view shader, std::string_view name) const
+{
+    for (const Constant &constant : constants)
+    {
+        if (constant.shader == shader && constant.name == name)
+        {
+            return constant.id;
+        }
+    }
+    throw std::runtime_error(std::string(shader) + " has no specialization constant " + std::string(name) + "!");
+}
+
+void SpecializationConstants::set(uint32_t id, uint32_t value)
+{
+    VkSpecializationMapEntry entry{};
+    entry.constantID = id;
+    entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    entries.push_back(entry);
+    data.push_back(value);
+}
+
+const VkSpecializationInfo *SpecializationConstants::get()
+{
+    if (entries.empty())
+    {
+        return nullptr;
+    }
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = data.size() * sizeof(uint32_t);
+    info.pData = data.data();
+    return &info;
+}
\ No newline at end of file
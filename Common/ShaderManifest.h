@@ -0,0 +1,47 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The specialization constants of every compiled shader, parsed from the permutations.txt the shader build writes
+// (see cmake/CompileShaders.cmake). Lets pipelines set constants by name instead of repeating constant_id values.
+class ShaderManifest
+{
+  public:
+    struct Constant
+    {
+        std::string shader;
+        uint32_t id;
+        std::string type;
+        std::string name;
+        std::string defaultValue;
+    };
+
+    // Throws on a malformed line.
+    explicit ShaderManifest(std::string_view text);
+
+    // Throws if the shader does not declare the constant.
+    uint32_t getConstantId(std::string_view shader, std::string_view name) const;
+
+  private:
+    std::vector<Constant> constants;
+};
+
+// Builds the VkSpecializationInfo of one shader stage. Every constant is stored as 32 bits, which covers bool
+// (VkBool32), int, uint and float.
+class SpecializationConstants
+{
+  public:
+    void set(uint32_t id, uint32_t value);
+
+    // Points into this object, which must outlive the pipeline creation it is used for. Null without constants.
+    const VkSpecializationInfo *get();
+
+  private:
+    std::vector<VkSpecializationMapEntry> entries;
+    std::vector<uint32_t> data;
+    VkSpecializationInfo info{};
+};
\ No newline at end of file
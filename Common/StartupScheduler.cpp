@@ -0,0 +1,210 @@
+#include "StartupScheduler.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+constexpr uint32_t timelineWidth = 60;
+} // namespace
+
+StartupScheduler::Step StartupScheduler::add(const char *name, std::function<void()> function,
+                                             std::vector<Step> dependencies, bool mainThread)
+{
+    Step step = static_cast<Step>(steps.size());
+    for (Step dependency : dependencies)
+    {
+        if (dependency >= step)
+        {
+            throw std::runtime_error("startup step depends on a step added after it!");
+        }
+        steps[dependency].dependents.push_back(step);
+    }
+
+    StepInfo info;
+    info.name = name;
+    info.function = std::move(function);
+    info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    info.mainThread = mainThread;
+    steps.push_back(std::move(info));
+    return step;
+}
+
+void StartupScheduler::run(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+    threadCount = std::min(threadCount, static_cast<uint32_t>(steps.size()));
+
+    timeline.clear();
+    remainingDependencies.clear();
+    readySteps.clear();
+    readyMainThreadSteps.clear();
+    runningCount = 0;
+    finishedCount = 0;
+    error = nullptr;
+    start = std::chrono::steady_clock::now();
+
+    remainingDependencies.resize(steps.size());
+    // Reversed so steps added first are popped first.
+    for (Step step = static_cast<Step>(steps.size()); step-- > 0;)
+    {
+        remainingDependencies[step] = steps[step].dependencyCount;
+        if (steps[step].dependencyCount == 0)
+        {
+            (steps[step].mainThread ? readyMainThreadSteps : readySteps).push_back(step);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i <= threadCount; i++)
+    {
+        threads.emplace_back(&StartupScheduler::workerLoop, this, i);
+    }
+    workerLoop(0);
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    totalMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+bool StartupScheduler::waitForStep(std::unique_lock<std::mutex> &lock, bool mainThread, Step &step)
+{
+    while (true)
+    {
+        if (error || finishedCount == steps.size())
+        {
+            return false;
+        }
+        // The main thread prefers its own steps, nobody else can run them.
+        if (mainThread && !readyMainThreadSteps.empty())
+        {
+            step = readyMainThreadSteps.back();
+            readyMainThreadSteps.pop_back();
+            return true;
+        }
+        if (!readySteps.empty())
+        {
+            step = readySteps.back();
+            readySteps.pop_back();
+            return true;
+        }
+        stepFinished.wait(lock);
+    }
+}
+
+void StartupScheduler::execute(std::unique_lock<std::mutex> &lock, Step step, uint32_t thread)
+{
+    runningCount++;
+    lock.unlock();
+
+    const StepInfo &info = steps[step];
+    std::exception_ptr stepError;
+    auto stepStart = std::chrono::steady_clock::now();
+    try
+    {
+        PROFILE_ZONE(info.name);
+        info.function();
+    }
+    catch (...)
+    {
+        stepError = std::current_exception();
+    }
+    auto stepEnd = std::chrono::steady_clock::now();
+
+    lock.lock();
+    timeline.push_back({info.name, std::chrono::duration<double, std::milli>(stepStart - start).count(),
+                        std::chrono::duration<double, std::milli>(stepEnd - start).count(), thread});
+    runningCount--;
+    finishedCount++;
+    if (stepError)
+    {
+        if (!error)
+        {
+            error = stepError;
+        }
+    }
+    else
+    {
+        for (Step dependent : info.dependents)
+        {
+            if (--remainingDependencies[dependent] == 0)
+            {
+                (steps[dependent].mainThread ? readyMainThreadSteps : readySteps).push_back(dependent);
+            }
+        }
+    }
+    stepFinished.notify_all();
+}
+
+void StartupScheduler::workerLoop(uint32_t thread)
+{
+    if (thread != 0)
+    {
+        PROFILE_THREAD_NAME("startup " + std::to_string(thread));
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    Step step;
+    while (waitForStep(lock, thread == 0, step))
+    {
+        execute(lock, step, thread);
+    }
+}
+
+const std::vector<StartupScheduler::TimelineEntry> &StartupScheduler::getTimeline() const
+{
+    return timeline;
+}
+
+double StartupScheduler::getTotalMilliseconds() const
+{
+    return totalMilliseconds;
+}
+
+void StartupScheduler::printTimeline(std::ostream &stream) const
+{
+    std::vector<TimelineEntry> entries = timeline;
+    std::sort(entries.begin(), entries.end(),
+              [](const TimelineEntry &a, const TimelineEntry &b) { return a.start < b.start; });
+
+    size_t nameWidth = 0;
+    double serialMilliseconds = 0.0;
+    for (const TimelineEntry &entry : entries)
+    {
+        nameWidth = std::max(nameWidth, std::string(entry.name).size());
+        serialMilliseconds += entry.end - entry.start;
+    }
+
+    std::ios_base::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(2);
+
+    double scale = totalMilliseconds > 0.0 ? timelineWidth / totalMilliseconds : 0.0;
+    stream << "Startup timeline:\n";
+    for (const TimelineEntry &entry : entries)
+    {
+        uint32_t first = std::min(timelineWidth - 1, static_cast<uint32_t>(entry.start * scale));
+        uint32_t last = std::clamp(static_cast<uint32_t>(entry.end * scale), first + 1, timelineWidth);
+        std::string bar(timelineWidth, ' ');
+        std::fill(bar.begin() + first, bar.begin() + last, '#');
+        stream << "  " << std::left << std::setw(static_cast<int>(nameWidth)) << entry.name << std::right << " |"
+               << bar << "| " << std::setw(8) << entry.start << " - " << std::setw(8) << entry.end << " ms  thread "
+               << entry.thread << "\n";
+    }
+    stream << "  " << totalMilliseconds << " ms, " << serialMilliseconds << " ms if run one after the other\n";
+    stream.flags(flags);
+    stream.precision(precision);
+}
\ No newline at end of file
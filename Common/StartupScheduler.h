@@ -0,0 +1,76 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Runs the steps of application startup as a dependency graph instead of one after the other. A step starts as soon
+// as everything it depends on has finished, so independent work such as reading assets, creating the window and
+// creating the device overlaps. Steps that must run on the main thread, like GLFW window creation, are marked so and
+// run on the thread that calls run(); the others run on a few helper threads or on the main thread when it is idle.
+//
+// Every step is timed and the result can be printed as a startup timeline.
+class StartupScheduler
+{
+  public:
+    using Step = uint32_t;
+
+    struct TimelineEntry
+    {
+        const char *name;
+        // Milliseconds since run() was called.
+        double start;
+        double end;
+        // 0 is the main thread.
+        uint32_t thread;
+    };
+
+    // name must be a string literal or otherwise outlive the CPU profiler. Dependencies are steps added before.
+    Step add(const char *name, std::function<void()> function, std::vector<Step> dependencies = {},
+             bool mainThread = false);
+
+    // Runs every step and returns once all have finished, using threadCount helper threads besides the calling one,
+    // 0 picks one per hardware thread up to the number of steps. If a step throws, no further steps are started and
+    // the first exception is rethrown once the running ones have finished.
+    void run(uint32_t threadCount = 0);
+
+    // In the order the steps finished.
+    const std::vector<TimelineEntry> &getTimeline() const;
+    // Wall clock time of the last run() in milliseconds.
+    double getTotalMilliseconds() const;
+    // One line per step with a bar showing when it ran, and how much the overlap saved.
+    void printTimeline(std::ostream &stream) const;
+
+  private:
+    struct StepInfo
+    {
+        const char *name;
+        std::function<void()> function;
+        std::vector<Step> dependents;
+        uint32_t dependencyCount = 0;
+        bool mainThread = false;
+    };
+
+    std::vector<StepInfo> steps;
+    std::vector<TimelineEntry> timeline;
+    double totalMilliseconds = 0.0;
+
+    std::mutex mutex;
+    std::condition_variable stepFinished;
+    std::vector<uint32_t> remainingDependencies;
+    std::vector<Step> readySteps;
+    std::vector<Step> readyMainThreadSteps;
+    uint32_t runningCount = 0;
+    uint32_t finishedCount = 0;
+    std::exception_ptr error;
+    std::chrono::steady_clock::time_point start;
+
+    // Called with the lock held, returns false once there is nothing left to start.
+    bool waitForStep(std::unique_lock<std::mutex> &lock, bool mainThread, Step &step);
+    void execute(std::unique_lock<std::mutex> &lock, Step step, uint32_t thread);
+    void workerLoop(uint32_t thread);
+};
\ No newline at end of file
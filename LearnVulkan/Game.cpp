@@ -1,20 +1,5 @@
 #include "Game.h"
 
-std::vector<char> readFile(const std::string &fileName)
-{
-    std::ifstream inputFileStream(fileName, std::ios::binary | std::ios::ate);
-
-    if (inputFileStream)
-    {
-        size_t fileSize = static_cast<size_t>(inputFileStream.tellg());
-        std::vector<char> fileBuffer(fileSize);
-        inputFileStream.seekg(0);
-        inputFileStream.read(fileBuffer.data(), fileSize);
-        inputFileStream.close();
-        return fileBuffer;
-    }
-    throw std::runtime_error("Failed to open file");
-}
 VkPhysicalDeviceProperties Game::getDeviceProperties(const VkPhysicalDevice &device)
 {
     VkPhysicalDeviceProperties properties;
@@ -43,29 +28,34 @@ std::vector<VkSurfaceFormatKHR> Game::getSurfaceFormats(const VkPhysicalDevice &
 
 int Game::getBestDeviceId(std::vector<VkPhysicalDevice> &devices)
 {
-    std::vector<int> bestDeviceIds = {};
-    for (unsigned int i = 0; i < devices.size(); i++)
-    {
-        auto physicalDevice = devices[i];
-        VkPhysicalDeviceProperties properties = getDeviceProperties(physicalDevice);
-        if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-            bestDeviceIds.push_back(i);
-
-        // TODO: Check for Double/Triple buffering support and other stuff
-        // such as min & max image size.
-        getSurfaceCapabilities(physicalDevice);
-        getSurfaceFormats(physicalDevice);
-        getPresentModes(physicalDevice);
-
+    PROFILE_FUNCTION();
+    DeviceSelector::Requirements requirements;
+    requirements.extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+    // The device queue is created on family 0, so that family has to draw and present.
+    DeviceSelector selector("device_cache.bin");
+    const DeviceSelector::Candidate *selected = selector.select(
+        devices, requirements, [this](VkPhysicalDevice device, const DeviceSelector::Capabilities &capabilities) {
+            VkBool32 surfaceSupport = VK_FALSE;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, 0, surface, &surfaceSupport);
+            if (!(capabilities.queueFamilies[0].queueFlags & VK_QUEUE_GRAPHICS_BIT) || !surfaceSupport)
+            {
+                return std::string("queue family 0 can not draw and present");
+            }
+            return std::string();
+        });
 #ifdef _DEBUG
-        printVkPhysicalDeviceInfo(physicalDevice, properties);
+    selector.printCandidates(std::cout);
 #endif
-        getQueueFamilyProperties(physicalDevice);
-    }
-    if (bestDeviceIds.size() == 0)
+    if (!selected)
         return -1;
 
-    return bestDeviceIds[0];
+    // Candidates are in the order of the devices.
+    int bestDeviceId = static_cast<int>(selected - selector.getCandidates().data());
+#ifdef _DEBUG
+    printVkPhysicalDeviceInfo(devices[bestDeviceId], selected->capabilities.properties);
+#endif
+    return bestDeviceId;
 }
 
 std::vector<VkPresentModeKHR> Game::getPresentModes(const VkPhysicalDevice physicalDevice)
@@ -196,6 +186,7 @@ void Game::printPropertyInfo(VkPhysicalDeviceProperties &properties)
 
 void Game::initializeVulkan()
 {
+    PROFILE_FUNCTION();
     VkApplicationInfo appInfo;
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pNext = nullptr;
@@ -213,6 +204,7 @@ void Game::initializeVulkan()
     result = vkEnumerateInstanceLayerProperties(&amountOfLayers, layers.data());
     ASSERT_VULKAN(result);
 
+#ifdef _DEBUG
     std::cout << "Amount of instance layers:	" << amountOfLayers << std::endl;
 
     for (uint32_t i = 0; i < amountOfLayers; ++i)
@@ -226,6 +218,7 @@ void Game::initializeVulkan()
         std::cout.fill('~');
         std::cout << "" << std::endl;
     }
+#endif
 
     std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
 
@@ -241,6 +234,7 @@ void Game::initializeVulkan()
     result = vkEnumerateInstanceExtensionProperties(nullptr, &amountOfExtensions, extensions.data());
     ASSERT_VULKAN(result);
 
+#ifdef _DEBUG
     std::cout << std::endl << std::endl << "Extensions" << std::endl;
     for (uint32_t i = 0; i < amountOfExtensions; ++i)
     {
@@ -251,6 +245,7 @@ void Game::initializeVulkan()
         std::cout.fill('~');
         std::cout << "" << std::endl;
     }
+#endif
 
     VkInstanceCreateInfo instanceInfo;
     instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -262,8 +257,11 @@ void Game::initializeVulkan()
     instanceInfo.enabledExtensionCount = enabledExtensions.size();
     instanceInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
-    result = vkCreateInstance(&instanceInfo, nullptr, &instance);
-    ASSERT_VULKAN(result);
+    {
+        PROFILE_ZONE("vkCreateInstance");
+        result = vkCreateInstance(&instanceInfo, nullptr, &instance);
+        ASSERT_VULKAN(result);
+    }
 
     result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
     ASSERT_VULKAN(result);
@@ -279,6 +277,10 @@ void Game::initializeVulkan()
     ASSERT_VULKAN(result);
 
     int bestDeviceId = getBestDeviceId(physicalDevices);
+    if (bestDeviceId < 0)
+    {
+        throw std::runtime_error("failed to find a suitable GPU!");
+    }
 
     // TODO: Select proper queueCount and queueFamilIndex and dynamically generate queuePriorities
     // float queuePriorities[] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
@@ -309,11 +311,15 @@ void Game::initializeVulkan()
     deviceCreateInfo.pEnabledFeatures = &usedFeatures;
 
     // TODO: Select proper physical device.
-    result = vkCreateDevice(physicalDevices[bestDeviceId], &deviceCreateInfo, nullptr, &device);
-    ASSERT_VULKAN(result);
+    {
+        PROFILE_ZONE("vkCreateDevice");
+        result = vkCreateDevice(physicalDevices[bestDeviceId], &deviceCreateInfo, nullptr, &device);
+        ASSERT_VULKAN(result);
+    }
     std::cout << "Best Device Id:   " << bestDeviceId << std::endl;
 
-    VkQueue queue;
+    pipelineCache = std::make_unique<PipelineCache>(physicalDevices[bestDeviceId], device, "pipeline_cache.bin");
+
     vkGetDeviceQueue(device, 0, 0, &queue);
 
     auto surfaceCapabilities = getSurfaceCapabilities(physicalDevices[bestDeviceId]);
@@ -352,8 +358,12 @@ void Game::initializeVulkan()
     swapchainCreateInfo.clipped = VK_TRUE;
     swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
 
-    result = vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain);
-    ASSERT_VULKAN(result);
+    {
+        PROFILE_ZONE("vkCreateSwapchainKHR");
+        result = vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain);
+        ASSERT_VULKAN(result);
+    }
+    swapchainExtent = swapchainCreateInfo.imageExtent;
 
     uint32_t amountOfImagesInSwapchain = 0;
     result = vkGetSwapchainImagesKHR(device, swapchain, &amountOfImagesInSwapchain, nullptr);
@@ -370,7 +380,7 @@ void Game::initializeVulkan()
         imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         imageViewCreateInfo.pNext = nullptr;
         imageViewCreateInfo.flags = 0;
-        imageViewCreateInfo.image = imagesInSwapchain[0];
+        imageViewCreateInfo.image = imagesInSwapchain[i];
         imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
         imageViewCreateInfo.format = surfaceFormats.data()[0].format;
         imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -387,12 +397,12 @@ void Game::initializeVulkan()
         ASSERT_VULKAN(result);
     }
 
-    auto shaderCodeVert = readFile("content/vert.spv");
-    auto shaderCodeFrag = readFile("content/frag.spv");
+    auto shaderCodeVert = assets->get("shaders/shader.vert.spv");
+    auto shaderCodeFrag = assets->get("shaders/shader.frag.spv");
 #ifdef _DEBUG
     std::cout << "File sizes: " << std::endl;
-    std::cout << "\tvert.spv " << shaderCodeVert.size() << "bytes" << std::endl;
-    std::cout << "\tfrag.spv " << shaderCodeFrag.size() << "bytes" << std::endl;
+    std::cout << "\tshader.vert.spv " << shaderCodeVert.size() << "bytes" << std::endl;
+    std::cout << "\tshader.frag.spv " << shaderCodeFrag.size() << "bytes" << std::endl;
 #endif
 
     CreateShaderModule(shaderCodeVert, &shaderModuleVert);
@@ -545,6 +555,17 @@ void Game::initializeVulkan()
     subpassDescription.preserveAttachmentCount = 0;
     subpassDescription.pPreserveAttachments = nullptr;
 
+    // The image is acquired with a semaphore waited on at the colour attachment output stage, the layout transition at
+    // the start of the render pass has to wait for that stage as well.
+    VkSubpassDependency subpassDependency;
+    subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependency.dstSubpass = 0;
+    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependency.srcAccessMask = 0;
+    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassDependency.dependencyFlags = 0;
+
     VkRenderPassCreateInfo renderPassCreateInfo;
     renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassCreateInfo.pNext = nullptr;
@@ -553,8 +574,8 @@ void Game::initializeVulkan()
     renderPassCreateInfo.pAttachments = &attachmentDescription;
     renderPassCreateInfo.subpassCount = 1;
     renderPassCreateInfo.pSubpasses = &subpassDescription;
-    renderPassCreateInfo.dependencyCount = 0;
-    renderPassCreateInfo.pDependencies = nullptr;
+    renderPassCreateInfo.dependencyCount = 1;
+    renderPassCreateInfo.pDependencies = &subpassDependency;
     result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
     ASSERT_VULKAN(result);
 
@@ -579,8 +600,16 @@ void Game::initializeVulkan()
     graphicsPipelineCreateInfo.basePipelineHandle = nullptr;
     graphicsPipelineCreateInfo.basePipelineIndex = -1;
 
-    result = vkCreateGraphicsPipelines(device, nullptr, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline);
-    ASSERT_VULKAN(result);
+    auto pipelineStart = std::chrono::steady_clock::now();
+    {
+        PROFILE_ZONE("vkCreateGraphicsPipelines");
+        result = vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &graphicsPipelineCreateInfo, nullptr,
+                                           &pipeline);
+        ASSERT_VULKAN(result);
+    }
+    std::chrono::duration<double, std::milli> pipelineTime = std::chrono::steady_clock::now() - pipelineStart;
+    std::cout << "Graphics pipeline created in " << pipelineTime.count() << " ms ("
+              << (pipelineCache->getLoadedSize() > 0 ? "warm" : "cold") << " pipeline cache)" << std::endl;
     frameBuffers.resize(amountOfImagesInSwapchain);
     for (uint32_t i = 0; i < amountOfImagesInSwapchain; i++)
     {
@@ -597,29 +626,155 @@ void Game::initializeVulkan()
         result = vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &(frameBuffers[i]));
         ASSERT_VULKAN(result);
     }
-    VkCommandPoolCreateInfo commandPoolCreateInfo;
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.pNext = nullptr;
-    commandPoolCreateInfo.flags = 0;
-    commandPoolCreateInfo.queueFamilyIndex = 0; // TODO: CIV VK_QUEUE_GRAPHICS_BIT
 
+    // TODO: CIV VK_QUEUE_GRAPHICS_BIT
+    commandAllocator = std::make_unique<FrameCommandAllocator>(device, 0, framesInFlight);
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = nullptr;
+    semaphoreCreateInfo.flags = 0;
+
+    VkFenceCreateInfo fenceCreateInfo;
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderingDoneSemaphores.resize(framesInFlight);
+    frameFences.resize(framesInFlight);
+    imagesInFlight.assign(amountOfImagesInSwapchain, VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < framesInFlight; i++)
+    {
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &imageAvailableSemaphores[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &renderingDoneSemaphores[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateFence(device, &fenceCreateInfo, nullptr, &frameFences[i]);
+        ASSERT_VULKAN(result);
+    }
+}
+
+void Game::drawFrame()
+{
+    PROFILE_FUNCTION();
+    VkResult result;
+    {
+        PROFILE_ZONE("wait for frame fence");
+        result = vkWaitForFences(device, 1, &frameFences[currentFrame], VK_TRUE, UINT64_MAX);
+        ASSERT_VULKAN(result);
+    }
+
+    uint32_t imageIndex;
+    result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
+                                   VK_NULL_HANDLE, &imageIndex);
+    ASSERT_VULKAN(result);
+
+    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+    {
+        result = vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        ASSERT_VULKAN(result);
+    }
+    imagesInFlight[imageIndex] = frameFences[currentFrame];
+
+    // Everything recorded for this frame slot last time has finished executing, so its pool can be reset.
+    commandAllocator->beginFrame(currentFrame);
+    VkCommandBuffer commandBuffer = commandAllocator->allocatePrimary();
+    recordCommandBuffer(commandBuffer, imageIndex);
+
+    VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &imageAvailableSemaphores[currentFrame];
+    submitInfo.pWaitDstStageMask = &waitStageMask;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &renderingDoneSemaphores[currentFrame];
+
+    result = vkResetFences(device, 1, &frameFences[currentFrame]);
+    ASSERT_VULKAN(result);
+    result = vkQueueSubmit(queue, 1, &submitInfo, frameFences[currentFrame]);
+    ASSERT_VULKAN(result);
+
+    VkPresentInfoKHR presentInfo;
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = nullptr;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &renderingDoneSemaphores[currentFrame];
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapchain;
+    presentInfo.pImageIndices = &imageIndex;
+    presentInfo.pResults = nullptr;
+    {
+        PROFILE_ZONE("present");
+        result = vkQueuePresentKHR(queue, &presentInfo);
+        ASSERT_VULKAN(result);
+    }
+
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Game::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    PROFILE_FUNCTION();
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+
+    VkClearValue clearValue;
+    clearValue.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+    VkRenderPassBeginInfo renderPassBeginInfo;
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.pNext = nullptr;
+    renderPassBeginInfo.renderPass = renderPass;
+    renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+    renderPassBeginInfo.renderArea.offset = {0, 0};
+    renderPassBeginInfo.renderArea.extent = swapchainExtent;
+    renderPassBeginInfo.clearValueCount = 1;
+    renderPassBeginInfo.pClearValues = &clearValue;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    // The vertex shader generates the triangle from gl_VertexIndex.
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+
+    result = vkEndCommandBuffer(commandBuffer);
+    ASSERT_VULKAN(result);
 }
 
-void Game::CreateShaderModule(std::vector<char> &code, VkShaderModule *shaderModule)
+void Game::CreateShaderModule(std::span<const uint8_t> code, VkShaderModule *shaderModule)
 {
+    PROFILE_FUNCTION();
     VkShaderModuleCreateInfo shaderModuleCreateInfo;
     shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     shaderModuleCreateInfo.pNext = nullptr;
     shaderModuleCreateInfo.flags = 0;
     shaderModuleCreateInfo.codeSize = code.size();
-    shaderModuleCreateInfo.pCode = reinterpret_cast<uint32_t *>(code.data());
+    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
     auto result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, shaderModule);
     ASSERT_VULKAN(result);
 }
 
-void Game::shutdownVulkan() const
+void Game::shutdownVulkan()
 {
+    PROFILE_FUNCTION();
     vkDeviceWaitIdle(device);
+    for (uint32_t i = 0; i < framesInFlight; i++)
+    {
+        vkDestroyFence(device, frameFences[i], nullptr);
+        vkDestroySemaphore(device, renderingDoneSemaphores[i], nullptr);
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+    }
+    commandAllocator.reset();
     for (auto framebuffer : frameBuffers)
     {
         vkDestroyFramebuffer(device, framebuffer, nullptr);
@@ -634,6 +789,8 @@ void Game::shutdownVulkan() const
         vkDestroyImageView(device, image_view, nullptr);
     }
     vkDestroySwapchainKHR(device, swapchain, nullptr);
+    pipelineCache->save();
+    pipelineCache.reset();
     vkDestroyDevice(device, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
@@ -641,12 +798,23 @@ void Game::shutdownVulkan() const
 
 void Game::init()
 {
-    initializeGLFW();
-    initializeVulkan();
+    PROFILE_THREAD_NAME("main");
+    PROFILE_FUNCTION();
+    // The pack is read while the window opens, GLFW has to stay on the main thread.
+    StartupScheduler startup;
+    StartupScheduler::Step assetPackStep =
+        startup.add("asset pack", [this]() { assets = std::make_unique<AssetPack>("content.pack"); });
+    StartupScheduler::Step glfwStep = startup.add("glfw", [this]() { initializeGLFW(); }, {}, true);
+    startup.add("vulkan", [this]() { initializeVulkan(); }, {assetPackStep, glfwStep});
+    startup.run();
+#ifdef _DEBUG
+    startup.printTimeline(std::cout);
+#endif
 }
 
 void Game::initializeGLFW()
 {
+    PROFILE_FUNCTION();
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, false);
@@ -658,7 +826,7 @@ void Game::shutdownGLFW() const
     glfwDestroyWindow(window);
 }
 
-void Game::shutdown() const
+void Game::shutdown()
 {
     shutdownVulkan();
     shutdownGLFW();
@@ -668,6 +836,8 @@ void Game::run()
 {
     while (!glfwWindowShouldClose(window))
     {
+        PROFILE_ZONE("frame");
         glfwPollEvents();
+        drawFrame();
     }
 }
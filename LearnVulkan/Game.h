@@ -1,8 +1,16 @@
 #pragma once
 
-#include <fstream>
+#include "AssetPack.h"
+#include "CpuProfiler.h"
+#include "DeviceSelector.h"
+#include "FrameCommandAllocator.h"
+#include "PipelineCache.h"
+#include "StartupScheduler.h"
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <nameof.hpp>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -25,8 +33,10 @@ class Game
 {
     void initializeGLFW();
     void initializeVulkan();
-    void CreateShaderModule(std::vector<char> &code, VkShaderModule *shaderModule);
-    void shutdownVulkan() const;
+    void CreateShaderModule(std::span<const uint8_t> code, VkShaderModule *shaderModule);
+    void shutdownVulkan();
+    void drawFrame();
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
     void shutdownGLFW() const;
     VkPhysicalDeviceProperties getDeviceProperties(const VkPhysicalDevice &device);
     std::vector<VkSurfaceFormatKHR> getSurfaceFormats(const VkPhysicalDevice &physical_device);
@@ -48,7 +58,7 @@ class Game
   public:
     void init();
     void run();
-    void shutdown() const;
+    void shutdown();
 
   private:
     VkPipelineLayout pipelineLayout;
@@ -63,4 +73,15 @@ class Game
     VkSurfaceKHR surface;
     VkRenderPass renderPass;
     VkPipeline pipeline;
+    std::unique_ptr<AssetPack> assets;
+    std::unique_ptr<PipelineCache> pipelineCache;
+    VkQueue queue;
+    VkExtent2D swapchainExtent;
+    static constexpr uint32_t framesInFlight = 2;
+    std::unique_ptr<FrameCommandAllocator> commandAllocator;
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkSemaphore> renderingDoneSemaphores;
+    std::vector<VkFence> frameFences;
+    std::vector<VkFence> imagesInFlight;
+    uint32_t currentFrame = 0;
 };
\ No newline at end of file
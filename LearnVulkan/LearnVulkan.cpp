@@ -12,5 +12,6 @@ int main()
     game.init();
     game.run();
     game.shutdown();
+    PROFILE_WRITE_TRACE("cpu_trace.json");
     return 0;
 }
@@ -1,3 +0,0 @@
-%VULKAN_SDK%\Bin32\glslangValidator.exe -V shader.vert
-%VULKAN_SDK%\Bin32\glslangValidator.exe -V shader.frag
-pause
\ No newline at end of file
@@ -0,0 +1,786 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#define BLOCK_COMPRESSION_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE4_1__) || defined(__AVX__) || defined(TEXTURE_COOKER_SSE41)
+#define BLOCK_COMPRESSION_SSE41 1
+#include <smmintrin.h>
+#endif
+
+namespace
+{
+// Structure of arrays, so the palette search handles several texels per instruction.
+struct Block
+{
+    alignas(32) float channels[4][16];
+};
+
+// Palettes hold whole numbers, so every error the search sums is an integer below 2^24 and exact in a float whatever
+// order the lanes are added in.
+using Palette = float[16][4];
+
+constexpr float bc1Weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+constexpr uint32_t bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+Block loadBlock(const uint8_t *texels)
+{
+    Block block;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            block.channels[c][i] = texels[i * 4 + c];
+        }
+    }
+    return block;
+}
+
+uint32_t getRefinementCount(CompressionPreset preset)
+{
+    switch (preset)
+    {
+    case CompressionPreset::Fast:
+        return 0;
+    case CompressionPreset::Normal:
+        return 1;
+    case CompressionPreset::High:
+        return 4;
+    }
+    return 0;
+}
+
+// Picks the palette entry closest to every texel over channelCount channels and returns the summed squared error.
+// Ties go to the lowest index.
+float selectIndices(const float (*channels)[16], uint32_t channelCount, const Palette &palette, uint32_t paletteSize,
+                    uint8_t *indices)
+{
+#if defined(BLOCK_COMPRESSION_AVX2)
+    __m256 totalError = _mm256_setzero_ps();
+    for (uint32_t group = 0; group < 16; group += 8)
+    {
+        __m256 bestError = _mm256_set1_ps(INFINITY);
+        __m256 bestIndex = _mm256_setzero_ps();
+        for (uint32_t entry = 0; entry < paletteSize; entry++)
+        {
+            __m256 error = _mm256_setzero_ps();
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                __m256 difference =
+                    _mm256_sub_ps(_mm256_load_ps(&channels[c][group]), _mm256_set1_ps(palette[entry][c]));
+                error = _mm256_add_ps(error, _mm256_mul_ps(difference, difference));
+            }
+            __m256 closer = _mm256_cmp_ps(error, bestError, _CMP_LT_OQ);
+            bestError = _mm256_min_ps(error, bestError);
+            bestIndex = _mm256_blendv_ps(bestIndex, _mm256_set1_ps(static_cast<float>(entry)), closer);
+        }
+        totalError = _mm256_add_ps(totalError, bestError);
+
+        alignas(32) int32_t groupIndices[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(groupIndices), _mm256_cvttps_epi32(bestIndex));
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            indices[group + i] = static_cast<uint8_t>(groupIndices[i]);
+        }
+    }
+    alignas(32) float errors[8];
+    _mm256_store_ps(errors, totalError);
+    return errors[0] + errors[1] + errors[2] + errors[3] + errors[4] + errors[5] + errors[6] + errors[7];
+#elif defined(BLOCK_COMPRESSION_SSE41)
+    __m128 totalError = _mm_setzero_ps();
+    for (uint32_t group = 0; group < 16; group += 4)
+    {
+        __m128 bestError = _mm_set1_ps(INFINITY);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (uint32_t entry = 0; entry < paletteSize; entry++)
+        {
+            __m128 error = _mm_setzero_ps();
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                __m128 difference = _mm_sub_ps(_mm_load_ps(&channels[c][group]), _mm_set1_ps(palette[entry][c]));
+                error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+            }
+            __m128 closer = _mm_cmplt_ps(error, bestError);
+            bestError = _mm_min_ps(error, bestError);
+            bestIndex = _mm_blendv_ps(bestIndex, _mm_set1_ps(static_cast<float>(entry)), closer);
+        }
+        totalError = _mm_add_ps(totalError, bestError);
+
+        alignas(16) int32_t groupIndices[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(groupIndices), _mm_cvttps_epi32(bestIndex));
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            indices[group + i] = static_cast<uint8_t>(groupIndices[i]);
+        }
+    }
+    alignas(16) float errors[4];
+    _mm_store_ps(errors, totalError);
+    return errors[0] + errors[1] + errors[2] + errors[3];
+#else
+    float totalError = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float bestError = INFINITY;
+        uint8_t bestIndex = 0;
+        for (uint32_t entry = 0; entry < paletteSize; entry++)
+        {
+            float error = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                float difference = channels[c][i] - palette[entry][c];
+                error += difference * difference;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                bestIndex = static_cast<uint8_t>(entry);
+            }
+        }
+        indices[i] = bestIndex;
+        totalError += bestError;
+    }
+    return totalError;
+#endif
+}
+
+// Endpoints at both ends of the texels' spread along their principal axis, found by power iteration on the
+// covariance matrix. endpoint0 is the end the axis points to.
+void principalEndpoints(const float (*channels)[16], uint32_t channelCount, float *endpoint0, float *endpoint1)
+{
+    float mean[4] = {};
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            mean[c] += channels[c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t a = 0; a < channelCount; a++)
+        {
+            for (uint32_t b = a; b < channelCount; b++)
+            {
+                covariance[a][b] += (channels[a][i] - mean[a]) * (channels[b][i] - mean[b]);
+            }
+        }
+    }
+
+    // Starting from the column of the channel with the largest variance avoids starting orthogonal to the axis.
+    uint32_t largest = 0;
+    for (uint32_t c = 1; c < channelCount; c++)
+    {
+        if (covariance[c][c] > covariance[largest][largest])
+        {
+            largest = c;
+        }
+    }
+    float axis[4] = {};
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        axis[c] = c < largest ? covariance[c][largest] : covariance[largest][c];
+    }
+    for (uint32_t iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (uint32_t a = 0; a < channelCount; a++)
+        {
+            for (uint32_t b = 0; b < channelCount; b++)
+            {
+                next[a] += (a < b ? covariance[a][b] : covariance[b][a]) * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f)
+        {
+            break;
+        }
+        length = std::sqrt(length);
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float minimum = 0.0f;
+    float maximum = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float projection = 0.0f;
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            projection += (channels[c][i] - mean[c]) * axis[c];
+        }
+        minimum = std::min(minimum, projection);
+        maximum = std::max(maximum, projection);
+    }
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        endpoint0[c] = std::clamp(mean[c] + maximum * axis[c], 0.0f, 255.0f);
+        endpoint1[c] = std::clamp(mean[c] + minimum * axis[c], 0.0f, 255.0f);
+    }
+}
+
+// Least squares endpoints for the chosen indices, weights[index] being the share of endpoint0 in that palette entry.
+// Fails when every texel has the same weight.
+bool refineEndpoints(const float (*channels)[16], uint32_t channelCount, const uint8_t *indices, const float *weights,
+                     float *endpoint0, float *endpoint1)
+{
+    float a = 0.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    float x[4] = {};
+    float y[4] = {};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float weight = weights[indices[i]];
+        a += weight * weight;
+        b += weight * (1.0f - weight);
+        c += (1.0f - weight) * (1.0f - weight);
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            x[channel] += weight * channels[channel][i];
+            y[channel] += (1.0f - weight) * channels[channel][i];
+        }
+    }
+    float determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f)
+    {
+        return false;
+    }
+    for (uint32_t channel = 0; channel < channelCount; channel++)
+    {
+        endpoint0[channel] = std::clamp((c * x[channel] - b * y[channel]) / determinant, 0.0f, 255.0f);
+        endpoint1[channel] = std::clamp((a * y[channel] - b * x[channel]) / determinant, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// Fields are written from the least significant bit of the first byte on, as BC7 lays them out.
+class BitWriter
+{
+  public:
+    explicit BitWriter(uint8_t *data) : data(data)
+    {
+        memset(data, 0, 16);
+    }
+
+    void write(uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t bit = 0; bit < bitCount; bit++, position++)
+        {
+            data[position / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (position % 8));
+        }
+    }
+
+  private:
+    uint8_t *data;
+    uint32_t position = 0;
+};
+
+class BitReader
+{
+  public:
+    explicit BitReader(const uint8_t *data) : data(data)
+    {
+    }
+
+    uint32_t read(uint32_t bitCount)
+    {
+        uint32_t value = 0;
+        for (uint32_t bit = 0; bit < bitCount; bit++, position++)
+        {
+            value |= static_cast<uint32_t>((data[position / 8] >> (position % 8)) & 1) << bit;
+        }
+        return value;
+    }
+
+  private:
+    const uint8_t *data;
+    uint32_t position = 0;
+};
+
+uint16_t packRgb565(const float *color)
+{
+    uint32_t r = static_cast<uint32_t>(std::lrint(color[0] * 31.0f / 255.0f));
+    uint32_t g = static_cast<uint32_t>(std::lrint(color[1] * 63.0f / 255.0f));
+    uint32_t b = static_cast<uint32_t>(std::lrint(color[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+void unpackRgb565(uint16_t packed, uint32_t *color)
+{
+    uint32_t r = packed >> 11;
+    uint32_t g = (packed >> 5) & 63;
+    uint32_t b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// The four colour palette, which BC1 only uses when color0 > color1.
+void getBc1Palette(uint16_t color0, uint16_t color1, uint32_t (*palette)[3])
+{
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+}
+
+float evaluateBc1(const Block &block, uint16_t color0, uint16_t color1, uint8_t *indices)
+{
+    uint32_t colors[4][3];
+    getBc1Palette(color0, color1, colors);
+    Palette palette;
+    for (uint32_t entry = 0; entry < 4; entry++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            palette[entry][c] = static_cast<float>(colors[entry][c]);
+        }
+    }
+    return selectIndices(block.channels, 3, palette, 4, indices);
+}
+
+// The eight value palette, which BC4 only uses when endpoint0 > endpoint1.
+void getBc4Palette(uint32_t endpoint0, uint32_t endpoint1, uint32_t *palette)
+{
+    palette[0] = endpoint0;
+    palette[1] = endpoint1;
+    for (uint32_t i = 2; i < 8; i++)
+    {
+        palette[i] = ((8 - i) * endpoint0 + (i - 1) * endpoint1 + 3) / 7;
+    }
+}
+
+float evaluateBc4(const float (*channel)[16], uint8_t endpoint0, uint8_t endpoint1, uint8_t *indices)
+{
+    uint32_t values[8];
+    getBc4Palette(endpoint0, endpoint1, values);
+    Palette palette;
+    for (uint32_t entry = 0; entry < 8; entry++)
+    {
+        palette[entry][0] = static_cast<float>(values[entry]);
+    }
+    return selectIndices(channel, 1, palette, 8, indices);
+}
+
+// One channel of a BC5 block.
+void encodeBc4(const float (*channel)[16], CompressionPreset preset, uint8_t *block)
+{
+    static constexpr float weights[8] = {1.0f,        0.0f,        6.0f / 7.0f, 5.0f / 7.0f,
+                                         4.0f / 7.0f, 3.0f / 7.0f, 2.0f / 7.0f, 1.0f / 7.0f};
+
+    float minimum = (*channel)[0];
+    float maximum = (*channel)[0];
+    for (uint32_t i = 1; i < 16; i++)
+    {
+        minimum = std::min(minimum, (*channel)[i]);
+        maximum = std::max(maximum, (*channel)[i]);
+    }
+    uint8_t endpoint0 = static_cast<uint8_t>(maximum);
+    uint8_t endpoint1 = static_cast<uint8_t>(minimum);
+    uint8_t indices[16];
+    float error = evaluateBc4(channel, endpoint0, endpoint1, indices);
+
+    for (uint32_t iteration = 0; iteration < getRefinementCount(preset) && error > 0.0f; iteration++)
+    {
+        float refined0;
+        float refined1;
+        if (!refineEndpoints(channel, 1, indices, weights, &refined0, &refined1))
+        {
+            break;
+        }
+        uint8_t candidate0 = static_cast<uint8_t>(std::lrint(std::max(refined0, refined1)));
+        uint8_t candidate1 = static_cast<uint8_t>(std::lrint(std::min(refined0, refined1)));
+        uint8_t candidateIndices[16];
+        float candidateError = evaluateBc4(channel, candidate0, candidate1, candidateIndices);
+        if (candidateError >= error)
+        {
+            break;
+        }
+        endpoint0 = candidate0;
+        endpoint1 = candidate1;
+        memcpy(indices, candidateIndices, sizeof(indices));
+        error = candidateError;
+    }
+
+    // Equal endpoints select the six value palette, whose first entry is still endpoint0.
+    if (endpoint0 == endpoint1)
+    {
+        memset(indices, 0, sizeof(indices));
+    }
+    block[0] = endpoint0;
+    block[1] = endpoint1;
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        bits |= static_cast<uint64_t>(indices[i]) << (3 * i);
+    }
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        block[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+void decodeBc4(const uint8_t *block, uint8_t *texels)
+{
+    uint32_t palette[8];
+    if (block[0] > block[1])
+    {
+        getBc4Palette(block[0], block[1], palette);
+    }
+    else
+    {
+        palette[0] = block[0];
+        palette[1] = block[1];
+        for (uint32_t i = 2; i < 6; i++)
+        {
+            palette[i] = ((6 - i) * block[0] + (i - 1) * block[1] + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        bits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    }
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        texels[i * 4] = static_cast<uint8_t>(palette[(bits >> (3 * i)) & 7]);
+    }
+}
+
+struct Bc7Endpoints
+{
+    // 7-bit RGBA of both endpoints and their p-bits, endpoint e decodes to quantized[e][c] << 1 | pBits[e].
+    uint8_t quantized[2][4];
+    uint8_t pBits[2];
+};
+
+void quantizeBc7(const float *endpoint, uint32_t pBit, uint8_t *quantized)
+{
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        quantized[c] = static_cast<uint8_t>(std::clamp<long>(std::lrint((endpoint[c] - pBit) / 2.0f), 0, 127));
+    }
+}
+
+// The p-bit that keeps the quantized endpoint closest to the unquantized one.
+uint8_t choosePBit(const float *endpoint)
+{
+    float errors[2] = {};
+    for (uint32_t pBit = 0; pBit < 2; pBit++)
+    {
+        uint8_t quantized[4];
+        quantizeBc7(endpoint, pBit, quantized);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            float difference = static_cast<float>(quantized[c] << 1 | pBit) - endpoint[c];
+            errors[pBit] += difference * difference;
+        }
+    }
+    return errors[1] < errors[0] ? 1 : 0;
+}
+
+void getBc7Palette(const Bc7Endpoints &endpoints, uint32_t (*palette)[4])
+{
+    for (uint32_t entry = 0; entry < 16; entry++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            uint32_t value0 = static_cast<uint32_t>(endpoints.quantized[0][c] << 1 | endpoints.pBits[0]);
+            uint32_t value1 = static_cast<uint32_t>(endpoints.quantized[1][c] << 1 | endpoints.pBits[1]);
+            palette[entry][c] = ((64 - bc7Weights[entry]) * value0 + bc7Weights[entry] * value1 + 32) >> 6;
+        }
+    }
+}
+
+float evaluateBc7(const Block &block, const Bc7Endpoints &endpoints, uint8_t *indices)
+{
+    uint32_t colors[16][4];
+    getBc7Palette(endpoints, colors);
+    Palette palette;
+    for (uint32_t entry = 0; entry < 16; entry++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            palette[entry][c] = static_cast<float>(colors[entry][c]);
+        }
+    }
+    return selectIndices(block.channels, 4, palette, 16, indices);
+}
+
+// Quantizes both endpoints and evaluates them, trying every combination of p-bits when exhaustive.
+float quantizeAndEvaluateBc7(const Block &block, const float (*endpoints)[4], bool exhaustive, Bc7Endpoints &result,
+                             uint8_t *indices)
+{
+    if (!exhaustive)
+    {
+        for (uint32_t e = 0; e < 2; e++)
+        {
+            result.pBits[e] = choosePBit(endpoints[e]);
+            quantizeBc7(endpoints[e], result.pBits[e], result.quantized[e]);
+        }
+        return evaluateBc7(block, result, indices);
+    }
+
+    float bestError = INFINITY;
+    for (uint32_t pBits = 0; pBits < 4; pBits++)
+    {
+        Bc7Endpoints candidate;
+        uint8_t candidateIndices[16];
+        for (uint32_t e = 0; e < 2; e++)
+        {
+            candidate.pBits[e] = static_cast<uint8_t>((pBits >> e) & 1);
+            quantizeBc7(endpoints[e], candidate.pBits[e], candidate.quantized[e]);
+        }
+        float error = evaluateBc7(block, candidate, candidateIndices);
+        if (error < bestError)
+        {
+            bestError = error;
+            result = candidate;
+            memcpy(indices, candidateIndices, 16);
+        }
+    }
+    return bestError;
+}
+} // namespace
+
+uint32_t BlockCompression::getBlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+void BlockCompression::encodeBC1(const uint8_t *texels, CompressionPreset preset, uint8_t *block)
+{
+    Block source = loadBlock(texels);
+    float endpoint0[4];
+    float endpoint1[4];
+    principalEndpoints(source.channels, 3, endpoint0, endpoint1);
+    uint16_t color0 = packRgb565(endpoint0);
+    uint16_t color1 = packRgb565(endpoint1);
+    uint8_t indices[16];
+    float error = evaluateBc1(source, color0, color1, indices);
+
+    for (uint32_t iteration = 0; iteration < getRefinementCount(preset) && error > 0.0f; iteration++)
+    {
+        if (!refineEndpoints(source.channels, 3, indices, bc1Weights, endpoint0, endpoint1))
+        {
+            break;
+        }
+        uint16_t candidate0 = packRgb565(endpoint0);
+        uint16_t candidate1 = packRgb565(endpoint1);
+        uint8_t candidateIndices[16];
+        float candidateError = evaluateBc1(source, candidate0, candidate1, candidateIndices);
+        if (candidateError >= error)
+        {
+            break;
+        }
+        color0 = candidate0;
+        color1 = candidate1;
+        memcpy(indices, candidateIndices, sizeof(indices));
+        error = candidateError;
+    }
+
+    // The four colour palette needs color0 > color1. Swapping the endpoints swaps entries 0 with 1 and 2 with 3;
+    // equal endpoints select the three colour palette, whose first entry is still color0.
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+        for (uint8_t &index : indices)
+        {
+            index ^= 1;
+        }
+    }
+    else if (color0 == color1)
+    {
+        memset(indices, 0, sizeof(indices));
+    }
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+    }
+    block[0] = static_cast<uint8_t>(color0);
+    block[1] = static_cast<uint8_t>(color0 >> 8);
+    block[2] = static_cast<uint8_t>(color1);
+    block[3] = static_cast<uint8_t>(color1 >> 8);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        block[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+void BlockCompression::encodeBC5(const uint8_t *texels, CompressionPreset preset, uint8_t *block)
+{
+    Block source = loadBlock(texels);
+    encodeBc4(&source.channels[0], preset, block);
+    encodeBc4(&source.channels[1], preset, block + 8);
+}
+
+void BlockCompression::encodeBC7(const uint8_t *texels, CompressionPreset preset, uint8_t *block)
+{
+    Block source = loadBlock(texels);
+    float endpoints[2][4];
+    principalEndpoints(source.channels, 4, endpoints[0], endpoints[1]);
+    bool exhaustive = preset == CompressionPreset::High;
+    Bc7Endpoints quantized;
+    uint8_t indices[16];
+    float error = quantizeAndEvaluateBc7(source, endpoints, exhaustive, quantized, indices);
+
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        weights[i] = static_cast<float>(64 - bc7Weights[i]) / 64.0f;
+    }
+    for (uint32_t iteration = 0; iteration < getRefinementCount(preset) && error > 0.0f; iteration++)
+    {
+        if (!refineEndpoints(source.channels, 4, indices, weights, endpoints[0], endpoints[1]))
+        {
+            break;
+        }
+        Bc7Endpoints candidate;
+        uint8_t candidateIndices[16];
+        float candidateError = quantizeAndEvaluateBc7(source, endpoints, exhaustive, candidate, candidateIndices);
+        if (candidateError >= error)
+        {
+            break;
+        }
+        quantized = candidate;
+        memcpy(indices, candidateIndices, sizeof(indices));
+        error = candidateError;
+    }
+
+    // The first index is stored without its top bit, swapping the endpoints mirrors the indices to clear it.
+    if (indices[0] >= 8)
+    {
+        std::swap(quantized.quantized[0], quantized.quantized[1]);
+        std::swap(quantized.pBits[0], quantized.pBits[1]);
+        for (uint8_t &index : indices)
+        {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    BitWriter writer(block);
+    writer.write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        writer.write(quantized.quantized[0][c], 7);
+        writer.write(quantized.quantized[1][c], 7);
+    }
+    writer.write(quantized.pBits[0], 1);
+    writer.write(quantized.pBits[1], 1);
+    writer.write(indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++)
+    {
+        writer.write(indices[i], 4);
+    }
+}
+
+void BlockCompression::encode(BlockFormat format, const uint8_t *texels, CompressionPreset preset, uint8_t *block)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        encodeBC1(texels, preset, block);
+        break;
+    case BlockFormat::BC5:
+        encodeBC5(texels, preset, block);
+        break;
+    case BlockFormat::BC7:
+        encodeBC7(texels, preset, block);
+        break;
+    }
+}
+
+void BlockCompression::decode(BlockFormat format, const uint8_t *block, uint8_t *texels)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: {
+        uint16_t color0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+        uint16_t color1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+        uint32_t palette[4][3];
+        getBc1Palette(color0, color1, palette);
+        if (color0 <= color1)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+            }
+            texels[i * 4 + 3] = 255;
+        }
+        break;
+    }
+    case BlockFormat::BC5:
+        decodeBc4(block, texels);
+        decodeBc4(block + 8, texels + 1);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            texels[i * 4 + 2] = 0;
+            texels[i * 4 + 3] = 255;
+        }
+        break;
+    case BlockFormat::BC7: {
+        BitReader reader(block);
+        if (reader.read(7) != 1 << 6)
+        {
+            throw std::runtime_error("only BC7 mode 6 blocks can be decoded!");
+        }
+        Bc7Endpoints endpoints;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            endpoints.quantized[0][c] = static_cast<uint8_t>(reader.read(7));
+            endpoints.quantized[1][c] = static_cast<uint8_t>(reader.read(7));
+        }
+        endpoints.pBits[0] = static_cast<uint8_t>(reader.read(1));
+        endpoints.pBits[1] = static_cast<uint8_t>(reader.read(1));
+        uint32_t palette[16][4];
+        getBc7Palette(endpoints, palette);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t index = reader.read(i == 0 ? 3 : 4);
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+            }
+        }
+        break;
+    }
+    }
+}
+
+const char *BlockCompression::getInstructionSet()
+{
+#if defined(BLOCK_COMPRESSION_AVX2)
+    return "AVX2";
+#elif defined(BLOCK_COMPRESSION_SSE41)
+    return "SSE4.1";
+#else
+    return "scalar";
+#endif
+}
\ No newline at end of file
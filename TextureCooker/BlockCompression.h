@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+enum class BlockFormat
+{
+    // RGB at 4 bits per texel, no alpha. For opaque colour textures.
+    BC1,
+    // Two independent channels at 8 bits per texel, the red and green of the input. For tangent space normal maps.
+    BC5,
+    // RGBA at 8 bits per texel. Only mode 6 is used, one subset with 7.7.7.7.1 endpoints and 4-bit indices.
+    BC7,
+};
+
+enum class CompressionPreset
+{
+    // Endpoints straight from the principal axis of the block's colours.
+    Fast,
+    // One least squares refinement of the endpoints.
+    Normal,
+    // Several refinements, and for BC7 every combination of p-bits is evaluated.
+    High,
+};
+
+// 4x4 block encoders. Every function takes the 16 texels of one block as RGBA8, row by row, and writes one block in
+// the format's native layout. The nearest palette entry search, which is where the time goes, uses AVX2 or SSE4.1
+// where the target has them and produces the same blocks either way.
+namespace BlockCompression
+{
+// Bytes per 4x4 block.
+uint32_t getBlockBytes(BlockFormat format);
+
+void encodeBC1(const uint8_t *texels, CompressionPreset preset, uint8_t *block);
+void encodeBC5(const uint8_t *texels, CompressionPreset preset, uint8_t *block);
+void encodeBC7(const uint8_t *texels, CompressionPreset preset, uint8_t *block);
+void encode(BlockFormat format, const uint8_t *texels, CompressionPreset preset, uint8_t *block);
+
+// Decodes a block written by the encoders above back into 16 RGBA8 texels, for measuring their error. BC5 decodes to
+// red and green with blue 0 and alpha 255; BC7 blocks in any mode but 6 throw.
+void decode(BlockFormat format, const uint8_t *block, uint8_t *texels);
+
+// "AVX2", "SSE4.1" or "scalar".
+const char *getInstructionSet();
+} // namespace BlockCompression
\ No newline at end of file
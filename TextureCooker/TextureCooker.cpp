@@ -0,0 +1,487 @@
+#include "BlockCompression.h"
+#include "CookedTexture.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace
+{
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // RGBA8, row by row.
+    std::vector<uint8_t> texels;
+};
+
+struct CookSettings
+{
+    CompressionPreset preset = CompressionPreset::Normal;
+    // Empty picks a format per texture, see chooseFormat.
+    std::optional<BlockFormat> format;
+    uint32_t threads = 0;
+};
+
+const char *getFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return "BC1";
+    case BlockFormat::BC5:
+        return "BC5";
+    case BlockFormat::BC7:
+        return "BC7";
+    }
+    return "unknown";
+}
+
+const char *getPresetName(CompressionPreset preset)
+{
+    switch (preset)
+    {
+    case CompressionPreset::Fast:
+        return "fast";
+    case CompressionPreset::Normal:
+        return "normal";
+    case CompressionPreset::High:
+        return "high";
+    }
+    return "unknown";
+}
+
+// BC5 holds normal maps, which are not colours; BC1 and BC7 hold sRGB colour.
+VkFormat getVulkanFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    case BlockFormat::BC5:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7:
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool isImageFile(const std::filesystem::path &path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" ||
+           extension == ".bmp";
+}
+
+Image loadImage(const std::filesystem::path &path)
+{
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        throw std::runtime_error("failed to load " + path.string() + ": " + stbi_failure_reason());
+    }
+    Image image;
+    image.width = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    image.texels.assign(pixels, pixels + 4ull * image.width * image.height);
+    stbi_image_free(pixels);
+    return image;
+}
+
+// Textures named *_normal or *_n are normal maps, anything with transparent texels needs BC7's alpha and the rest is
+// opaque colour, which BC1 stores in half the space.
+BlockFormat chooseFormat(const std::filesystem::path &path, const Image &image)
+{
+    std::string stem = path.stem().string();
+    if (stem.ends_with("_normal") || stem.ends_with("_n"))
+    {
+        return BlockFormat::BC5;
+    }
+    for (size_t i = 3; i < image.texels.size(); i += 4)
+    {
+        if (image.texels[i] != 255)
+        {
+            return BlockFormat::BC7;
+        }
+    }
+    return BlockFormat::BC1;
+}
+
+float srgbToLinear(uint8_t value)
+{
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t linearToSrgb(float value)
+{
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(std::lrint(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+}
+
+// Box filters 2x2 texels into one, clamping at odd edges. sRGB colour is averaged in linear light so the mips do not
+// darken, alpha and the channels of normal maps are averaged as they are.
+Image downsample(const Image &image, bool srgb)
+{
+    static const std::vector<float> linearTable = [] {
+        std::vector<float> table(256);
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            table[i] = srgbToLinear(static_cast<uint8_t>(i));
+        }
+        return table;
+    }();
+
+    Image result;
+    result.width = std::max(image.width / 2, 1u);
+    result.height = std::max(image.height / 2, 1u);
+    result.texels.resize(4ull * result.width * result.height);
+    for (uint32_t y = 0; y < result.height; y++)
+    {
+        for (uint32_t x = 0; x < result.width; x++)
+        {
+            uint32_t x0 = std::min(x * 2, image.width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, image.width - 1);
+            uint32_t y0 = std::min(y * 2, image.height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, image.height - 1);
+            const uint8_t *sources[4] = {&image.texels[4 * (y0 * image.width + x0)],
+                                         &image.texels[4 * (y0 * image.width + x1)],
+                                         &image.texels[4 * (y1 * image.width + x0)],
+                                         &image.texels[4 * (y1 * image.width + x1)]};
+            uint8_t *target = &result.texels[4 * (y * result.width + x)];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                if (srgb && c < 3)
+                {
+                    float sum = 0.0f;
+                    for (const uint8_t *source : sources)
+                    {
+                        sum += linearTable[source[c]];
+                    }
+                    target[c] = linearToSrgb(sum / 4.0f);
+                }
+                else
+                {
+                    uint32_t sum = 2;
+                    for (const uint8_t *source : sources)
+                    {
+                        sum += source[c];
+                    }
+                    target[c] = static_cast<uint8_t>(sum / 4);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Blocks at the right and bottom edges repeat the last column and row of texels.
+void gatherBlock(const Image &image, uint32_t blockX, uint32_t blockY, uint8_t *texels)
+{
+    for (uint32_t y = 0; y < 4; y++)
+    {
+        uint32_t sourceY = std::min(blockY * 4 + y, image.height - 1);
+        for (uint32_t x = 0; x < 4; x++)
+        {
+            uint32_t sourceX = std::min(blockX * 4 + x, image.width - 1);
+            memcpy(&texels[4 * (y * 4 + x)], &image.texels[4 * (sourceY * image.width + sourceX)], 4);
+        }
+    }
+}
+
+// A row of blocks per job, which keeps the jobs large enough to be worth scheduling even for the smaller mips.
+std::vector<uint8_t> compressImage(const Image &image, BlockFormat format, CompressionPreset preset,
+                                   JobSystem &jobSystem)
+{
+    uint32_t blocksWide = (image.width + 3) / 4;
+    uint32_t blocksHigh = (image.height + 3) / 4;
+    uint32_t blockBytes = BlockCompression::getBlockBytes(format);
+    std::vector<uint8_t> blocks(static_cast<size_t>(blocksWide) * blocksHigh * blockBytes);
+    jobSystem.parallelFor(blocksHigh, [&](uint32_t blockY, uint32_t) {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++)
+        {
+            uint8_t texels[64];
+            gatherBlock(image, blockX, blockY, texels);
+            BlockCompression::encode(format, texels, preset,
+                                     &blocks[(static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes]);
+        }
+    });
+    return blocks;
+}
+
+// Peak signal to noise ratio of the compressed image over the channels the format keeps.
+double measurePsnr(const Image &image, const std::vector<uint8_t> &blocks, BlockFormat format)
+{
+    uint32_t channelCount = format == BlockFormat::BC1 ? 3 : format == BlockFormat::BC5 ? 2 : 4;
+    uint32_t blocksWide = (image.width + 3) / 4;
+    uint32_t blockBytes = BlockCompression::getBlockBytes(format);
+    double squaredError = 0.0;
+    for (uint32_t blockY = 0; blockY * 4 < image.height; blockY++)
+    {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++)
+        {
+            uint8_t texels[64];
+            BlockCompression::decode(format, &blocks[(static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes],
+                                     texels);
+            for (uint32_t y = 0; y < 4 && blockY * 4 + y < image.height; y++)
+            {
+                for (uint32_t x = 0; x < 4 && blockX * 4 + x < image.width; x++)
+                {
+                    const uint8_t *source = &image.texels[4 * ((blockY * 4 + y) * image.width + blockX * 4 + x)];
+                    for (uint32_t c = 0; c < channelCount; c++)
+                    {
+                        double difference = static_cast<double>(texels[4 * (y * 4 + x) + c]) - source[c];
+                        squaredError += difference * difference;
+                    }
+                }
+            }
+        }
+    }
+    double meanSquaredError = squaredError / (static_cast<double>(image.width) * image.height * channelCount);
+    return meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+}
+
+void cookTexture(const std::filesystem::path &source, const std::filesystem::path &target,
+                 const CookSettings &settings, JobSystem &jobSystem)
+{
+    Image image = loadImage(source);
+    BlockFormat format = settings.format.value_or(chooseFormat(source, image));
+    VkFormat vulkanFormat = getVulkanFormat(format);
+
+    std::vector<std::vector<uint8_t>> levels;
+    Image level = image;
+    for (;;)
+    {
+        levels.push_back(compressImage(level, format, settings.preset, jobSystem));
+        if (level.width == 1 && level.height == 1)
+        {
+            break;
+        }
+        level = downsample(level, format != BlockFormat::BC5);
+    }
+
+    std::filesystem::create_directories(target.parent_path());
+    CookedTexture::write(target.string(), vulkanFormat, {image.width, image.height}, levels);
+    size_t size = 0;
+    for (const std::vector<uint8_t> &data : levels)
+    {
+        size += data.size();
+    }
+    std::cout << source.string() << ": " << getFormatName(format) << " " << image.width << "x" << image.height
+              << ", " << levels.size() << " levels, " << size << " bytes" << std::endl;
+}
+
+// Cooks every image below input into a .ctex file at the same relative path below output.
+void cookDirectory(const std::filesystem::path &output, const std::filesystem::path &input,
+                   const CookSettings &settings)
+{
+    JobSystem jobSystem(settings.threads);
+    auto start = std::chrono::steady_clock::now();
+    uint32_t textureCount = 0;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(input))
+    {
+        if (entry.is_regular_file() && isImageFile(entry.path()))
+        {
+            std::filesystem::path target = output / entry.path().lexically_relative(input);
+            target.replace_extension(".ctex");
+            cookTexture(entry.path(), target, settings, jobSystem);
+            textureCount++;
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Cooked " << textureCount << " textures with the " << getPresetName(settings.preset) << " preset in "
+              << elapsed.count() << " ms" << std::endl;
+}
+
+// Smooth gradients with noise and an alpha ramp, so every format has something to do without an input image.
+Image createBenchmarkImage()
+{
+    Image image;
+    image.width = 1024;
+    image.height = 1024;
+    image.texels.resize(4ull * image.width * image.height);
+    uint32_t state = 12345;
+    for (uint32_t y = 0; y < image.height; y++)
+    {
+        for (uint32_t x = 0; x < image.width; x++)
+        {
+            state = state * 1664525u + 1013904223u;
+            uint32_t noise = state >> 28;
+            uint8_t *texel = &image.texels[4 * (y * image.width + x)];
+            texel[0] = static_cast<uint8_t>(std::min(x / 4 + noise, 255u));
+            texel[1] = static_cast<uint8_t>(std::min(y / 4 + noise, 255u));
+            texel[2] = static_cast<uint8_t>(std::min((x + y) / 8 + noise, 255u));
+            texel[3] = static_cast<uint8_t>(255 - std::min((x ^ y) / 8, 255u));
+        }
+    }
+    return image;
+}
+
+// Compresses the images' top levels with every format and preset for at least a second each and reports the
+// throughput in megapixels per second, and the quality as PSNR.
+void runBenchmark(const std::vector<std::filesystem::path> &paths, const CookSettings &settings)
+{
+    std::vector<Image> images;
+    for (const std::filesystem::path &path : paths)
+    {
+        images.push_back(loadImage(path));
+    }
+    if (images.empty())
+    {
+        images.push_back(createBenchmarkImage());
+    }
+    uint64_t texelCount = 0;
+    for (const Image &image : images)
+    {
+        texelCount += static_cast<uint64_t>(image.width) * image.height;
+    }
+
+    JobSystem jobSystem(settings.threads);
+    std::cout << "Benchmarking " << texelCount / 1e6 << " MP with " << BlockCompression::getInstructionSet()
+              << " on " << jobSystem.getWorkerCount() << " threads" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (BlockFormat format : {BlockFormat::BC1, BlockFormat::BC5, BlockFormat::BC7})
+    {
+        if (settings.format.has_value() && settings.format != format)
+        {
+            continue;
+        }
+        for (CompressionPreset preset : {CompressionPreset::Fast, CompressionPreset::Normal, CompressionPreset::High})
+        {
+            std::vector<std::vector<uint8_t>> results(images.size());
+            uint32_t repetitions = 0;
+            auto start = std::chrono::steady_clock::now();
+            std::chrono::duration<double> elapsed{0};
+            while (elapsed.count() < 1.0)
+            {
+                for (size_t i = 0; i < images.size(); i++)
+                {
+                    results[i] = compressImage(images[i], format, preset, jobSystem);
+                }
+                repetitions++;
+                elapsed = std::chrono::steady_clock::now() - start;
+            }
+
+            double psnr = 0.0;
+            for (size_t i = 0; i < images.size(); i++)
+            {
+                psnr += measurePsnr(images[i], results[i], format) / static_cast<double>(images.size());
+            }
+            std::cout << getFormatName(format) << " " << std::left << std::setw(7) << getPresetName(preset)
+                      << std::right << std::setw(9) << texelCount * repetitions / 1e6 / elapsed.count() << " MP/s"
+                      << std::setw(8) << psnr << " dB PSNR" << std::endl;
+        }
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        CookSettings settings;
+        bool benchmark = false;
+        std::vector<std::filesystem::path> paths;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string argument = argv[i];
+            if (argument == "--benchmark")
+            {
+                benchmark = true;
+            }
+            else if (argument == "--preset" && i + 1 < argc)
+            {
+                std::string preset = argv[++i];
+                if (preset == "fast")
+                {
+                    settings.preset = CompressionPreset::Fast;
+                }
+                else if (preset == "normal")
+                {
+                    settings.preset = CompressionPreset::Normal;
+                }
+                else if (preset == "high")
+                {
+                    settings.preset = CompressionPreset::High;
+                }
+                else
+                {
+                    throw std::runtime_error("unknown preset: " + preset);
+                }
+            }
+            else if (argument == "--format" && i + 1 < argc)
+            {
+                std::string format = argv[++i];
+                if (format == "bc1")
+                {
+                    settings.format = BlockFormat::BC1;
+                }
+                else if (format == "bc5")
+                {
+                    settings.format = BlockFormat::BC5;
+                }
+                else if (format == "bc7")
+                {
+                    settings.format = BlockFormat::BC7;
+                }
+                else if (format != "auto")
+                {
+                    throw std::runtime_error("unknown format: " + format);
+                }
+            }
+            else if (argument == "--threads" && i + 1 < argc)
+            {
+                settings.threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (argument.starts_with("--"))
+            {
+                throw std::runtime_error("unknown argument: " + argument);
+            }
+            else
+            {
+                paths.push_back(argument);
+            }
+        }
+
+        if (benchmark)
+        {
+            runBenchmark(paths, settings);
+        }
+        else if (paths.size() == 2)
+        {
+            cookDirectory(paths[0], paths[1], settings);
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--preset fast|normal|high] [--format auto|bc1|bc5|bc7] [--threads N]"
+                         " <output directory> <input directory>\n"
+                      << "       " << argv[0] << " --benchmark [--format bc1|bc5|bc7] [--threads N] [image]..."
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
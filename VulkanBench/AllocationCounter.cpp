@@ -0,0 +1,37 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<uint64_t> heapAllocationCount{0};
+} // namespace
+
+uint64_t getHeapAllocationCount()
+{
+    return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms call these by default. Aligned allocations keep the standard library's own pair and
+// are not counted.
+void *operator new(std::size_t size)
+{
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size != 0 ? size : 1))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+// Number of calls to the global operator new so far, which VulkanBench replaces to count heap allocations.
+uint64_t getHeapAllocationCount();
\ No newline at end of file
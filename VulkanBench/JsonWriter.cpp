@@ -0,0 +1,139 @@
+#include "JsonWriter.h"
+
+#include <cmath>
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream &stream) : stream(stream)
+{
+    stream.precision(6);
+}
+
+void JsonWriter::beginObject()
+{
+    beginValue();
+    stream << '{';
+    hasValues.push_back(false);
+}
+
+void JsonWriter::endObject()
+{
+    bool hadValues = hasValues.back();
+    hasValues.pop_back();
+    if (hadValues)
+    {
+        newLine();
+    }
+    stream << '}';
+    if (hasValues.empty())
+    {
+        stream << '\n';
+    }
+}
+
+void JsonWriter::beginArray()
+{
+    beginValue();
+    stream << '[';
+    hasValues.push_back(false);
+}
+
+void JsonWriter::endArray()
+{
+    bool hadValues = hasValues.back();
+    hasValues.pop_back();
+    if (hadValues)
+    {
+        newLine();
+    }
+    stream << ']';
+}
+
+void JsonWriter::key(std::string_view name)
+{
+    beginValue();
+    writeString(name);
+    stream << ": ";
+    afterKey = true;
+}
+
+void JsonWriter::value(double number)
+{
+    beginValue();
+    if (std::isfinite(number))
+    {
+        stream << number;
+    }
+    else
+    {
+        stream << "null";
+    }
+}
+
+void JsonWriter::value(uint64_t number)
+{
+    beginValue();
+    stream << number;
+}
+
+void JsonWriter::value(uint32_t number)
+{
+    value(static_cast<uint64_t>(number));
+}
+
+void JsonWriter::value(std::string_view text)
+{
+    beginValue();
+    writeString(text);
+}
+
+void JsonWriter::beginValue()
+{
+    // The key already placed the value.
+    if (afterKey)
+    {
+        afterKey = false;
+        return;
+    }
+    if (hasValues.empty())
+    {
+        return;
+    }
+    if (hasValues.back())
+    {
+        stream << ',';
+    }
+    hasValues.back() = true;
+    newLine();
+}
+
+void JsonWriter::writeString(std::string_view text)
+{
+    stream << '"';
+    for (char character : text)
+    {
+        if (character == '"' || character == '\\')
+        {
+            stream << '\\' << character;
+        }
+        else if (static_cast<unsigned char>(character) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+            stream << escaped;
+        }
+        else
+        {
+            stream << character;
+        }
+    }
+    stream << '"';
+}
+
+void JsonWriter::newLine()
+{
+    stream << '\n';
+    for (size_t i = 0; i < hasValues.size(); i++)
+    {
+        stream << "  ";
+    }
+}
\ No newline at end of file
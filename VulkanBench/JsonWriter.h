@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Streams indented JSON. Objects take key() before every value, arrays take bare values.
+class JsonWriter
+{
+  public:
+    explicit JsonWriter(std::ostream &stream);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void key(std::string_view name);
+
+    // Infinity and NaN are written as null.
+    void value(double number);
+    void value(uint64_t number);
+    void value(uint32_t number);
+    void value(std::string_view text);
+
+  private:
+    std::ostream &stream;
+    // One entry per open object or array, whether it has had a value yet.
+    std::vector<bool> hasValues;
+    bool afterKey = false;
+
+    void beginValue();
+    void writeString(std::string_view text);
+    void newLine();
+};
\ No newline at end of file
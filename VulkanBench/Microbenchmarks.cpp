@@ -0,0 +1,470 @@
+#include "Microbenchmarks.h"
+
+#include "AllocationCounter.h"
+#include "AssetPack.h"
+#include "DeviceMemoryAllocator.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "VertexFormats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+constexpr uint32_t repetitions = 5;
+constexpr uint32_t assetFileCount = 256;
+constexpr size_t assetFileSize = 16 * 1024;
+
+// Keeps the compiler from optimising a benchmark's work away.
+volatile uint64_t sink;
+
+struct Benchmark
+{
+    const char *name;
+    uint32_t iterations;
+    // Prepares the benchmark and returns the work of one iteration. Throws if the benchmark can not run here.
+    std::function<std::function<void()>()> setUp;
+};
+
+// The files the file loading benchmarks read, written once per run with the same contents every time.
+class AssetFiles
+{
+  public:
+    AssetFiles()
+    {
+        directory = std::filesystem::temp_directory_path() / "VulkanBenchAssets";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+
+        std::mt19937 random(1);
+        std::vector<AssetPack::Asset> assets;
+        for (uint32_t i = 0; i < assetFileCount; i++)
+        {
+            AssetPack::Asset asset;
+            asset.name = "asset" + std::to_string(i) + ".bin";
+            asset.data.resize(assetFileSize);
+            std::generate(asset.data.begin(), asset.data.end(), [&]() { return static_cast<uint8_t>(random()); });
+
+            std::ofstream file(directory / asset.name, std::ios::binary);
+            file.write(reinterpret_cast<const char *>(asset.data.data()), asset.data.size());
+            names.push_back(asset.name);
+            assets.push_back(std::move(asset));
+        }
+        packPath = (directory / "assets.pack").string();
+        AssetPack::write(packPath, std::move(assets));
+    }
+
+    ~AssetFiles()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    std::filesystem::path directory;
+    std::string packPath;
+    std::vector<std::string> names;
+};
+
+// A device without any extensions or queues in use, enough for DeviceMemoryAllocator.
+class BenchDevice
+{
+  public:
+    BenchDevice()
+    {
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "VulkanBench";
+        appInfo.apiVersion = VK_API_VERSION_1_2;
+
+        VkInstanceCreateInfo instanceInfo{};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+        if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create instance!");
+        }
+
+        uint32_t deviceCount = 1;
+        VkResult result = vkEnumeratePhysicalDevices(instance, &deviceCount, &physicalDevice);
+        if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || deviceCount == 0)
+        {
+            vkDestroyInstance(instance, nullptr);
+            throw std::runtime_error("failed to find GPUs with Vulkan support!");
+        }
+
+        float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = 0;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &queuePriority;
+
+        VkDeviceCreateInfo deviceInfo{};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS)
+        {
+            vkDestroyInstance(instance, nullptr);
+            throw std::runtime_error("failed to create logical device!");
+        }
+        vkGetDeviceQueue(device, 0, 0, &queue);
+    }
+
+    ~BenchDevice()
+    {
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+
+    BenchDevice(const BenchDevice &) = delete;
+    BenchDevice &operator=(const BenchDevice &) = delete;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    // Of family 0, which every implementation lets transfer.
+    VkQueue queue = VK_NULL_HANDLE;
+};
+
+// 1024 allocations from 256 bytes to 64 KiB, freed in a shuffled order. The allocator is declared after the device
+// so it is destroyed first.
+struct DeviceAllocatorState
+{
+    BenchDevice device;
+    DeviceMemoryAllocator allocator{device.physicalDevice, device.device};
+    std::vector<VkMemoryRequirements> requirements;
+    std::vector<size_t> freeOrder;
+
+    DeviceAllocatorState() : requirements(1024), freeOrder(1024)
+    {
+        std::mt19937 random(1);
+        for (VkMemoryRequirements &requirement : requirements)
+        {
+            requirement.size = VkDeviceSize{256} << (random() % 9);
+            requirement.alignment = 256;
+            requirement.memoryTypeBits = UINT32_MAX;
+        }
+        for (size_t i = 0; i < freeOrder.size(); i++)
+        {
+            freeOrder[i] = i;
+        }
+        std::shuffle(freeOrder.begin(), freeOrder.end(), random);
+    }
+};
+
+// 512 buffers from 4 KiB to 64 KiB in 1 MiB blocks, every other one destroyed before each defragmentation so the
+// blocks are left half empty.
+struct DefragmentationState
+{
+    BenchDevice device;
+    DeviceMemoryAllocator allocator{device.physicalDevice, device.device, 1024 * 1024};
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    std::vector<VkDeviceSize> sizes;
+
+    DefragmentationState() : sizes(512)
+    {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = 0;
+        if (vkCreateCommandPool(device.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device.device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            vkDestroyCommandPool(device.device, commandPool, nullptr);
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        std::mt19937 random(1);
+        for (VkDeviceSize &size : sizes)
+        {
+            size = VkDeviceSize{4096} << (random() % 5);
+        }
+    }
+
+    ~DefragmentationState()
+    {
+        vkDestroyCommandPool(device.device, commandPool, nullptr);
+    }
+
+    DefragmentationState(const DefragmentationState &) = delete;
+    DefragmentationState &operator=(const DefragmentationState &) = delete;
+
+    // Returns the number of buffers moved.
+    uint32_t run()
+    {
+        std::vector<DeviceMemoryAllocator::Allocation *> buffers;
+        for (VkDeviceSize size : sizes)
+        {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            buffers.push_back(allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        }
+        for (size_t i = 0; i < buffers.size(); i += 2)
+        {
+            allocator.destroyBuffer(buffers[i]);
+            buffers[i] = nullptr;
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        DeviceMemoryAllocator::DefragmentationResult result = allocator.defragment(commandBuffer);
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (vkQueueSubmit(device.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit defragmentation command buffer!");
+        }
+        vkQueueWaitIdle(device.queue);
+        allocator.finishDefragmentation(result);
+
+        for (DeviceMemoryAllocator::Allocation *buffer : buffers)
+        {
+            allocator.destroyBuffer(buffer);
+        }
+        return result.allocationsMoved;
+    }
+};
+
+std::vector<Benchmark> getBenchmarks()
+{
+    // Shared by the benchmarks that need them, created by the first one that runs.
+    auto assetFiles = std::make_shared<std::unique_ptr<AssetFiles>>();
+    auto getAssetFiles = [assetFiles]() -> const AssetFiles & {
+        if (!*assetFiles)
+        {
+            *assetFiles = std::make_unique<AssetFiles>();
+        }
+        return **assetFiles;
+    };
+
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({"asset-pack-load", 100, [getAssetFiles]() -> std::function<void()> {
+                              const AssetFiles &files = getAssetFiles();
+                              return [&files]() {
+                                  AssetPack pack(files.packPath);
+                                  uint64_t sum = 0;
+                                  for (const std::string &name : files.names)
+                                  {
+                                      std::span<const uint8_t> data = pack.get(name);
+                                      // One byte per page, so every page is faulted in like a real upload would.
+                                      for (size_t i = 0; i < data.size(); i += 4096)
+                                      {
+                                          sum += data[i];
+                                      }
+                                  }
+                                  sink = sum;
+                              };
+                          }});
+
+    benchmarks.push_back({"ifstream-load", 100, [getAssetFiles]() -> std::function<void()> {
+                              const AssetFiles &files = getAssetFiles();
+                              return [&files]() {
+                                  uint64_t sum = 0;
+                                  for (const std::string &name : files.names)
+                                  {
+                                      std::ifstream file(files.directory / name, std::ios::ate | std::ios::binary);
+                                      std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+                                      file.seekg(0);
+                                      file.read(reinterpret_cast<char *>(data.data()), data.size());
+                                      sum += data[0];
+                                  }
+                                  sink = sum;
+                              };
+                          }});
+
+    for (VertexFormat format : {VertexFormat::Half, VertexFormat::Snorm16})
+    {
+        benchmarks.push_back(
+            {format == VertexFormat::Half ? "vertex-encode-half" : "vertex-encode-snorm16", 50,
+             [format]() -> std::function<void()> {
+                 auto vertices = std::make_shared<std::vector<Vertex>>(Mesh::createGrid(256).vertices);
+                 return [vertices, format]() { sink = VertexFormats::encode(*vertices, format).size(); };
+             }});
+    }
+
+    // Set up checks the round trip first, so a broken SSE2 path shows up as an error instead of a fast time.
+    benchmarks.push_back({"normal-encode-octahedral", 50, []() -> std::function<void()> {
+                              auto normals = std::make_shared<std::vector<glm::vec3>>(65536);
+                              std::mt19937 random(1);
+                              std::normal_distribution<float> distribution;
+                              for (glm::vec3 &normal : *normals)
+                              {
+                                  normal = glm::normalize(
+                                      glm::vec3(distribution(random), distribution(random), distribution(random)));
+                              }
+                              auto encoded = std::make_shared<std::vector<uint32_t>>(normals->size());
+                              VertexFormats::encodeOctahedral(normals->data(), normals->size(), encoded->data());
+                              for (size_t i = 0; i < normals->size(); i++)
+                              {
+                                  if (glm::dot((*normals)[i], VertexFormats::decodeOctahedral((*encoded)[i])) <
+                                      0.99999f)
+                                  {
+                                      throw std::runtime_error("octahedral normal round trip is too lossy!");
+                                  }
+                              }
+                              return [normals, encoded]() {
+                                  VertexFormats::encodeOctahedral(normals->data(), normals->size(), encoded->data());
+                                  sink = (*encoded)[0];
+                              };
+                          }});
+
+    benchmarks.push_back({"mesh-optimize", 5, []() -> std::function<void()> {
+                              auto grid = std::make_shared<Mesh>(Mesh::createGrid(128));
+                              return [grid]() {
+                                  Mesh mesh = *grid;
+                                  MeshOptimizer::optimize(mesh);
+                                  sink = mesh.indices.size();
+                              };
+                          }});
+
+    benchmarks.push_back({"job-system-parallel-for", 1000, []() -> std::function<void()> {
+                              auto jobSystem = std::make_shared<JobSystem>(0);
+                              return [jobSystem]() {
+                                  std::atomic<uint64_t> sum{0};
+                                  jobSystem->parallelFor(256, [&](uint32_t index, uint32_t) {
+                                      sum.fetch_add(index, std::memory_order_relaxed);
+                                  });
+                                  sink = sum.load();
+                              };
+                          }});
+
+    // Sub-allocation only, no buffers are created, so this measures the buddy allocator and the occasional
+    // vkAllocateMemory for a new block.
+    benchmarks.push_back({"device-memory-allocate-free", 100, []() -> std::function<void()> {
+                              auto state = std::make_shared<DeviceAllocatorState>();
+                              return [state]() {
+                                  std::vector<DeviceMemoryAllocator::Allocation *> allocations;
+                                  allocations.reserve(state->requirements.size());
+                                  for (const VkMemoryRequirements &requirements : state->requirements)
+                                  {
+                                      allocations.push_back(state->allocator.allocate(
+                                          requirements, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                          DeviceMemoryAllocator::ResourceKind::Linear));
+                                  }
+                                  // Freed out of order so the buddies have to coalesce.
+                                  for (size_t index : state->freeOrder)
+                                  {
+                                      state->allocator.free(allocations[index]);
+                                  }
+                              };
+                          }});
+
+    // Creating, fragmenting and destroying the buffers is part of every iteration, the copies run on the GPU.
+    benchmarks.push_back({"device-memory-defragment", 20, []() -> std::function<void()> {
+                              auto state = std::make_shared<DefragmentationState>();
+                              if (state->run() == 0)
+                              {
+                                  throw std::runtime_error("defragmentation did not move any buffers!");
+                              }
+                              return [state]() { sink = state->run(); };
+                          }});
+
+    return benchmarks;
+}
+
+void runBenchmark(JsonWriter &writer, const Benchmark &benchmark)
+{
+    writer.beginObject();
+    writer.key("name");
+    writer.value(std::string_view(benchmark.name));
+
+    std::function<void()> iteration;
+    try
+    {
+        iteration = benchmark.setUp();
+    }
+    catch (const std::exception &e)
+    {
+        writer.key("error");
+        writer.value(std::string_view(e.what()));
+        writer.endObject();
+        return;
+    }
+
+    // One untimed iteration first, so lazy initialisation and cold caches do not land in the first repetition.
+    iteration();
+
+    std::vector<double> nanoseconds;
+    uint64_t allocations = 0;
+    for (uint32_t repetition = 0; repetition < repetitions; repetition++)
+    {
+        uint64_t allocationsBefore = getHeapAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < benchmark.iterations; i++)
+        {
+            iteration();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        nanoseconds.push_back(elapsed.count() / benchmark.iterations);
+        allocations = getHeapAllocationCount() - allocationsBefore;
+    }
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+
+    writer.key("iterations");
+    writer.value(benchmark.iterations);
+    writer.key("repetitions");
+    writer.value(repetitions);
+    writer.key("medianNanoseconds");
+    writer.value(nanoseconds[nanoseconds.size() / 2]);
+    writer.key("minNanoseconds");
+    writer.value(nanoseconds.front());
+    writer.key("heapAllocations");
+    writer.value(static_cast<double>(allocations) / benchmark.iterations);
+    writer.endObject();
+}
+} // namespace
+
+namespace Microbenchmarks
+{
+std::vector<std::string> getNames()
+{
+    std::vector<std::string> names;
+    for (const Benchmark &benchmark : getBenchmarks())
+    {
+        names.push_back(benchmark.name);
+    }
+    return names;
+}
+
+void run(JsonWriter &writer, const std::vector<std::string> &names)
+{
+    for (const Benchmark &benchmark : getBenchmarks())
+    {
+        if (names.empty() || std::find(names.begin(), names.end(), benchmark.name) != names.end())
+        {
+            runBenchmark(writer, benchmark);
+        }
+    }
+}
+} // namespace Microbenchmarks
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include "JsonWriter.h"
+
+#include <string>
+#include <vector>
+
+// Benchmarks of CPU-side subsystems, each written as one JSON object with the time and heap allocations per
+// iteration. Every benchmark runs a fixed number of iterations several times over, the median repetition is the
+// headline number and the fastest shows how noisy the machine was.
+namespace Microbenchmarks
+{
+std::vector<std::string> getNames();
+
+// Runs the benchmarks whose names are in names, or all of them when names is empty.
+void run(JsonWriter &writer, const std::vector<std::string> &names);
+} // namespace Microbenchmarks
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "Scenes.h"
+
+#include "AllocationCounter.h"
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+namespace
+{
+constexpr uint32_t width = 1280;
+constexpr uint32_t height = 720;
+
+// Nearest-rank percentiles, the same definition GpuProfiler prints.
+void writeDistribution(JsonWriter &writer, std::vector<double> values)
+{
+    writer.beginObject();
+    if (!values.empty())
+    {
+        std::sort(values.begin(), values.end());
+        auto percentile = [&](double fraction) {
+            return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+        };
+        writer.key("mean");
+        writer.value(std::accumulate(values.begin(), values.end(), 0.0) / values.size());
+        writer.key("p50");
+        writer.value(percentile(0.50));
+        writer.key("p95");
+        writer.value(percentile(0.95));
+        writer.key("p99");
+        writer.value(percentile(0.99));
+        writer.key("max");
+        writer.value(values.back());
+    }
+    writer.endObject();
+}
+} // namespace
+
+namespace Scenes
+{
+std::vector<Scene> getScenes(uint32_t frameCount, const std::string &assetPackPath)
+{
+    ApplicationSettings base;
+    base.headless = true;
+    base.frameCount = frameCount;
+    base.gpuProfiling = true;
+    base.pipelineCachePath.clear();
+    base.assetPackPath = assetPackPath;
+
+    std::vector<Scene> scenes;
+
+    Scene triangles{"many-triangles", "one draw of a 512x512 quad grid, 524288 triangles", base};
+    triangles.settings.meshGridSize = 512;
+    scenes.push_back(triangles);
+
+    Scene halfTriangles{"many-triangles-half", "the many-triangles scene with half float positions", base};
+    halfTriangles.settings.meshGridSize = 512;
+    halfTriangles.settings.vertexFormat = VertexFormat::Half;
+    scenes.push_back(halfTriangles);
+
+    Scene snormTriangles{"many-triangles-snorm16", "the many-triangles scene with SNORM16 positions", base};
+    snormTriangles.settings.meshGridSize = 512;
+    snormTriangles.settings.vertexFormat = VertexFormat::Snorm16;
+    scenes.push_back(snormTriangles);
+
+    // Compare the main pass vertex invocations with many-triangles to see what the vertex cache optimisation saves.
+    Scene unoptimizedTriangles{"many-triangles-unoptimized", "the many-triangles scene without MeshOptimizer", base};
+    unoptimizedTriangles.settings.meshGridSize = 512;
+    unoptimizedTriangles.settings.optimizeMesh = false;
+    scenes.push_back(unoptimizedTriangles);
+
+    Scene draws{"many-draws", "a 128x128 quad grid split into 8192 draws, recorded on every hardware thread", base};
+    draws.settings.meshGridSize = 128;
+    draws.settings.drawCount = 8192;
+    draws.settings.recordingThreads = 0;
+    scenes.push_back(draws);
+
+    // The many-draws scene runs with the default two frames in flight, these bracket it.
+    for (uint32_t framesInFlight : {1u, 3u})
+    {
+        Scene inFlight{"frames-in-flight-" + std::to_string(framesInFlight),
+                       "the many-draws scene with " + std::to_string(framesInFlight) + " frames in flight", base};
+        inFlight.settings.meshGridSize = 128;
+        inFlight.settings.drawCount = 8192;
+        inFlight.settings.recordingThreads = 0;
+        inFlight.settings.framesInFlight = framesInFlight;
+        scenes.push_back(inFlight);
+    }
+
+    // 100000 draws of about one triangle each, so recording dominates the frame and shows how it scales with threads.
+    for (uint32_t threads : {1u, 2u, 4u, 0u})
+    {
+        std::string threadName = threads == 0 ? "all" : std::to_string(threads);
+        Scene recording{"record-100k-draws-" + threadName + "-threads",
+                        "a 256x256 quad grid split into 100000 draws, recorded on " +
+                            (threads == 0 ? std::string("every hardware thread") : threadName + " thread(s)"),
+                        base};
+        recording.settings.meshGridSize = 256;
+        recording.settings.drawCount = 100000;
+        recording.settings.recordingThreads = threads;
+        scenes.push_back(recording);
+    }
+
+    Scene culling{"gpu-culling",
+                  "the many-draws scene drawn indirectly, culled on the GPU against a camera that sees a quarter of it",
+                  base};
+    culling.settings.meshGridSize = 128;
+    culling.settings.drawCount = 8192;
+    culling.settings.gpuCulling = true;
+    culling.settings.cameraZoom = 2.0f;
+    scenes.push_back(culling);
+
+    Scene uniforms{"object-uniforms", "the many-draws scene with a model matrix per draw in the uniform ring", base};
+    uniforms.settings.meshGridSize = 128;
+    uniforms.settings.drawCount = 8192;
+    uniforms.settings.recordingThreads = 0;
+    uniforms.settings.objectUniforms = true;
+    scenes.push_back(uniforms);
+
+    Scene resizes{"resize-storm", "a 32x32 quad grid with the render targets resized every 5 frames", base};
+    resizes.settings.meshGridSize = 32;
+    resizes.settings.resizeInterval = 5;
+    scenes.push_back(resizes);
+
+    Scene uploads{"upload-heavy", "65536 instances whose data is rewritten and streamed to the GPU every frame", base};
+    uploads.settings.meshGridSize = 4;
+    uploads.settings.instanceCount = 65536;
+    scenes.push_back(uploads);
+
+    Scene postProcessing{"post-processing", "the many-triangles scene bloomed and tonemapped on the compute queue",
+                         base};
+    postProcessing.settings.meshGridSize = 512;
+    postProcessing.settings.postProcessing = true;
+    scenes.push_back(postProcessing);
+
+    Scene inlinePostProcessing{"post-processing-inline", "the post-processing scene on the graphics queue", base};
+    inlinePostProcessing.settings.meshGridSize = 512;
+    inlinePostProcessing.settings.postProcessing = true;
+    inlinePostProcessing.settings.asyncCompute = false;
+    scenes.push_back(inlinePostProcessing);
+
+    return scenes;
+}
+
+void run(const Scene &scene, JsonWriter &writer)
+{
+    HelloTriangleApplication app(width, height, scene.settings);
+
+    // Heap allocations are counted between the first and the last delivered frame, which leaves out startup and
+    // shutdown.
+    uint64_t firstFrameAllocations = 0;
+    uint64_t lastFrameAllocations = 0;
+    uint64_t deliveredFrames = 0;
+    app.setFrameReadbackCallback([&](const uint8_t *, VkExtent2D, uint64_t) {
+        uint64_t allocations = getHeapAllocationCount();
+        if (deliveredFrames++ == 0)
+        {
+            firstFrameAllocations = allocations;
+        }
+        lastFrameAllocations = allocations;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    app.run();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    const HelloTriangleApplication::RunStatistics &statistics = app.getStatistics();
+
+    // The first frames pay for pipeline and page warm-up, they would only add noise to the percentiles.
+    size_t warmupFrames = std::min<size_t>(10, statistics.frameMilliseconds.size() / 10);
+    std::vector<double> frameMilliseconds(statistics.frameMilliseconds.begin() + warmupFrames,
+                                          statistics.frameMilliseconds.end());
+
+    writer.beginObject();
+    writer.key("name");
+    writer.value(scene.name);
+    writer.key("description");
+    writer.value(scene.description);
+    writer.key("frames");
+    writer.value(static_cast<uint64_t>(statistics.frameMilliseconds.size()));
+    writer.key("warmupFrames");
+    writer.value(static_cast<uint64_t>(warmupFrames));
+    writer.key("totalMilliseconds");
+    writer.value(elapsed.count());
+    writer.key("cpuFrameMilliseconds");
+    writeDistribution(writer, frameMilliseconds);
+    writer.key("cpuRecordingMilliseconds");
+    writer.value(statistics.averageRecordingMilliseconds);
+    writer.key("gpuFrameMilliseconds");
+    writeDistribution(writer, statistics.gpuFrameMilliseconds);
+    writer.key("gpuZoneMilliseconds");
+    writer.beginObject();
+    for (const auto &[zone, milliseconds] : statistics.gpuZoneMilliseconds)
+    {
+        writer.key(zone);
+        writer.value(milliseconds);
+    }
+    writer.endObject();
+    writer.key("gpuZoneVertexInvocations");
+    writer.beginObject();
+    for (const auto &[zone, invocations] : statistics.gpuZoneVertexInvocations)
+    {
+        writer.key(zone);
+        writer.value(invocations);
+    }
+    writer.endObject();
+    writer.key("heapAllocationsPerFrame");
+    writer.value(deliveredFrames > 1 ? static_cast<double>(lastFrameAllocations - firstFrameAllocations) /
+                                           static_cast<double>(deliveredFrames - 1)
+                                     : 0.0);
+    if (scene.settings.gpuCulling)
+    {
+        writer.key("culledObjectsPerFrame");
+        writer.value(statistics.averageCulledObjects);
+    }
+    writer.key("vertexBufferBytes");
+    writer.value(statistics.vertexBufferBytes);
+    writer.key("deviceAllocations");
+    writer.value(statistics.deviceAllocationCount);
+    writer.key("swapChainRecreations");
+    writer.value(statistics.swapChainRecreations);
+    writer.key("graphicsPipelineCreations");
+    writer.value(statistics.graphicsPipelineCreations);
+    writer.endObject();
+}
+} // namespace Scenes
\ No newline at end of file
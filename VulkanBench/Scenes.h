@@ -0,0 +1,24 @@
+#pragma once
+#include "ApplicationSettings.h"
+#include "JsonWriter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Scenes
+{
+struct Scene
+{
+    std::string name;
+    std::string description;
+    ApplicationSettings settings;
+};
+
+// The scripted scenes. All run headless for exactly frameCount frames with GPU profiling on and the pipeline cache in
+// memory only, so every run starts from the same state.
+std::vector<Scene> getScenes(uint32_t frameCount, const std::string &assetPackPath);
+
+// Runs the scene in a fresh HelloTriangleApplication and writes its results as one JSON object.
+void run(const Scene &scene, JsonWriter &writer);
+} // namespace Scenes
\ No newline at end of file
@@ -0,0 +1,161 @@
+// VulkanBench: runs the scripted scenes and the CPU microbenchmarks and writes the results as JSON, so numbers from
+// different commits can be compared. Meant to run headless on lavapipe in CI (point VK_DRIVER_FILES at lvp_icd.json),
+// numbers from a hardware driver are only comparable on the same machine.
+
+#include "Microbenchmarks.h"
+#include "Scenes.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct BenchSettings
+{
+    uint32_t frameCount = 300;
+    std::string assetPackPath = "content.pack";
+    std::string outputPath = "bench_results.json";
+    // Scene and microbenchmark names to run, everything when empty.
+    std::vector<std::string> only;
+    bool runScenes = true;
+    bool runMicrobenchmarks = true;
+    bool list = false;
+};
+
+BenchSettings parseArguments(int argc, char *argv[])
+{
+    BenchSettings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--frames" && i + 1 < argc)
+        {
+            settings.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--assets" && i + 1 < argc)
+        {
+            settings.assetPackPath = argv[++i];
+        }
+        else if (argument == "--output" && i + 1 < argc)
+        {
+            settings.outputPath = argv[++i];
+        }
+        else if (argument == "--only" && i + 1 < argc)
+        {
+            settings.only.push_back(argv[++i]);
+        }
+        else if (argument == "--no-scenes")
+        {
+            settings.runScenes = false;
+        }
+        else if (argument == "--no-microbenchmarks")
+        {
+            settings.runMicrobenchmarks = false;
+        }
+        else if (argument == "--list")
+        {
+            settings.list = true;
+        }
+        else
+        {
+            throw std::runtime_error("unknown argument: " + argument);
+        }
+    }
+    if (settings.frameCount == 0)
+    {
+        throw std::runtime_error("--frames must be at least 1");
+    }
+    return settings;
+}
+
+bool isSelected(const BenchSettings &settings, const std::string &name)
+{
+    return settings.only.empty() || std::find(settings.only.begin(), settings.only.end(), name) != settings.only.end();
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        BenchSettings settings = parseArguments(argc, argv);
+        std::vector<Scenes::Scene> scenes = Scenes::getScenes(settings.frameCount, settings.assetPackPath);
+
+        if (settings.list)
+        {
+            for (const Scenes::Scene &scene : scenes)
+            {
+                std::cout << "scene " << scene.name << ": " << scene.description << std::endl;
+            }
+            for (const std::string &name : Microbenchmarks::getNames())
+            {
+                std::cout << "microbenchmark " << name << std::endl;
+            }
+            return EXIT_SUCCESS;
+        }
+
+        std::ofstream output(settings.outputPath);
+        if (!output)
+        {
+            throw std::runtime_error("failed to open " + settings.outputPath + " for writing!");
+        }
+        JsonWriter writer(output);
+        writer.beginObject();
+        writer.key("frames");
+        writer.value(settings.frameCount);
+
+        writer.key("scenes");
+        writer.beginArray();
+        if (settings.runScenes)
+        {
+            for (const Scenes::Scene &scene : scenes)
+            {
+                if (isSelected(settings, scene.name))
+                {
+                    std::cout << "Running scene " << scene.name << std::endl;
+                    Scenes::run(scene, writer);
+                }
+            }
+        }
+        writer.endArray();
+
+        writer.key("microbenchmarks");
+        writer.beginArray();
+        if (settings.runMicrobenchmarks)
+        {
+            std::vector<std::string> names;
+            for (const std::string &name : Microbenchmarks::getNames())
+            {
+                if (isSelected(settings, name))
+                {
+                    names.push_back(name);
+                }
+            }
+            if (!names.empty())
+            {
+                std::cout << "Running microbenchmarks" << std::endl;
+                Microbenchmarks::run(writer, names);
+            }
+        }
+        writer.endArray();
+        writer.endObject();
+
+        if (!output)
+        {
+            throw std::runtime_error("failed to write " + settings.outputPath + "!");
+        }
+        std::cout << "Wrote " << settings.outputPath << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
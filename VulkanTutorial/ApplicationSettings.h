@@ -0,0 +1,72 @@
+#pragma once
+#include "VertexFormats.h"
+#include <cstdint>
+#include <string>
+
+struct ApplicationSettings
+{
+    // Render into offscreen images instead of a window surface, no GLFW window is created.
+    bool headless = false;
+    // Number of frames to render before mainLoop returns, 0 runs until the window is closed.
+    // Headless runs fall back to defaultHeadlessFrameCount.
+    uint32_t frameCount = 0;
+    // Headless only: the last rendered frame is written to this path as a binary PPM.
+    std::string dumpFramePath;
+    // Headless only: resize the offscreen targets every resizeInterval frames, cycling through sizes around the
+    // requested one. 0 never resizes.
+    uint32_t resizeInterval = 0;
+    // Number of frames the CPU may record and submit ahead of the GPU, 1 to maxFramesInFlightLimit.
+    uint32_t framesInFlight = 2;
+    // Draw a meshGridSize x meshGridSize grid of quads instead of the single triangle, 0 keeps the triangle.
+    uint32_t meshGridSize = 0;
+    // Run the mesh through MeshOptimizer at load time, disable to measure the unoptimised mesh.
+    bool optimizeMesh = true;
+    // Pipeline cache file loaded at startup and written back at shutdown, empty keeps the cache in memory only.
+    std::string pipelineCachePath = "pipeline_cache.bin";
+    // What every physical device supports, probed on the first launch and reused until the driver changes. Empty
+    // probes on every launch.
+    std::string deviceCachePath = "device_cache.bin";
+    // Asset pack built from the content folder by AssetPacker, every shader is loaded from it.
+    std::string assetPackPath = "content.pack";
+    // Content directory to watch for edited shaders, GLSL is recompiled with glslc from PATH. Empty disables hot
+    // reload.
+    std::string shaderWatchPath;
+    // Record the draws into secondary command buffers executed from the frame's primary one.
+    bool useSecondaryCommandBuffers = false;
+    // Split the mesh into this many draw calls, to load the CPU side of command recording.
+    uint32_t drawCount = 1;
+    // Threads recording secondary command buffers in parallel, 0 uses every hardware thread. Anything but 1 implies
+    // useSecondaryCommandBuffers.
+    uint32_t recordingThreads = 1;
+    // Cull the draw list against the frustum in a compute pass and draw the survivors with indirect draws, the CPU
+    // records the same handful of commands however many objects there are.
+    bool gpuCulling = false;
+    // Magnification of the camera, which circles over the mesh grid. Above 1 only part of the grid is in view and GPU
+    // culling has objects to reject, 1 shows all of it.
+    float cameraZoom = 1.0f;
+    // Draw the mesh this many times in one instanced draw, with per-instance transforms and colours streamed every
+    // frame. 0 draws it once without instancing. Can not be combined with gpuCulling.
+    uint32_t instanceCount = 0;
+    // Give every draw its own model matrix, sub-allocated each frame from a persistently mapped uniform ring and bound
+    // with a dynamic offset, and a tint passed as a push constant. Can not be combined with gpuCulling or instancing.
+    bool objectUniforms = false;
+    // Every PNG, JPEG, TGA and BMP file in this directory is decoded in the background and uploaded with GPU generated
+    // mips while frames are rendered. Empty loads no textures.
+    std::string textureDirectory;
+    // Render the scene into an HDR image and bloom and tonemap it with compute passes before it is presented.
+    bool postProcessing = false;
+    // Post-processing only: run the compute passes on a separate compute queue, overlapped with the next frame's
+    // rasterisation at the cost of a frame of latency. Falls back to the graphics queue on devices without a second
+    // queue.
+    bool asyncCompute = true;
+    // Layout of the vertex buffer. The quantised formats shrink a vertex from 20 to 8 bytes.
+    VertexFormat vertexFormat = VertexFormat::Float;
+    // Measure GPU time per frame and per pass with timestamp queries, and invocation counts with pipeline statistics
+    // queries where supported. Printed when mainLoop returns.
+    bool gpuProfiling = false;
+    // Profiler builds only: Chrome trace JSON of the CPU zones, written when mainLoop returns and when F12 is pressed.
+    std::string cpuTracePath;
+
+    static constexpr uint32_t defaultHeadlessFrameCount = 1000;
+    static constexpr uint32_t maxFramesInFlightLimit = 4;
+};
@@ -0,0 +1,701 @@
+#include "DeviceMemoryAllocator.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+// Smallest buddy, order 0. Anything smaller is rounded up to it.
+constexpr VkDeviceSize minimumAllocationSize = 256;
+
+VkDeviceSize roundUpToPowerOfTwo(VkDeviceSize value)
+{
+    VkDeviceSize result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+VkDeviceSize roundDownToPowerOfTwo(VkDeviceSize value)
+{
+    VkDeviceSize result = 1;
+    while (result <= value / 2)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+uint32_t orderOf(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while ((minimumAllocationSize << order) < size)
+    {
+        order++;
+    }
+    return order;
+}
+
+VkDeviceSize sizeOfOrder(uint32_t order)
+{
+    return minimumAllocationSize << order;
+}
+} // namespace
+
+struct DeviceMemoryAllocator::Block
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+    uint32_t memoryTypeIndex = 0;
+    // A dedicated block holds exactly one allocation of arbitrary size and is not split.
+    bool dedicated = false;
+    uint32_t maxOrder = 0;
+    // freeLists[order] holds the offsets of free buddies of sizeOfOrder(order).
+    std::vector<std::set<VkDeviceSize>> freeLists;
+    std::unordered_set<Allocation *> allocations;
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize requestedBytes = 0;
+
+    std::optional<VkDeviceSize> allocate(uint32_t order)
+    {
+        uint32_t available = order;
+        while (available <= maxOrder && freeLists[available].empty())
+        {
+            available++;
+        }
+        if (available > maxOrder)
+        {
+            return std::nullopt;
+        }
+
+        // Lowest offset first keeps live allocations packed towards the start of the block.
+        VkDeviceSize offset = *freeLists[available].begin();
+        freeLists[available].erase(freeLists[available].begin());
+        while (available > order)
+        {
+            available--;
+            freeLists[available].insert(offset + sizeOfOrder(available));
+        }
+        usedBytes += sizeOfOrder(order);
+        return offset;
+    }
+
+    void release(VkDeviceSize offset, uint32_t order)
+    {
+        usedBytes -= sizeOfOrder(order);
+        while (order < maxOrder)
+        {
+            VkDeviceSize buddy = offset ^ sizeOfOrder(order);
+            if (freeLists[order].erase(buddy) == 0)
+            {
+                break;
+            }
+            offset = std::min(offset, buddy);
+            order++;
+        }
+        freeLists[order].insert(offset);
+    }
+
+    VkDeviceSize largestFreeRange() const
+    {
+        if (dedicated)
+        {
+            return 0;
+        }
+        for (uint32_t order = maxOrder + 1; order-- > 0;)
+        {
+            if (!freeLists[order].empty())
+            {
+                return sizeOfOrder(order);
+            }
+        }
+        return 0;
+    }
+};
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device,
+                                             VkDeviceSize preferredBlockSize)
+    : device(device), preferredBlockSize(roundUpToPowerOfTwo(preferredBlockSize))
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    bufferImageGranularity = properties.limits.bufferImageGranularity;
+    nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+    maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+    for (auto &[key, pool] : pools)
+    {
+        for (auto &block : pool.blocks)
+        {
+            for (Allocation *allocation : block->allocations)
+            {
+                delete allocation;
+            }
+            if (block->mapped != nullptr)
+            {
+                vkUnmapMemory(device, block->memory);
+            }
+            vkFreeMemory(device, block->memory, nullptr);
+        }
+    }
+}
+
+uint32_t DeviceMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required,
+                                               VkMemoryPropertyFlags preferred) const
+{
+    for (VkMemoryPropertyFlags wanted : {required | preferred, required})
+    {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted)
+            {
+                return i;
+            }
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+DeviceMemoryAllocator::Allocation *DeviceMemoryAllocator::allocate(const VkMemoryRequirements &requirements,
+                                                                   VkMemoryPropertyFlags required,
+                                                                   VkMemoryPropertyFlags preferred, ResourceKind kind)
+{
+    uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, required, preferred);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Pool &pool = getPool(memoryTypeIndex, kind);
+    Allocation *allocation = allocateFromPool(pool, requirements.size, requirements.alignment);
+    allocation->kind = kind;
+    return allocation;
+}
+
+void DeviceMemoryAllocator::free(Allocation *allocation)
+{
+    if (allocation == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Block *block = allocation->block;
+    releaseAllocation(allocation);
+    delete allocation;
+
+    // Dedicated blocks go straight back to the driver, regular blocks are kept around for reuse.
+    if (block->dedicated)
+    {
+        destroyBlock(block);
+    }
+}
+
+DeviceMemoryAllocator::Allocation *DeviceMemoryAllocator::createBuffer(const VkBufferCreateInfo &bufferInfo,
+                                                                       VkMemoryPropertyFlags required,
+                                                                       VkMemoryPropertyFlags preferred)
+{
+    // Every buffer can be the source and the destination of a defragmentation copy.
+    VkBufferCreateInfo movableInfo = bufferInfo;
+    movableInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkBuffer buffer;
+    if (vkCreateBuffer(device, &movableInfo, nullptr, &buffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    Allocation *allocation;
+    try
+    {
+        allocation = allocate(memRequirements, required, preferred, ResourceKind::Linear);
+    }
+    catch (...)
+    {
+        vkDestroyBuffer(device, buffer, nullptr);
+        throw;
+    }
+    vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset);
+
+    // Remember how the buffer was made so defragment() can recreate it at a new location.
+    allocation->buffer = buffer;
+    allocation->bufferInfo = movableInfo;
+    allocation->bufferInfo.pNext = nullptr;
+    if (bufferInfo.queueFamilyIndexCount > 0)
+    {
+        allocation->queueFamilyIndices.assign(bufferInfo.pQueueFamilyIndices,
+                                              bufferInfo.pQueueFamilyIndices + bufferInfo.queueFamilyIndexCount);
+    }
+    allocation->bufferInfo.pQueueFamilyIndices = nullptr;
+    return allocation;
+}
+
+void DeviceMemoryAllocator::destroyBuffer(Allocation *allocation)
+{
+    if (allocation == nullptr)
+    {
+        return;
+    }
+    vkDestroyBuffer(device, allocation->buffer, nullptr);
+    free(allocation);
+}
+
+DeviceMemoryAllocator::Allocation *DeviceMemoryAllocator::createImage(const VkImageCreateInfo &imageInfo,
+                                                                      VkMemoryPropertyFlags required, VkImage &image,
+                                                                      VkMemoryPropertyFlags preferred)
+{
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+    Allocation *allocation;
+    try
+    {
+        allocation = allocate(memRequirements, required, preferred, kind);
+    }
+    catch (...)
+    {
+        vkDestroyImage(device, image, nullptr);
+        throw;
+    }
+    vkBindImageMemory(device, image, allocation->memory, allocation->offset);
+    return allocation;
+}
+
+void DeviceMemoryAllocator::destroyImage(VkImage image, Allocation *allocation)
+{
+    vkDestroyImage(device, image, nullptr);
+    free(allocation);
+}
+
+void DeviceMemoryAllocator::invalidate(const Allocation *allocation)
+{
+    if (memoryProperties.memoryTypes[allocation->memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    {
+        return;
+    }
+    VkMappedMemoryRange range = alignedRange(allocation);
+    vkInvalidateMappedMemoryRanges(device, 1, &range);
+}
+
+void DeviceMemoryAllocator::flush(const Allocation *allocation)
+{
+    if (memoryProperties.memoryTypes[allocation->memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    {
+        return;
+    }
+    VkMappedMemoryRange range = alignedRange(allocation);
+    vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+void DeviceMemoryAllocator::flush(const Allocation *allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (size == 0 ||
+        memoryProperties.memoryTypes[allocation->memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    {
+        return;
+    }
+    VkMappedMemoryRange range = alignedRange(allocation, offset, size);
+    vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+DeviceMemoryAllocator::DefragmentationResult DeviceMemoryAllocator::defragment(VkCommandBuffer commandBuffer,
+                                                                               VkDeviceSize maxBytesToMove)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    DefragmentationResult result;
+
+    for (auto &[key, pool] : pools)
+    {
+        // Drain the emptiest blocks first, their allocations are the cheapest way to free a whole block.
+        std::vector<Block *> candidates;
+        for (auto &block : pool.blocks)
+        {
+            if (!block->dedicated && !block->allocations.empty())
+            {
+                candidates.push_back(block.get());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Block *a, const Block *b) { return a->usedBytes < b->usedBytes; });
+
+        // A block that received allocations is not drained again, its copies would read memory that is still being
+        // written by this command buffer.
+        std::unordered_set<const Block *> targets;
+        for (size_t i = 0; i + 1 < candidates.size(); i++)
+        {
+            Block *source = candidates[i];
+            if (targets.count(source) > 0)
+            {
+                continue;
+            }
+            std::vector<Allocation *> movable;
+            for (Allocation *allocation : source->allocations)
+            {
+                if (allocation->buffer == VK_NULL_HANDLE)
+                {
+                    // Images cannot be moved without knowing their layout and views, the block stays.
+                    movable.clear();
+                    break;
+                }
+                movable.push_back(allocation);
+            }
+
+            for (Allocation *allocation : movable)
+            {
+                if (maxBytesToMove != VK_WHOLE_SIZE && result.bytesMoved + allocation->requestedSize > maxBytesToMove)
+                {
+                    recordDefragmentationBarrier(commandBuffer, result);
+                    return result;
+                }
+
+                VkBufferCreateInfo bufferInfo = allocation->bufferInfo;
+                bufferInfo.pQueueFamilyIndices =
+                    allocation->queueFamilyIndices.empty() ? nullptr : allocation->queueFamilyIndices.data();
+                VkBuffer newBuffer;
+                if (vkCreateBuffer(device, &bufferInfo, nullptr, &newBuffer) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create buffer for defragmentation!");
+                }
+                VkMemoryRequirements memRequirements;
+                vkGetBufferMemoryRequirements(device, newBuffer, &memRequirements);
+                if (memRequirements.size > allocation->size ||
+                    (memRequirements.memoryTypeBits & (1u << allocation->memoryTypeIndex)) == 0)
+                {
+                    vkDestroyBuffer(device, newBuffer, nullptr);
+                    continue;
+                }
+
+                // Only fuller blocks are valid targets, and only where space is already free: no new blocks.
+                Block *target = nullptr;
+                std::optional<VkDeviceSize> targetOffset;
+                for (size_t j = candidates.size(); j-- > i + 1;)
+                {
+                    targetOffset = candidates[j]->allocate(allocation->order);
+                    if (targetOffset.has_value())
+                    {
+                        target = candidates[j];
+                        break;
+                    }
+                }
+                if (target != nullptr && targetOffset.value() % memRequirements.alignment != 0)
+                {
+                    target->release(targetOffset.value(), allocation->order);
+                    target = nullptr;
+                }
+                if (target == nullptr)
+                {
+                    vkDestroyBuffer(device, newBuffer, nullptr);
+                    continue;
+                }
+                vkBindBufferMemory(device, newBuffer, target->memory, targetOffset.value());
+
+                VkBufferCopy copyRegion{};
+                copyRegion.srcOffset = 0;
+                copyRegion.dstOffset = 0;
+                copyRegion.size = allocation->requestedSize;
+                vkCmdCopyBuffer(commandBuffer, allocation->buffer, newBuffer, 1, &copyRegion);
+
+                // The source range stays reserved until the copy has executed, see finishDefragmentation().
+                result.reservedRanges.push_back({source, allocation->offset, allocation->order});
+                source->requestedBytes -= allocation->requestedSize;
+                source->allocations.erase(allocation);
+                target->requestedBytes += allocation->requestedSize;
+                target->allocations.insert(allocation);
+                targets.insert(target);
+
+                result.retiredBuffers.push_back(allocation->buffer);
+                result.allocationsMoved++;
+                result.bytesMoved += allocation->requestedSize;
+
+                allocation->buffer = newBuffer;
+                allocation->block = target;
+                allocation->memory = target->memory;
+                allocation->offset = targetOffset.value();
+                allocation->mapped =
+                    target->mapped != nullptr ? static_cast<char *>(target->mapped) + targetOffset.value() : nullptr;
+            }
+        }
+    }
+
+    recordDefragmentationBarrier(commandBuffer, result);
+    return result;
+}
+
+void DeviceMemoryAllocator::recordDefragmentationBarrier(VkCommandBuffer commandBuffer,
+                                                         const DefragmentationResult &result)
+{
+    if (result.allocationsMoved > 0)
+    {
+        // The copies must land before anything reads the buffers at their new location.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+void DeviceMemoryAllocator::finishDefragmentation(DefragmentationResult &result)
+{
+    for (VkBuffer buffer : result.retiredBuffers)
+    {
+        vkDestroyBuffer(device, buffer, nullptr);
+    }
+    result.retiredBuffers.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const DefragmentationResult::ReservedRange &range : result.reservedRanges)
+    {
+        range.block->release(range.offset, range.order);
+    }
+    result.reservedRanges.clear();
+
+    for (auto &[key, pool] : pools)
+    {
+        std::vector<Block *> emptyBlocks;
+        for (auto &block : pool.blocks)
+        {
+            if (block->allocations.empty())
+            {
+                emptyBlocks.push_back(block.get());
+            }
+        }
+        for (Block *block : emptyBlocks)
+        {
+            destroyBlock(block);
+            result.blocksReleased++;
+        }
+    }
+}
+
+std::vector<DeviceMemoryAllocator::HeapStatistics> DeviceMemoryAllocator::getHeapStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<HeapStatistics> statistics(memoryProperties.memoryHeapCount);
+    std::vector<VkDeviceSize> freeBytes(memoryProperties.memoryHeapCount, 0);
+
+    for (const auto &[key, pool] : pools)
+    {
+        HeapStatistics &heap = statistics[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex];
+        VkDeviceSize &heapFreeBytes = freeBytes[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex];
+        for (const auto &block : pool.blocks)
+        {
+            heap.blockCount++;
+            heap.allocationCount += static_cast<uint32_t>(block->allocations.size());
+            heap.blockBytes += block->size;
+            heap.usedBytes += block->usedBytes;
+            heap.requestedBytes += block->requestedBytes;
+            heap.largestFreeRange = std::max(heap.largestFreeRange, block->largestFreeRange());
+            heapFreeBytes += block->size - block->usedBytes;
+        }
+    }
+
+    for (size_t i = 0; i < statistics.size(); i++)
+    {
+        if (freeBytes[i] > 0)
+        {
+            statistics[i].fragmentation =
+                1.0f - static_cast<float>(statistics[i].largestFreeRange) / static_cast<float>(freeBytes[i]);
+        }
+    }
+    return statistics;
+}
+
+uint32_t DeviceMemoryAllocator::getDeviceAllocationCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return deviceAllocationCount;
+}
+
+DeviceMemoryAllocator::Pool &DeviceMemoryAllocator::getPool(uint32_t memoryTypeIndex, ResourceKind kind)
+{
+    // With a granularity of 1 linear and optimal resources may share pages, so they share blocks too.
+    uint32_t kindIndex = bufferImageGranularity > 1 && kind == ResourceKind::Optimal ? 1 : 0;
+    Pool &pool = pools[memoryTypeIndex * 2 + kindIndex];
+    pool.memoryTypeIndex = memoryTypeIndex;
+    return pool;
+}
+
+VkDeviceSize DeviceMemoryAllocator::blockSizeFor(uint32_t memoryTypeIndex) const
+{
+    // Small heaps (integrated GPUs, the BAR window) get proportionally smaller blocks.
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    return std::max(minimumAllocationSize, std::min(preferredBlockSize, roundDownToPowerOfTwo(heapSize / 8)));
+}
+
+DeviceMemoryAllocator::Block *DeviceMemoryAllocator::createBlock(Pool &pool, VkDeviceSize size, bool dedicated)
+{
+    if (deviceAllocationCount >= maxMemoryAllocationCount)
+    {
+        throw std::runtime_error("maxMemoryAllocationCount reached!");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+    auto block = std::make_unique<Block>();
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS)
+    {
+        return nullptr;
+    }
+    deviceAllocationCount++;
+
+    block->size = size;
+    block->memoryTypeIndex = pool.memoryTypeIndex;
+    block->dedicated = dedicated;
+    if (!dedicated)
+    {
+        block->maxOrder = orderOf(size);
+        block->freeLists.resize(block->maxOrder + 1);
+        block->freeLists[block->maxOrder].insert(0);
+    }
+    if (memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS)
+        {
+            vkFreeMemory(device, block->memory, nullptr);
+            deviceAllocationCount--;
+            throw std::runtime_error("failed to map device memory block!");
+        }
+    }
+
+    pool.blocks.push_back(std::move(block));
+    return pool.blocks.back().get();
+}
+
+void DeviceMemoryAllocator::destroyBlock(Block *block)
+{
+    if (block->mapped != nullptr)
+    {
+        vkUnmapMemory(device, block->memory);
+    }
+    vkFreeMemory(device, block->memory, nullptr);
+    deviceAllocationCount--;
+
+    for (auto &[key, candidate] : pools)
+    {
+        auto it = std::find_if(candidate.blocks.begin(), candidate.blocks.end(),
+                               [block](const std::unique_ptr<Block> &owned) { return owned.get() == block; });
+        if (it != candidate.blocks.end())
+        {
+            candidate.blocks.erase(it);
+            return;
+        }
+    }
+}
+
+DeviceMemoryAllocator::Allocation *DeviceMemoryAllocator::allocateFromPool(Pool &pool, VkDeviceSize size,
+                                                                           VkDeviceSize alignment)
+{
+    VkDeviceSize blockSize = blockSizeFor(pool.memoryTypeIndex);
+    // Buddies are aligned to their own size, so rounding up to the alignment satisfies it for free.
+    VkDeviceSize buddySize = roundUpToPowerOfTwo(std::max({size, alignment, minimumAllocationSize}));
+
+    auto allocation = std::make_unique<Allocation>();
+    allocation->requestedSize = size;
+    allocation->memoryTypeIndex = pool.memoryTypeIndex;
+
+    Block *block = nullptr;
+    std::optional<VkDeviceSize> offset;
+    if (buddySize > blockSize / 2)
+    {
+        // Large resources would waste most of a block, they get their own memory object.
+        block = createBlock(pool, size, true);
+        if (block == nullptr)
+        {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+        offset = 0;
+        allocation->size = size;
+        block->usedBytes = size;
+    }
+    else
+    {
+        allocation->order = orderOf(buddySize);
+        allocation->size = buddySize;
+        for (auto &candidate : pool.blocks)
+        {
+            if (!candidate->dedicated)
+            {
+                offset = candidate->allocate(allocation->order);
+                if (offset.has_value())
+                {
+                    block = candidate.get();
+                    break;
+                }
+            }
+        }
+
+        // No room anywhere: grab a new block, halving its size while the driver refuses.
+        for (VkDeviceSize newBlockSize = blockSize; block == nullptr && newBlockSize >= buddySize; newBlockSize /= 2)
+        {
+            block = createBlock(pool, newBlockSize, false);
+            if (block != nullptr)
+            {
+                offset = block->allocate(allocation->order);
+            }
+        }
+        if (block == nullptr)
+        {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+    }
+
+    allocation->block = block;
+    allocation->memory = block->memory;
+    allocation->offset = offset.value();
+    allocation->mapped = block->mapped != nullptr ? static_cast<char *>(block->mapped) + offset.value() : nullptr;
+    block->requestedBytes += size;
+    block->allocations.insert(allocation.get());
+    return allocation.release();
+}
+
+void DeviceMemoryAllocator::releaseAllocation(Allocation *allocation)
+{
+    Block *block = allocation->block;
+    block->allocations.erase(allocation);
+    block->requestedBytes -= allocation->requestedSize;
+    if (block->dedicated)
+    {
+        block->usedBytes = 0;
+    }
+    else
+    {
+        block->release(allocation->offset, allocation->order);
+    }
+}
+
+VkMappedMemoryRange DeviceMemoryAllocator::alignedRange(const Allocation *allocation, VkDeviceSize offset,
+                                                       VkDeviceSize size) const
+{
+    // Flushes and invalidates must cover whole nonCoherentAtomSize units.
+    VkDeviceSize begin = (allocation->offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+    VkDeviceSize end = allocation->offset + (size == VK_WHOLE_SIZE ? allocation->size : offset + size);
+    end = std::min((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize,
+                   allocation->block->size);
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation->memory;
+    range.offset = begin;
+    range.size = end - begin;
+    return range;
+}
\ No newline at end of file
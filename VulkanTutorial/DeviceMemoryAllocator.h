@@ -0,0 +1,151 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Sub-allocates buffers and images from large VkDeviceMemory blocks instead of issuing one vkAllocateMemory per
+// resource. Every block is managed as a binary buddy system: sizes are rounded up to a power of two, which keeps
+// every allocation naturally aligned and makes freeing and coalescing O(log n).
+class DeviceMemoryAllocator
+{
+  public:
+    // Linear resources (buffers, linear images) and optimal-tiling images are kept in separate blocks whenever the
+    // device reports a bufferImageGranularity above 1, so neighbours can never violate the granularity.
+    enum class ResourceKind
+    {
+        Linear,
+        Optimal
+    };
+
+    struct Block;
+
+    struct Allocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // Persistently mapped pointer for host-visible memory, nullptr otherwise.
+        void *mapped = nullptr;
+        uint32_t memoryTypeIndex = 0;
+        // Set for buffers created through createBuffer(); defragment() may replace it with a new handle.
+        VkBuffer buffer = VK_NULL_HANDLE;
+
+      private:
+        friend class DeviceMemoryAllocator;
+        Block *block = nullptr;
+        uint32_t order = 0;
+        VkDeviceSize requestedSize = 0;
+        ResourceKind kind = ResourceKind::Linear;
+        VkBufferCreateInfo bufferInfo{};
+        std::vector<uint32_t> queueFamilyIndices;
+    };
+
+    struct HeapStatistics
+    {
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+        // Bytes reserved from the driver through vkAllocateMemory.
+        VkDeviceSize blockBytes = 0;
+        // Bytes handed out to resources, including the power-of-two rounding of the buddy system.
+        VkDeviceSize usedBytes = 0;
+        // Bytes the resources actually asked for.
+        VkDeviceSize requestedBytes = 0;
+        VkDeviceSize largestFreeRange = 0;
+        // 0 when all free memory is one contiguous range, approaching 1 as it splinters into small ranges.
+        float fragmentation = 0.0f;
+    };
+
+    struct DefragmentationResult
+    {
+        uint32_t allocationsMoved = 0;
+        VkDeviceSize bytesMoved = 0;
+        uint32_t blocksReleased = 0;
+
+      private:
+        friend class DeviceMemoryAllocator;
+        struct ReservedRange
+        {
+            Block *block;
+            VkDeviceSize offset;
+            uint32_t order;
+        };
+        std::vector<VkBuffer> retiredBuffers;
+        // The ranges moved out of, not handed out again while the copies may still read them.
+        std::vector<ReservedRange> reservedRanges;
+    };
+
+    DeviceMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device,
+                          VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024);
+    ~DeviceMemoryAllocator();
+
+    DeviceMemoryAllocator(const DeviceMemoryAllocator &) = delete;
+    DeviceMemoryAllocator &operator=(const DeviceMemoryAllocator &) = delete;
+
+    // Picks a memory type that has all of the required flags, favouring one that also has the preferred flags.
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required,
+                            VkMemoryPropertyFlags preferred = 0) const;
+
+    Allocation *allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags required,
+                         VkMemoryPropertyFlags preferred, ResourceKind kind);
+    void free(Allocation *allocation);
+
+    Allocation *createBuffer(const VkBufferCreateInfo &bufferInfo, VkMemoryPropertyFlags required,
+                             VkMemoryPropertyFlags preferred = 0);
+    void destroyBuffer(Allocation *allocation);
+
+    Allocation *createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags required, VkImage &image,
+                            VkMemoryPropertyFlags preferred = 0);
+    void destroyImage(VkImage image, Allocation *allocation);
+
+    // Makes device writes visible to the host for non-coherent memory, a no-op for coherent memory.
+    void invalidate(const Allocation *allocation);
+    // Makes host writes visible to the device for non-coherent memory, a no-op for coherent memory.
+    void flush(const Allocation *allocation);
+    // Only the bytes from offset, relative to the allocation, to offset + size, widened to nonCoherentAtomSize units.
+    void flush(const Allocation *allocation, VkDeviceSize offset, VkDeviceSize size);
+
+    // Records copies that move buffers created through createBuffer() out of the emptiest blocks into free space of
+    // fuller ones, at most maxBytesToMove bytes of buffer contents. Moved allocations get a new buffer handle
+    // immediately, anything that referenced the old handle has to be refreshed. Once the command buffer has finished
+    // executing, call finishDefragmentation() to destroy the old buffers, free the ranges they occupied and release
+    // the blocks that became empty. Only one defragmentation may be in flight at a time.
+    DefragmentationResult defragment(VkCommandBuffer commandBuffer, VkDeviceSize maxBytesToMove = VK_WHOLE_SIZE);
+    void finishDefragmentation(DefragmentationResult &result);
+
+    std::vector<HeapStatistics> getHeapStatistics() const;
+    // Number of live vkAllocateMemory allocations, bounded by maxMemoryAllocationCount.
+    uint32_t getDeviceAllocationCount() const;
+
+  private:
+    struct Pool
+    {
+        uint32_t memoryTypeIndex = 0;
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize bufferImageGranularity;
+    VkDeviceSize nonCoherentAtomSize;
+    uint32_t maxMemoryAllocationCount;
+    VkDeviceSize preferredBlockSize;
+    uint32_t deviceAllocationCount = 0;
+    std::unordered_map<uint32_t, Pool> pools;
+    mutable std::mutex mutex;
+
+    Pool &getPool(uint32_t memoryTypeIndex, ResourceKind kind);
+    VkDeviceSize blockSizeFor(uint32_t memoryTypeIndex) const;
+    Block *createBlock(Pool &pool, VkDeviceSize size, bool dedicated);
+    void destroyBlock(Block *block);
+    Allocation *allocateFromPool(Pool &pool, VkDeviceSize size, VkDeviceSize alignment);
+    void recordDefragmentationBarrier(VkCommandBuffer commandBuffer, const DefragmentationResult &result);
+    void releaseAllocation(Allocation *allocation);
+    VkMappedMemoryRange alignedRange(const Allocation *allocation, VkDeviceSize offset = 0,
+                                     VkDeviceSize size = VK_WHOLE_SIZE) const;
+};
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include "GpuCuller.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+// Must match local_size_x in cull.comp.
+constexpr uint32_t cullWorkgroupSize = 64;
+} // namespace
+
+GpuCuller::GpuCuller(VkDevice device, DeviceMemoryAllocator &allocator, VkPipelineCache pipelineCache,
+                     std::span<const uint8_t> cullShaderCode, const ShaderManifest &shaderManifest,
+                     VkBuffer objectBuffer, uint32_t objectCount, bool useDrawIndirectCount,
+                     uint32_t maxDrawIndirectCount, uint32_t frameCount)
+    : device(device), allocator(allocator), objectCount(objectCount), useDrawIndirectCount(useDrawIndirectCount),
+      maxDrawIndirectCount(maxDrawIndirectCount), visibleCountsPending(frameCount, false)
+{
+    // Only the graphics queue touches these, the compute pass writes them and the indirect draws read them.
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(objectCount);
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    drawCommandBuffer = allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    bufferInfo.size = sizeof(uint32_t);
+    bufferInfo.usage =
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    drawCountBuffer = allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    bufferInfo.size = sizeof(uint32_t) * static_cast<VkDeviceSize>(frameCount);
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    visibleCountBuffer = allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+    createDescriptorSet(objectBuffer);
+    createPipeline(pipelineCache, cullShaderCode, shaderManifest);
+}
+
+GpuCuller::~GpuCuller()
+{
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    allocator.destroyBuffer(visibleCountBuffer);
+    allocator.destroyBuffer(drawCountBuffer);
+    allocator.destroyBuffer(drawCommandBuffer);
+}
+
+VkDescriptorSetLayout GpuCuller::getDescriptorSetLayout() const
+{
+    return descriptorSetLayout;
+}
+
+VkBuffer GpuCuller::getDrawCommandBuffer() const
+{
+    return drawCommandBuffer->buffer;
+}
+
+VkBuffer GpuCuller::getDrawCountBuffer() const
+{
+    return drawCountBuffer->buffer;
+}
+
+VkBuffer GpuCuller::getVisibleCountBuffer() const
+{
+    return visibleCountBuffer->buffer;
+}
+
+uint32_t GpuCuller::getObjectCount() const
+{
+    return objectCount;
+}
+
+void GpuCuller::recordCulling(VkCommandBuffer commandBuffer, const glm::mat4 &viewProjection)
+{
+    // Counted in both variants, without drawIndirectCount only for recordVisibleCountCopy.
+    vkCmdFillBuffer(commandBuffer, drawCountBuffer->buffer, 0, sizeof(uint32_t), 0);
+
+    VkBufferMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    clearBarrier.buffer = drawCountBuffer->buffer;
+    clearBarrier.offset = 0;
+    clearBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                         nullptr, 1, &clearBarrier, 0, nullptr);
+
+    // Gribb and Hartmann: every frustum plane is the last row of the matrix plus or minus one of the other rows.
+    // glm is column major, row r of m is (m[0][r], m[1][r], m[2][r], m[3][r]).
+    auto row = [&viewProjection](int r) {
+        return glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+    };
+    PushConstants pushConstants{};
+    pushConstants.frustumPlanes[0] = row(3) + row(0);
+    pushConstants.frustumPlanes[1] = row(3) - row(0);
+    pushConstants.frustumPlanes[2] = row(3) + row(1);
+    pushConstants.frustumPlanes[3] = row(3) - row(1);
+    // Depth is zero to one, so the near plane is the third row on its own.
+    pushConstants.frustumPlanes[4] = row(2);
+    pushConstants.frustumPlanes[5] = row(3) - row(2);
+    for (glm::vec4 &plane : pushConstants.frustumPlanes)
+    {
+        float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+        plane = plane / length;
+    }
+    pushConstants.objectCount = objectCount;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, (objectCount + cullWorkgroupSize - 1) / cullWorkgroupSize, 1, 1);
+}
+
+void GpuCuller::recordDraws(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0,
+                            nullptr);
+
+    if (useDrawIndirectCount)
+    {
+        vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffer->buffer, 0, drawCountBuffer->buffer, 0,
+                                      objectCount, sizeof(VkDrawIndexedIndirectCommand));
+        return;
+    }
+
+    // Without a GPU written count every slot is drawn, in as few calls as maxDrawIndirectCount allows.
+    for (uint32_t first = 0; first < objectCount; first += maxDrawIndirectCount)
+    {
+        uint32_t count = std::min(maxDrawIndirectCount, objectCount - first);
+        vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer->buffer,
+                                 sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(first), count,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void GpuCuller::recordVisibleCountCopy(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = 0;
+    copyRegion.dstOffset = sizeof(uint32_t) * static_cast<VkDeviceSize>(frameIndex);
+    copyRegion.size = sizeof(uint32_t);
+    vkCmdCopyBuffer(commandBuffer, drawCountBuffer->buffer, visibleCountBuffer->buffer, 1, &copyRegion);
+    visibleCountsPending[frameIndex] = true;
+}
+
+std::optional<uint32_t> GpuCuller::takeVisibleCount(uint32_t frameIndex)
+{
+    if (!visibleCountsPending[frameIndex])
+    {
+        return std::nullopt;
+    }
+    visibleCountsPending[frameIndex] = false;
+    allocator.invalidate(visibleCountBuffer);
+    return static_cast<const uint32_t *>(visibleCountBuffer->mapped)[frameIndex];
+}
+
+void GpuCuller::createDescriptorSet(VkBuffer objectBuffer)
+{
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    // The vertex shader reads the transform of the object it draws.
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 3;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate descriptor set!");
+    }
+
+    VkDescriptorBufferInfo bufferInfos[3]{};
+    bufferInfos[0].buffer = objectBuffer;
+    bufferInfos[1].buffer = drawCommandBuffer->buffer;
+    bufferInfos[2].buffer = drawCountBuffer->buffer;
+    VkWriteDescriptorSet writes[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+}
+
+void GpuCuller::createPipeline(VkPipelineCache pipelineCache, std::span<const uint8_t> cullShaderCode,
+                               const ShaderManifest &shaderManifest)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create culling pipeline layout!");
+    }
+
+    VkShaderModuleCreateInfo shaderInfo{};
+    shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderInfo.codeSize = cullShaderCode.size();
+    shaderInfo.pCode = reinterpret_cast<const uint32_t *>(cullShaderCode.data());
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &shaderInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create shader module!");
+    }
+
+    // Compacting only pays off when the draw count can be read from the GPU, the shader variant is picked here instead
+    // of branching on a push constant.
+    SpecializationConstants specialization;
+    specialization.set(shaderManifest.getConstantId(shaderName, "compact"), useDrawIndirectCount ? VK_TRUE : VK_FALSE);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = specialization.get();
+    pipelineInfo.layout = pipelineLayout;
+    VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create culling pipeline!");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <glm/glm.hpp>
+
+#include "DeviceMemoryAllocator.h"
+#include "ShaderManifest.h"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// GPU-driven drawing: object transforms and bounds live in a storage buffer, a compute pass tests every object against
+// the view frustum and writes a VkDrawIndexedIndirectCommand for each visible one, and a single indirect draw issues
+// them. Recording a frame costs the same for ten objects as for a million.
+class GpuCuller
+{
+  public:
+    // Mirrors the Object struct in cull.comp and indirect.vert, std430 layout.
+    struct Object
+    {
+        glm::mat4 model;
+        // Object space centre in xyz, radius in w.
+        glm::vec4 boundingSphere;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t vertexOffset;
+        uint32_t padding;
+    };
+
+    // Asset name of the culling compute shader.
+    static constexpr const char *shaderName = "shaders/cull.comp.spv";
+
+    // objectBuffer holds objectCount Objects and stays owned by the caller. Without drawIndirectCount every object
+    // keeps its slot in the command buffer and culled ones are drawn with zero instances. frameCount frames in flight
+    // can each read back how many objects they drew.
+    GpuCuller(VkDevice device, DeviceMemoryAllocator &allocator, VkPipelineCache pipelineCache,
+              std::span<const uint8_t> cullShaderCode, const ShaderManifest &shaderManifest, VkBuffer objectBuffer,
+              uint32_t objectCount, bool useDrawIndirectCount, uint32_t maxDrawIndirectCount, uint32_t frameCount);
+    ~GpuCuller();
+
+    GpuCuller(const GpuCuller &) = delete;
+    GpuCuller &operator=(const GpuCuller &) = delete;
+
+    // Set 0 of graphics pipelines drawn through recordDraws, binding 0 is the object buffer.
+    VkDescriptorSetLayout getDescriptorSetLayout() const;
+
+    // Written by recordCulling through the transfer and compute stages and read by recordDraws as indirect commands.
+    // The caller orders those accesses, within the frame and against the previous frame's draws.
+    VkBuffer getDrawCommandBuffer() const;
+    VkBuffer getDrawCountBuffer() const;
+    // Host visible, one uint32_t per frame in flight. Written by recordVisibleCountCopy through the transfer stage, the
+    // caller makes the write visible to host reads.
+    VkBuffer getVisibleCountBuffer() const;
+    uint32_t getObjectCount() const;
+
+    // Records the culling dispatch, must be outside a render pass.
+    void recordCulling(VkCommandBuffer commandBuffer, const glm::mat4 &viewProjection);
+    // Records the indirect draws, the graphics pipeline and the vertex and index buffers must already be bound.
+    void recordDraws(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+    // Records a copy of the number of visible objects from the draw count buffer into slot frameIndex of the visible
+    // count buffer.
+    void recordVisibleCountCopy(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    // The count copied by the last recordVisibleCountCopy for frameIndex, whose frame must have finished. Empty when
+    // nothing was copied since the previous call.
+    std::optional<uint32_t> takeVisibleCount(uint32_t frameIndex);
+
+  private:
+    struct PushConstants
+    {
+        glm::vec4 frustumPlanes[6];
+        uint32_t objectCount;
+    };
+
+    VkDevice device;
+    DeviceMemoryAllocator &allocator;
+    uint32_t objectCount;
+    bool useDrawIndirectCount;
+    uint32_t maxDrawIndirectCount;
+    DeviceMemoryAllocator::Allocation *drawCommandBuffer = nullptr;
+    DeviceMemoryAllocator::Allocation *drawCountBuffer = nullptr;
+    DeviceMemoryAllocator::Allocation *visibleCountBuffer = nullptr;
+    std::vector<bool> visibleCountsPending;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    void createDescriptorSet(VkBuffer objectBuffer);
+    void createPipeline(VkPipelineCache pipelineCache, std::span<const uint8_t> cullShaderCode,
+                        const ShaderManifest &shaderManifest);
+};
\ No newline at end of file
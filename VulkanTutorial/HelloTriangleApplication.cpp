@@ -1,10 +1,56 @@
 #include "HelloTriangleApplication.h"
+#include "MeshOptimizer.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
 #else
 const bool enableValidationLayers = true;
 #endif
+
+namespace
+{
+const char *fragShaderName = "shaders/shader.frag.spv";
+
+// Mirror the uniform blocks and push constants of object.vert.
+struct FrameUniforms
+{
+    glm::mat4 viewProjection;
+};
+
+struct ObjectUniforms
+{
+    glm::mat4 model;
+};
+
+struct DrawPushConstants
+{
+    glm::vec4 tint;
+};
+
+bool isSrgbFormat(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB ||
+           format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
+
+std::vector<uint8_t> readBinaryFile(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + path.string() + "!");
+    }
+    std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return data;
+}
+} // namespace
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
                                       const VkAllocationCallbacks *pAllocator,
                                       VkDebugUtilsMessengerEXT *pDebugMessenger)
@@ -36,7 +82,7 @@ bool HelloTriangleApplication::QueueFamilyIndices::isComplete()
 
 void HelloTriangleApplication::run()
 {
-    initWindow();
+    PROFILE_THREAD_NAME("main");
     initVulkan();
     mainLoop();
     cleanup();
@@ -44,6 +90,7 @@ void HelloTriangleApplication::run()
 
 void HelloTriangleApplication::recreateSwapChain()
 {
+    PROFILE_FUNCTION();
     int width = 0, height = 0;
     glfwGetFramebufferSize(window, &width, &height);
     while (width == 0 || height == 0)
@@ -52,16 +99,90 @@ void HelloTriangleApplication::recreateSwapChain()
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
+    auto start = std::chrono::steady_clock::now();
 
-    cleanupSwapChain();
+    // A background reload reads the surface format, render pass and pipeline layout, it has to finish before any of
+    // them change. Its pipeline still matches the current render pass.
+    if (pendingShaderReload.valid())
+    {
+        applyShaderReload(pendingShaderReload.get(), true);
+    }
+
+    // Frames still in flight may reference the old swap chain and everything built on it, so it is retired instead
+    // of destroyed and nothing waits for the device to go idle.
+    VkSwapchainKHR oldSwapChain = swapChain;
+    VkFormat oldFormat = swapChainImageFormat;
+    std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews);
+    std::vector<VkFramebuffer> oldFramebuffers = std::move(swapChainFramebuffers);
+    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(querySwapChainSupport(physicalDevice).formats);
+    createSwapChain(surfaceFormat, oldSwapChain);
+    swapChainImageFormat = surfaceFormat.format;
+    deferDeletion([this, oldSwapChain, oldImageViews, oldFramebuffers]() {
+        for (VkFramebuffer framebuffer : oldFramebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        for (VkImageView imageView : oldImageViews)
+        {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+        vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+    });
+
+    // Viewport and scissor are dynamic, the render pass and pipeline only depend on the surface format.
+    if (swapChainImageFormat != oldFormat)
+    {
+        VkRenderPass oldRenderPass = renderPass;
+        VkPipeline oldPipeline = graphicsPipeline;
+        VkPipelineLayout oldPipelineLayout = pipelineLayout;
+        deferDeletion([this, oldRenderPass, oldPipeline, oldPipelineLayout]() {
+            vkDestroyPipeline(device, oldPipeline, nullptr);
+            vkDestroyPipelineLayout(device, oldPipelineLayout, nullptr);
+            vkDestroyRenderPass(device, oldRenderPass, nullptr);
+        });
+        createRenderPass();
+        createGraphicsPipeline();
+    }
 
-    createSwapChain();
     createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
+    if (postProcessor)
+    {
+        resizePostProcessor();
+    }
     createFramebuffers();
-    createCommandBuffers();
+
+    // The new swap chain may hand out a different number of images.
+    imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+    statistics.swapChainRecreations++;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Swap chain recreated at " << swapChainExtent.width << "x" << swapChainExtent.height << " in "
+              << elapsed.count() * 1000.0 << " ms" << std::endl;
+}
+
+void HelloTriangleApplication::deferDeletion(std::function<void()> deletion)
+{
+    deletionQueue.emplace_back(submittedFrames, std::move(deletion));
+}
+
+void HelloTriangleApplication::collectDeletions()
+{
+    // Called right after waiting on the current frame's fence. Every submission made maxFramesInFlight - 1 or more
+    // submissions ago has had its fence waited on by now, so anything retired before it is no longer in use.
+    while (!deletionQueue.empty() && deletionQueue.front().first + maxFramesInFlight <= submittedFrames + 1)
+    {
+        deletionQueue.front().second();
+        deletionQueue.pop_front();
+    }
+}
+
+void HelloTriangleApplication::flushDeletions()
+{
+    for (auto &[retiredAt, deletion] : deletionQueue)
+    {
+        deletion();
+    }
+    deletionQueue.clear();
 }
 
 bool HelloTriangleApplication::checkValidationLayerSupport()
@@ -95,6 +216,7 @@ bool HelloTriangleApplication::checkValidationLayerSupport()
 
 void HelloTriangleApplication::createInstance()
 {
+    PROFILE_FUNCTION();
     if (enableValidationLayers && !checkValidationLayerSupport())
     {
         throw std::runtime_error("validation layers requested, but not available!");
@@ -175,11 +297,15 @@ void HelloTriangleApplication::setupDebugMessenger()
 
 std::vector<const char *> HelloTriangleApplication::getRequiredExtensions()
 {
-    uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char *> extensions;
+    if (!settings.headless)
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers)
     {
@@ -191,75 +317,510 @@ std::vector<const char *> HelloTriangleApplication::getRequiredExtensions()
 
 void HelloTriangleApplication::initVulkan()
 {
-    createInstance();
-    setupDebugMessenger();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createFramebuffers();
-    createCommandPool();
-    createVertexBuffer();
-    createCommandBuffers();
-    createSyncObjects();
+    PROFILE_FUNCTION();
+    // Every step names the steps whose results it reads, the scheduler overlaps the rest. Reading the asset pack and
+    // the mesh, creating the window and creating the device proceed side by side, and the graphics pipeline compiles
+    // while the swap chain is created.
+    StartupScheduler startup;
+    StartupScheduler::Step assetPackStep = startup.add("asset pack", [this]() {
+        assets = std::make_unique<AssetPack>(settings.assetPackPath);
+        std::span<const uint8_t> manifest = assets->get("shaders/permutations.txt");
+        shaderManifest = std::make_unique<ShaderManifest>(
+            std::string_view(reinterpret_cast<const char *>(manifest.data()), manifest.size()));
+    });
+    StartupScheduler::Step meshStep = startup.add("mesh", [this]() { loadMesh(); });
+
+    // The instance needs glfwInit for the surface extensions, the surface needs the window.
+    std::vector<StartupScheduler::Step> instanceDependencies;
+    std::optional<StartupScheduler::Step> windowStep;
+    if (!settings.headless)
+    {
+        StartupScheduler::Step glfwStep = startup.add("glfw", []() { glfwInit(); }, {}, true);
+        windowStep = startup.add("window", [this]() { initWindow(); }, {glfwStep}, true);
+        instanceDependencies.push_back(glfwStep);
+    }
+    StartupScheduler::Step instanceStep = startup.add(
+        "instance",
+        [this]() {
+            createInstance();
+            setupDebugMessenger();
+        },
+        instanceDependencies);
+    std::vector<StartupScheduler::Step> physicalDeviceDependencies = {instanceStep};
+    if (windowStep)
+    {
+        physicalDeviceDependencies.push_back(
+            startup.add("surface", [this]() { createSurface(); }, {instanceStep, *windowStep}));
+    }
+    StartupScheduler::Step physicalDeviceStep =
+        startup.add("physical device", [this]() { pickPhysicalDevice(); }, physicalDeviceDependencies);
+
+    StartupScheduler::Step deviceStep = startup.add(
+        "device",
+        [this]() {
+            createLogicalDevice();
+            memoryAllocator = std::make_unique<DeviceMemoryAllocator>(physicalDevice, device);
+            renderGraph = std::make_unique<RenderGraph>(device, *memoryAllocator,
+                                                        [this](std::function<void()> deletion) {
+                                                            deferDeletion(std::move(deletion));
+                                                        });
+            QueueFamilyIndices indices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
+            stagingUploader = std::make_unique<StagingUploader>(
+                device, *memoryAllocator, indices.transferFamily.value_or(indices.graphicsFamily.value()),
+                transferQueue);
+        },
+        {physicalDeviceStep});
+    StartupScheduler::Step pipelineCacheStep = startup.add(
+        "pipeline cache",
+        [this]() {
+            pipelineCache = std::make_unique<PipelineCache>(physicalDevice, device, settings.pipelineCachePath);
+        },
+        {deviceStep});
+
+    // The allocator and the uploader lock internally, so the scene resources are created in parallel.
+    StartupScheduler::Step geometryStep = startup.add(
+        "geometry",
+        [this]() {
+            createVertexBuffer();
+            createIndexBuffer();
+        },
+        {deviceStep, meshStep});
+    std::vector<StartupScheduler::Step> uploadDependencies = {geometryStep};
+    std::vector<StartupScheduler::Step> pipelineDependencies = {pipelineCacheStep, assetPackStep};
+    if (settings.gpuCulling)
+    {
+        StartupScheduler::Step gpuCullerStep = startup.add("gpu culler", [this]() { createGpuCuller(); },
+                                                           {deviceStep, meshStep, pipelineCacheStep, assetPackStep});
+        uploadDependencies.push_back(gpuCullerStep);
+        pipelineDependencies.push_back(gpuCullerStep);
+    }
+    startup.add("uploads", [this]() { uploadsReadyValue = stagingUploader->submit(); }, uploadDependencies);
+    if (settings.instanceCount > 0)
+    {
+        pipelineDependencies.push_back(
+            startup.add("instance buffers", [this]() { createInstanceBuffers(); }, {deviceStep}));
+    }
+    if (settings.objectUniforms)
+    {
+        pipelineDependencies.push_back(
+            startup.add("uniform ring", [this]() { createUniformRing(); }, {deviceStep, meshStep}));
+    }
+    if (!settings.textureDirectory.empty())
+    {
+        startup.add("textures", [this]() { loadTextures(); }, {deviceStep});
+    }
+
+    // The render pass and the pipeline only need the format, which is known before the swap chain is created.
+    VkSurfaceFormatKHR surfaceFormat{VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    StartupScheduler::Step surfaceFormatStep = startup.add(
+        "surface format",
+        [this, &surfaceFormat]() {
+            if (!settings.headless)
+            {
+                surfaceFormat = chooseSwapSurfaceFormat(querySwapChainSupport(physicalDevice).formats);
+            }
+            swapChainImageFormat = surfaceFormat.format;
+        },
+        {physicalDeviceStep});
+    // chooseSwapExtent asks GLFW for the framebuffer size, which is restricted to the main thread.
+    StartupScheduler::Step swapChainStep = startup.add(
+        "swap chain",
+        [this, &surfaceFormat]() {
+            if (settings.headless)
+            {
+                createOffscreenTargets({Width, Height});
+            }
+            else
+            {
+                createSwapChain(surfaceFormat);
+            }
+            createImageViews();
+        },
+        {deviceStep, surfaceFormatStep}, !settings.headless);
+    StartupScheduler::Step renderPassStep =
+        startup.add("render pass", [this]() { createRenderPass(); }, {deviceStep, surfaceFormatStep});
+    pipelineDependencies.push_back(renderPassStep);
+    startup.add("graphics pipeline", [this]() { createGraphicsPipeline(); }, pipelineDependencies);
+    std::vector<StartupScheduler::Step> framebufferDependencies = {swapChainStep, renderPassStep};
+    if (settings.postProcessing)
+    {
+        // The main pass renders into the post processor's images, which take the size of the swap chain.
+        framebufferDependencies.push_back(startup.add("post processor", [this]() { createPostProcessor(); },
+                                                      {swapChainStep, pipelineCacheStep, assetPackStep}));
+    }
+    startup.add("framebuffers", [this]() { createFramebuffers(); }, framebufferDependencies);
+    // On the main thread because the job system created here is driven from it.
+    startup.add(
+        "frame resources",
+        [this]() {
+            createCommandAllocator();
+            createSyncObjects();
+        },
+        {deviceStep, swapChainStep}, true);
+
+    startup.run();
+    startup.printTimeline(std::cout);
+
+    if (!settings.shaderWatchPath.empty())
+    {
+        shaderWatcher = std::make_unique<FileWatcher>(settings.shaderWatchPath, std::chrono::milliseconds(250));
+        std::cout << "Watching " << settings.shaderWatchPath << " for shader changes" << std::endl;
+    }
 }
+
+void HelloTriangleApplication::loadMesh()
+{
+    PROFILE_FUNCTION();
+    mesh = settings.meshGridSize > 0 ? Mesh::createGrid(settings.meshGridSize) : Mesh::createTriangle();
+    MeshOptimizer::VertexCacheStatistics before = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    auto start = std::chrono::steady_clock::now();
+    if (settings.optimizeMesh)
+    {
+        MeshOptimizer::optimize(mesh);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    MeshOptimizer::VertexCacheStatistics after = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    std::cout << "Mesh: " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+              << (mesh.getIndexType() == VK_INDEX_TYPE_UINT16 ? 16 : 32) << "-bit indices" << std::endl;
+    std::cout << "\tvertex shader invocations " << before.transformedVertices << " -> " << after.transformedVertices
+              << ", ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+              << " (optimised in " << elapsed.count() * 1000.0 << " ms)" << std::endl;
+
+    // Consecutive triangle ranges, so the draws together cover the mesh exactly once in the optimised order.
+    size_t triangleCount = mesh.indices.size() / 3;
+    size_t drawCount = std::clamp<size_t>(settings.drawCount, 1, triangleCount);
+    drawList.resize(drawCount);
+    for (size_t i = 0; i < drawCount; i++)
+    {
+        size_t firstTriangle = triangleCount * i / drawCount;
+        size_t lastTriangle = triangleCount * (i + 1) / drawCount;
+        drawList[i].indexCount = static_cast<uint32_t>((lastTriangle - firstTriangle) * 3);
+        drawList[i].instanceCount = std::max(settings.instanceCount, 1u);
+        drawList[i].firstIndex = static_cast<uint32_t>(firstTriangle * 3);
+        drawList[i].vertexOffset = 0;
+        drawList[i].firstInstance = 0;
+    }
+}
+
+DeviceMemoryAllocator::Allocation *HelloTriangleApplication::createDeviceLocalBuffer(VkBufferUsageFlags usage,
+                                                                                      const void *data,
+                                                                                      VkDeviceSize size)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    // Written on the transfer queue and read on the graphics queue, concurrent sharing avoids ownership transfers.
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
+    uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(),
+                                     indices.transferFamily.value_or(indices.graphicsFamily.value())};
+    if (queueFamilyIndices[0] != queueFamilyIndices[1])
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+    }
+    else
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    DeviceMemoryAllocator::Allocation *buffer =
+        memoryAllocator->createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    stagingUploader->uploadBuffer(buffer->buffer, 0, data, size);
+    return buffer;
+}
+
 void HelloTriangleApplication::createVertexBuffer()
 {
+    std::vector<uint8_t> vertexData = VertexFormats::encode(mesh.vertices, settings.vertexFormat);
+    vertexBuffer = createDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData.data(), vertexData.size());
+    statistics.vertexBufferBytes = vertexData.size();
+
+    size_t floatSize = sizeof(Vertex) * mesh.vertices.size();
+    std::cout << "Vertex buffer: " << nameof::nameof_enum(settings.vertexFormat) << ", " << vertexData.size()
+              << " bytes (" << 100 - vertexData.size() * 100 / std::max<size_t>(floatSize, 1)
+              << "% smaller than Float)" << std::endl;
+}
+
+void HelloTriangleApplication::createIndexBuffer()
+{
+    indexType = mesh.getIndexType();
+    std::vector<uint8_t> indexData = mesh.getIndexData();
+    indexBuffer = createDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData.data(), indexData.size());
+}
+
+void HelloTriangleApplication::createInstanceBuffers()
+{
+    // A square crowd filling the viewport, one cell per instance.
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(settings.instanceCount))));
+    float cellSize = 2.0f / side;
+    instances.resize(settings.instanceCount);
+    for (uint32_t i = 0; i < settings.instanceCount; i++)
+    {
+        float x = static_cast<float>(i % side);
+        float y = static_cast<float>(i / side);
+        instances[i].offset = glm::vec2(-1.0f + cellSize * (x + 0.5f), -1.0f + cellSize * (y + 0.5f));
+        instances[i].scale = cellSize * 0.5f;
+        instances[i].rotation = 0.0f;
+        instances[i].color = glm::vec3(x / side, y / side, 1.0f - x / side);
+    }
+
+    // Written by the CPU every frame, so each frame in flight gets its own buffer. Device local host visible memory
+    // lets the vertex fetch read it without a PCIe round trip where the platform has it.
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = sizeof(vertices[0]) * vertices.size();
+    bufferInfo.size = sizeof(InstanceData) * instances.size();
     bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS)
+    instanceBuffers.resize(maxFramesInFlight);
+    for (DeviceMemoryAllocator::Allocation *&instanceBuffer : instanceBuffers)
     {
-        throw std::runtime_error("failed to create vertex buffer!");
+        instanceBuffer = memoryAllocator->createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     }
+}
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, vertexBuffer, &memRequirements);
+void HelloTriangleApplication::updateInstances()
+{
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        instances[i].rotation = frameNumber * 0.02f + i * 0.1f;
+    }
+
+    DeviceMemoryAllocator::Allocation *instanceBuffer = instanceBuffers[currentFrame];
+    memcpy(instanceBuffer->mapped, instances.data(), sizeof(InstanceData) * instances.size());
+    memoryAllocator->flush(instanceBuffer);
+}
+
+void HelloTriangleApplication::createUniformRing()
+{
+    // 256 bytes is the largest minUniformBufferOffsetAlignment the specification allows.
+    VkDeviceSize regionSize = std::max<VkDeviceSize>(4ull * 1024 * 1024, (drawList.size() + 1) * 256);
+    uniformRing = std::make_unique<UniformRing>(physicalDevice, *memoryAllocator, maxFramesInFlight, regionSize);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(
-        memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &uniformSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create uniform descriptor set layout!");
+    }
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &vertexBufferMemory) != VK_SUCCESS)
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 2;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &uniformDescriptorPool) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+        throw std::runtime_error("failed to create uniform descriptor pool!");
     }
 
-    vkBindBufferMemory(device, vertexBuffer, vertexBufferMemory, 0);
+    VkDescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = uniformDescriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &uniformSetLayout;
+    if (vkAllocateDescriptorSets(device, &allocateInfo, &uniformDescriptorSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate uniform descriptor set!");
+    }
 
-    void *data;
-    vkMapMemory(device, vertexBufferMemory, 0, bufferInfo.size, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferInfo.size);
-    vkUnmapMemory(device, vertexBufferMemory);
+    // Written once: the descriptors cover one block at the start of the ring, the dynamic offsets move them.
+    VkDescriptorBufferInfo bufferInfos[2]{};
+    bufferInfos[0] = {uniformRing->getBuffer(), 0, sizeof(FrameUniforms)};
+    bufferInfos[1] = {uniformRing->getBuffer(), 0, sizeof(ObjectUniforms)};
+    VkWriteDescriptorSet writes[2]{};
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = uniformDescriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+
+    objectUniformOffsets.resize(drawList.size());
 }
-uint32_t HelloTriangleApplication::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+
+void HelloTriangleApplication::loadTextures()
 {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
+    std::vector<uint32_t> queueFamilies = {indices.graphicsFamily.value()};
+    if (indices.transferFamily.has_value())
+    {
+        queueFamilies.push_back(indices.transferFamily.value());
+    }
+    textureLoader = std::make_unique<TextureLoader>(physicalDevice, device, *memoryAllocator, *stagingUploader,
+                                                    std::move(queueFamilies));
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    textureLoadStart = std::chrono::steady_clock::now();
+    for (const auto &file : std::filesystem::directory_iterator(settings.textureDirectory))
     {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        std::string extension = file.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (file.is_regular_file() &&
+            (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" ||
+             extension == ".bmp"))
         {
-            return i;
+            textures.push_back(textureLoader->load(file.path()));
         }
     }
+    std::cout << "Loading " << textures.size() << " textures from " << settings.textureDirectory << std::endl;
+}
+
+void HelloTriangleApplication::createPostProcessor()
+{
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
+    std::vector<uint32_t> queueFamilies = {indices.graphicsFamily.value()};
+    if (computeQueue != VK_NULL_HANDLE)
+    {
+        queueFamilies.push_back(indices.computeFamily.value());
+    }
+
+    // One scene colour image more than frames in flight: with async compute a frame's image is still read on the
+    // compute queue while the next maxFramesInFlight frames are rasterised.
+    uint32_t frameCount = static_cast<uint32_t>(maxFramesInFlight) + 1;
+    auto retire = [this](std::function<void()> deletion) { deferDeletion(std::move(deletion)); };
+    postProcessor = std::make_unique<PostProcessor>(device, *memoryAllocator, pipelineCache->get(), *assets,
+                                                    queueFamilies, frameCount, swapChainExtent, retire);
+    if (computeQueue == VK_NULL_HANDLE)
+    {
+        std::cout << "Post-processing on the graphics queue" << std::endl;
+        return;
+    }
+
+    computeGraph = std::make_unique<RenderGraph>(device, *memoryAllocator, retire);
+    compositeGraph = std::make_unique<RenderGraph>(device, *memoryAllocator, retire);
+    computeCommandAllocator =
+        std::make_unique<FrameCommandAllocator>(device, indices.computeFamily.value(), frameCount);
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &postProcessSemaphore) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create post-processing semaphore!");
+    }
+    semaphoreInfo.pNext = nullptr;
+    sceneReadySemaphores.resize(frameCount);
+    for (VkSemaphore &sceneReadySemaphore : sceneReadySemaphores)
+    {
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &sceneReadySemaphore) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create post-processing semaphore!");
+        }
+    }
+
+    std::cout << "Post-processing on the async compute queue, family " << indices.computeFamily.value() << " queue "
+              << indices.computeQueueIndex << std::endl;
+}
+
+void HelloTriangleApplication::updateObjectUniforms()
+{
+    uniformRing->beginFrame(static_cast<uint32_t>(currentFrame));
+    frameUniformOffset = uniformRing->push(FrameUniforms{viewProjection});
+
+    // Every draw sways around where its triangles are in the mesh.
+    for (size_t i = 0; i < objectUniformOffsets.size(); i++)
+    {
+        float phase = frameNumber * 0.05f + i * 0.7f;
+        ObjectUniforms object{glm::mat4(1.0f)};
+        object.model[3] = glm::vec4(0.01f * std::sin(phase), 0.01f * std::cos(phase), 0.0f, 1.0f);
+        objectUniformOffsets[i] = uniformRing->push(object);
+    }
+    uniformRing->endFrame();
+}
+
+void HelloTriangleApplication::updateCamera()
+{
+    // The view circles the mesh grid, which spans -1 to 1, as close to its edge as the zoom allows while staying on it.
+    float zoom = std::max(1.0f, settings.cameraZoom);
+    float angle = frameNumber * 0.01f;
+    glm::vec2 center = (1.0f - 1.0f / zoom) * glm::vec2(std::cos(angle), std::sin(angle));
+    viewProjection = glm::mat4(1.0f);
+    viewProjection[0][0] = zoom;
+    viewProjection[1][1] = zoom;
+    viewProjection[3] = glm::vec4(-zoom * center, 0.0f, 1.0f);
+}
+
+void HelloTriangleApplication::collectCullingStatistics(size_t slot)
+{
+    if (!gpuCuller)
+    {
+        return;
+    }
+    if (std::optional<uint32_t> visible = gpuCuller->takeVisibleCount(static_cast<uint32_t>(slot)))
+    {
+        culledObjects += gpuCuller->getObjectCount() - visible.value();
+        culledFrames++;
+    }
+}
+
+void HelloTriangleApplication::createGpuCuller()
+{
+    std::vector<GpuCuller::Object> objects(drawList.size());
+    for (size_t i = 0; i < drawList.size(); i++)
+    {
+        const VkDrawIndexedIndirectCommand &draw = drawList[i];
+        glm::vec2 minimum = mesh.vertices[mesh.indices[draw.firstIndex]].pos;
+        glm::vec2 maximum = minimum;
+        for (uint32_t j = draw.firstIndex; j < draw.firstIndex + draw.indexCount; j++)
+        {
+            minimum = glm::min(minimum, mesh.vertices[mesh.indices[j]].pos);
+            maximum = glm::max(maximum, mesh.vertices[mesh.indices[j]].pos);
+        }
 
-    throw std::runtime_error("failed to find suitable memory type!");
+        objects[i].model = glm::mat4(1.0f);
+        objects[i].boundingSphere =
+            glm::vec4((minimum + maximum) * 0.5f, 0.0f, glm::length(maximum - minimum) * 0.5f);
+        objects[i].firstIndex = draw.firstIndex;
+        objects[i].indexCount = draw.indexCount;
+        objects[i].vertexOffset = draw.vertexOffset;
+        objects[i].padding = 0;
+    }
+    objectBuffer = createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objects.data(),
+                                           sizeof(objects[0]) * objects.size());
+
+    gpuCuller = std::make_unique<GpuCuller>(device, *memoryAllocator, pipelineCache->get(),
+                                            assets->get(GpuCuller::shaderName), *shaderManifest, objectBuffer->buffer,
+                                            static_cast<uint32_t>(objects.size()), drawIndirectCountSupported,
+                                            deviceCapabilities.properties.limits.maxDrawIndirectCount,
+                                            static_cast<uint32_t>(maxFramesInFlight));
+    std::cout << "GPU culling " << objects.size() << " objects, "
+              << (drawIndirectCountSupported ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirect")
+              << std::endl;
 }
 
 void HelloTriangleApplication::createSyncObjects()
 {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(maxFramesInFlight);
+    renderFinishedSemaphores.resize(maxFramesInFlight);
+    inFlightFences.resize(maxFramesInFlight);
     imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
@@ -269,7 +830,7 @@ void HelloTriangleApplication::createSyncObjects()
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < maxFramesInFlight; i++)
     {
         if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
             vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
@@ -280,35 +841,141 @@ void HelloTriangleApplication::createSyncObjects()
     }
 }
 
-void HelloTriangleApplication::createCommandBuffers()
+VkCommandBuffer HelloTriangleApplication::recordCommandBuffer(uint32_t imageIndex)
 {
-    commandBuffers.resize(swapChainFramebuffers.size());
+    PROFILE_FUNCTION();
+    auto start = std::chrono::steady_clock::now();
 
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+    updateCamera();
+    if (!instanceBuffers.empty())
+    {
+        updateInstances();
+    }
+    if (uniformRing)
+    {
+        updateObjectUniforms();
+    }
 
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+    // The caller has waited on the frame's fence, so the GPU is done with everything this frame slot recorded before.
+    commandAllocator->beginFrame(static_cast<uint32_t>(currentFrame));
+    for (std::unique_ptr<FrameCommandAllocator> &workerCommandAllocator : workerCommandAllocators)
+    {
+        workerCommandAllocator->beginFrame(static_cast<uint32_t>(currentFrame));
+    }
+    if (postProcessor)
     {
-        throw std::runtime_error("failed to allocate command buffers!");
+        // With async compute the frame fence does not cover the compute queue, which may still be reading the scene
+        // colour image and descriptors this frame reuses. By now an earlier frame's copy has waited on them anyway.
+        uint32_t frameCount = postProcessor->getFrameCount();
+        waitForPostProcessing(postProcessedFrames >= frameCount ? postProcessedFrames - frameCount + 1 : 0);
+        postProcessor->beginFrame(postProcessedFrames++);
     }
+    VkCommandBuffer commandBuffer = commandAllocator->allocatePrimary();
+    GpuProfiler *profiler = gpuProfiler.get();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    for (size_t i = 0; i < commandBuffers.size(); i++)
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
     {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    if (profiler)
+    {
+        profiler->beginFrame(commandBuffer, static_cast<uint32_t>(currentFrame));
+    }
 
-        if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
+    // With async compute the target is only written by the next frame's copy, see recordComposite.
+    bool asyncCompute = computeQueue != VK_NULL_HANDLE;
+    renderGraph->reset();
+    std::optional<RenderGraph::Resource> target;
+    if (!asyncCompute)
+    {
+        target = importTarget(*renderGraph, imageIndex);
+    }
+
+    if (textureLoader && textureLoader->getPendingCount() > 0)
+    {
+        // The blits wait on the uploader's timeline at the transfer stage, see drawFrame.
+        auto recordTextureUploads = [this, profiler](VkCommandBuffer commandBuffer) {
+            GpuProfiler::Zone uploadZone(profiler, commandBuffer, "texture uploads");
+            uploadsReadyValue = std::max(uploadsReadyValue, textureLoader->recordUploads(commandBuffer));
+            if (textureLoader->getPendingCount() > 0)
+            {
+                return;
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - textureLoadStart;
+            size_t failed = 0;
+            for (TextureLoader::Handle texture : textures)
+            {
+                if (textureLoader->getState(texture) == TextureLoader::State::Failed)
+                {
+                    std::cerr << textureLoader->getError(texture) << std::endl;
+                    failed++;
+                }
+            }
+            std::cout << "Loaded " << textures.size() - failed << " textures (" << failed << " failed) in "
+                      << elapsed.count() << " ms" << std::endl;
+        };
+        renderGraph->addPass("texture uploads", recordTextureUploads).setSideEffects();
+    }
+
+    std::optional<RenderGraph::Resource> drawCommands;
+    std::optional<RenderGraph::Resource> drawCount;
+    if (gpuCuller)
+    {
+        // Shared by all frames in flight, the previous frame's indirect draws and visible count copy may still be
+        // reading them.
+        drawCommands = renderGraph->importBuffer("draw commands", gpuCuller->getDrawCommandBuffer(),
+                                                 {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0});
+        drawCount =
+            renderGraph->importBuffer("draw count", gpuCuller->getDrawCountBuffer(),
+                                      {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0});
+        auto recordCulling = [this, profiler](VkCommandBuffer commandBuffer) {
+            GpuProfiler::Zone cullZone(profiler, commandBuffer, "cull", true);
+            gpuCuller->recordCulling(commandBuffer, viewProjection);
+        };
+        renderGraph->addPass("cull", recordCulling)
+            .write(*drawCommands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT)
+            .write(*drawCount, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        // Every frame slot copies into its own element, read once the slot's fence has been waited on.
+        RenderGraph::Resource visibleCount =
+            renderGraph->importBuffer("visible count", gpuCuller->getVisibleCountBuffer(), {0, 0},
+                                      RenderGraph::Access{VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT});
+        auto recordVisibleCountCopy = [this](VkCommandBuffer commandBuffer) {
+            gpuCuller->recordVisibleCountCopy(commandBuffer, static_cast<uint32_t>(currentFrame));
+        };
+        renderGraph->addPass("visible count readback", recordVisibleCountCopy)
+            .read(*drawCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT)
+            .write(visibleCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+
+    // Post-processing renders into the frame's scene colour image, the compute passes then read it. Its previous
+    // contents are discarded, so the only thing to wait for are those reads on the same queue.
+    std::optional<RenderGraph::Resource> sceneColor;
+    VkFramebuffer framebuffer =
+        swapChainFramebuffers[postProcessor ? postProcessor->getFrameIndex() : imageIndex];
+    if (postProcessor)
+    {
+        std::optional<RenderGraph::Access> handOver;
+        if (asyncCompute)
         {
-            throw std::runtime_error("failed to begin recording command buffer!");
+            handOver = RenderGraph::Access{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
         }
+        sceneColor = renderGraph->importImage(
+            "scene color", postProcessor->getSceneColorImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+            {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}, handOver);
+    }
 
+    auto recordMainPass = [this, profiler, framebuffer](VkCommandBuffer commandBuffer) {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[i];
+        renderPassInfo.framebuffer = framebuffer;
         renderPassInfo.renderArea.offset = {0, 0};
         renderPassInfo.renderArea.extent = swapChainExtent;
 
@@ -316,46 +983,337 @@ void HelloTriangleApplication::createCommandBuffers()
         renderPassInfo.clearValueCount = 1;
         renderPassInfo.pClearValues = &clearColor;
 
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // With GPU culling there is nothing per draw left to record, so it never pays to go wide.
+        bool recordSecondaries = jobSystem && !gpuCuller;
+        // Without inheritedQueries secondaries can not run while a statistics query is active.
+        GpuProfiler::Zone mainPassZone(profiler, commandBuffer, "main pass",
+                                       !recordSecondaries || inheritedQueriesSupported);
+        if (recordSecondaries)
+        {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+            VkCommandBufferInheritanceInfo inheritanceInfo{};
+            inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritanceInfo.renderPass = renderPass;
+            inheritanceInfo.subpass = 0;
+            inheritanceInfo.framebuffer = framebuffer;
+            if (profiler && inheritedQueriesSupported)
+            {
+                inheritanceInfo.pipelineStatistics = profiler->getPipelineStatisticFlags();
+            }
+
+            // A few chunks per worker so stealing can even out chunks that take longer than others.
+            size_t chunkCount = std::min<size_t>(drawList.size(), jobSystem->getWorkerCount() * 4);
+            secondaryCommandBuffers.resize(chunkCount);
+            jobSystem->parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunk, uint32_t workerIndex) {
+                PROFILE_ZONE("record secondary command buffer");
+                VkCommandBufferBeginInfo secondaryBeginInfo{};
+                secondaryBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                secondaryBeginInfo.flags =
+                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+                VkCommandBuffer secondary = workerCommandAllocators[workerIndex]->allocateSecondary();
+                if (vkBeginCommandBuffer(secondary, &secondaryBeginInfo) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to begin recording secondary command buffer!");
+                }
+                size_t firstDraw = drawList.size() * chunk / chunkCount;
+                size_t lastDraw = drawList.size() * (chunk + 1) / chunkCount;
+                recordDraws(secondary, firstDraw, lastDraw - firstDraw);
+                if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to record secondary command buffer!");
+                }
+                secondaryCommandBuffers[chunk] = secondary;
+            });
+
+            // Executed in chunk order, so the draw order is the same as when recording on one thread.
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()),
+                                 secondaryCommandBuffers.data());
+        }
+        else
+        {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            recordDraws(commandBuffer, 0, drawList.size());
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+    };
+    // The render pass clears the target, so its previous contents are discarded.
+    RenderGraph::Pass &mainPass = renderGraph->addPass("main pass", recordMainPass);
+    mainPass.write(sceneColor ? *sceneColor : *target, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+    if (gpuCuller)
+    {
+        mainPass.read(*drawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+            .read(*drawCount, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+
+    // Without a second queue the compute passes and the copy follow the main pass in the same command buffer. The
+    // previous use of the output was a copy on this queue.
+    if (postProcessor && !asyncCompute)
+    {
+        VkImage outputImage = postProcessor->getOutputImage();
+        RenderGraph::Resource output =
+            renderGraph->importImage("post-processed", outputImage, VK_IMAGE_ASPECT_COLOR_BIT,
+                                     {VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+        postProcessor->addPasses(*renderGraph, *sceneColor, output, !isSrgbFormat(swapChainImageFormat), profiler);
+        addCopyPass(*renderGraph, output, outputImage, *target, imageIndex, profiler);
+    }
+
+    if (settings.headless && target)
+    {
+        addReadbackPass(*renderGraph, *target, imageIndex, profiler);
+    }
+
+    renderGraph->compile();
+    renderGraph->execute(commandBuffer);
 
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    if (profiler)
+    {
+        profiler->endFrame(commandBuffer);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+    recordingTime += std::chrono::steady_clock::now() - start;
+    return commandBuffer;
+}
+
+RenderGraph::Resource HelloTriangleApplication::importTarget(RenderGraph &graph, uint32_t imageIndex)
+{
+    // The acquire semaphore is waited on at the stage of the first write, the color attachment stage or the transfer
+    // stage of the post-processing copy. Presenting and host reads of the readback buffer happen after the submission.
+    if (settings.headless)
+    {
+        return graph.importImage("offscreen target", swapChainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+                                 {0, 0, VK_IMAGE_LAYOUT_UNDEFINED});
+    }
+    VkPipelineStageFlags firstStage =
+        postProcessor ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    return graph.importImage(
+        "swap chain image", swapChainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+        {firstStage, 0, VK_IMAGE_LAYOUT_UNDEFINED},
+        RenderGraph::Access{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+}
+
+void HelloTriangleApplication::addCopyPass(RenderGraph &graph, RenderGraph::Resource output, VkImage outputImage,
+                                           RenderGraph::Resource target, uint32_t imageIndex, GpuProfiler *profiler)
+{
+    // A blit rather than a copy, it converts the float output into the target's format.
+    auto recordCopy = [this, profiler, outputImage, imageIndex](VkCommandBuffer commandBuffer) {
+        GpuProfiler::Zone copyZone(profiler, commandBuffer, "copy to target");
+        VkImageBlit region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.srcOffsets[1] = {static_cast<int32_t>(swapChainExtent.width),
+                                static_cast<int32_t>(swapChainExtent.height), 1};
+        region.dstSubresource = region.srcSubresource;
+        region.dstOffsets[1] = region.srcOffsets[1];
+        vkCmdBlitImage(commandBuffer, outputImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImages[imageIndex],
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+    };
+    graph.addPass("copy to target", recordCopy)
+        .read(output, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+        .write(target, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+}
+
+void HelloTriangleApplication::addReadbackPass(RenderGraph &graph, RenderGraph::Resource target, uint32_t imageIndex,
+                                               GpuProfiler *profiler)
+{
+    RenderGraph::Resource readbackBuffer =
+        graph.importBuffer("readback buffer", readbackBuffers[imageIndex]->buffer, {0, 0},
+                           RenderGraph::Access{VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT});
+    auto recordReadback = [this, profiler, imageIndex](VkCommandBuffer commandBuffer) {
+        GpuProfiler::Zone readbackZone(profiler, commandBuffer, "readback");
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               readbackBuffers[imageIndex]->buffer, 1, &region);
+    };
+    graph.addPass("readback", recordReadback)
+        .read(target, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+        .write(readbackBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+VkCommandBuffer HelloTriangleApplication::recordPostProcessing()
+{
+    PROFILE_FUNCTION();
+    // The compute queue's previous use of this slot was waited on in recordCommandBuffer.
+    computeCommandAllocator->beginFrame(postProcessor->getFrameIndex());
+    VkCommandBuffer commandBuffer = computeCommandAllocator->allocatePrimary();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    // The scene colour arrives through the scene ready semaphore, already transitioned for sampling. The output is
+    // left for the copy on the graphics queue, whose semaphore wait makes the writes visible.
+    computeGraph->reset();
+    RenderGraph::Resource sceneColor =
+        computeGraph->importImage("scene color", postProcessor->getSceneColorImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+                                  {0, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    RenderGraph::Resource output = computeGraph->importImage(
+        "post-processed", postProcessor->getOutputImage(), VK_IMAGE_ASPECT_COLOR_BIT, {0, 0, VK_IMAGE_LAYOUT_UNDEFINED},
+        RenderGraph::Access{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+    // The GPU profiler's queries belong to the graphics queue, the compute passes are not timed.
+    postProcessor->addPasses(*computeGraph, sceneColor, output, !isSrgbFormat(swapChainImageFormat), nullptr);
+    computeGraph->compile();
+    computeGraph->execute(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+    return commandBuffer;
+}
+
+VkCommandBuffer HelloTriangleApplication::recordComposite(uint32_t imageIndex)
+{
+    PROFILE_FUNCTION();
+    // A second primary from the frame's pool, begun by recordCommandBuffer.
+    VkCommandBuffer commandBuffer = commandAllocator->allocatePrimary();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
 
-        VkBuffer vertexBuffers[] = {vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+    compositeGraph->reset();
+    RenderGraph::Resource target = importTarget(*compositeGraph, imageIndex);
+    RenderGraph::Resource output =
+        compositeGraph->importImage("post-processed", pendingPostOutput, VK_IMAGE_ASPECT_COLOR_BIT,
+                                    {VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+    addCopyPass(*compositeGraph, output, pendingPostOutput, target, imageIndex, nullptr);
+    if (settings.headless)
+    {
+        addReadbackPass(*compositeGraph, target, imageIndex, nullptr);
+    }
+    compositeGraph->compile();
+    compositeGraph->execute(commandBuffer);
 
-        vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+    return commandBuffer;
+}
 
-        vkCmdEndRenderPass(commandBuffers[i]);
+void HelloTriangleApplication::recordDraws(VkCommandBuffer commandBuffer, size_t firstDraw, size_t drawCount)
+{
+    // Secondary command buffers inherit nothing but the render pass, so all state is set here.
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
-        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapChainExtent.width;
+    viewport.height = (float)swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkBuffer vertexBuffers[] = {vertexBuffer->buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    if (!instanceBuffers.empty())
+    {
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffers[currentFrame]->buffer, offsets);
+    }
+
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->buffer, 0, indexType);
+
+    if (gpuCuller)
+    {
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(viewProjection),
+                           &viewProjection);
+        gpuCuller->recordDraws(commandBuffer, pipelineLayout);
+        return;
+    }
+
+    for (size_t i = firstDraw; i < firstDraw + drawCount; i++)
+    {
+        const VkDrawIndexedIndirectCommand &draw = drawList[i];
+        if (uniformRing)
         {
-            throw std::runtime_error("failed to record command buffer!");
+            uint32_t dynamicOffsets[] = {frameUniformOffset, objectUniformOffsets[i]};
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                    &uniformDescriptorSet, 2, dynamicOffsets);
+            float shade = 0.75f + 0.25f * static_cast<float>(i % 2);
+            DrawPushConstants pushConstants{glm::vec4(shade, shade, 1.0f, 1.0f)};
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants),
+                               &pushConstants);
         }
+        vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset,
+                         draw.firstInstance);
     }
 }
 
-void HelloTriangleApplication::createCommandPool()
+void HelloTriangleApplication::createCommandAllocator()
 {
-    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
+
+    commandAllocator = std::make_unique<FrameCommandAllocator>(
+        device, queueFamilyIndices.graphicsFamily.value(), static_cast<uint32_t>(maxFramesInFlight));
+
+    if (settings.useSecondaryCommandBuffers || settings.recordingThreads != 1)
+    {
+        jobSystem = std::make_unique<JobSystem>(settings.recordingThreads);
+        for (uint32_t i = 0; i < jobSystem->getWorkerCount(); i++)
+        {
+            workerCommandAllocators.push_back(std::make_unique<FrameCommandAllocator>(
+                device, queueFamilyIndices.graphicsFamily.value(), static_cast<uint32_t>(maxFramesInFlight)));
+        }
+    }
 
-    VkCommandPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    poolInfo.flags = 0; // Optional
-    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    if (settings.gpuProfiling)
     {
-        throw std::runtime_error("failed to create command pool!");
+        gpuProfiler = std::make_unique<GpuProfiler>(physicalDevice, device, queueFamilyIndices.graphicsFamily.value(),
+                                                    static_cast<uint32_t>(maxFramesInFlight),
+                                                    pipelineStatisticsQuerySupported);
     }
 }
 
 void HelloTriangleApplication::createFramebuffers()
 {
-    swapChainFramebuffers.resize(swapChainImageViews.size());
+    // With post-processing the main pass renders into the scene colour images instead, one framebuffer per frame.
+    std::vector<VkImageView> attachmentViews = swapChainImageViews;
+    if (postProcessor)
+    {
+        attachmentViews.resize(postProcessor->getFrameCount());
+        for (uint32_t i = 0; i < postProcessor->getFrameCount(); i++)
+        {
+            attachmentViews[i] = postProcessor->getSceneColorView(i);
+        }
+    }
+    swapChainFramebuffers.resize(attachmentViews.size());
 
-    for (size_t i = 0; i < swapChainImageViews.size(); i++)
+    for (size_t i = 0; i < attachmentViews.size(); i++)
     {
-        VkImageView attachments[] = {swapChainImageViews[i]};
+        VkImageView attachments[] = {attachmentViews[i]};
 
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -375,9 +1333,56 @@ void HelloTriangleApplication::createFramebuffers()
 
 void HelloTriangleApplication::createGraphicsPipeline()
 {
-    auto vertShaderCode = readFile("content/shaders/vert.spv");
-    auto fragShaderCode = readFile("content/shaders/frag.spv");
+    PROFILE_FUNCTION();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 0;            // Optional
+    pipelineLayoutInfo.pSetLayouts = nullptr;         // Optional
+    pipelineLayoutInfo.pushConstantRangeCount = 0;    // Optional
+    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
 
+    VkDescriptorSetLayout objectSetLayout = VK_NULL_HANDLE;
+    VkPushConstantRange cameraRange{};
+    if (gpuCuller)
+    {
+        objectSetLayout = gpuCuller->getDescriptorSetLayout();
+        cameraRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        cameraRange.offset = 0;
+        cameraRange.size = sizeof(glm::mat4);
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &objectSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &cameraRange;
+    }
+    VkPushConstantRange drawRange{};
+    if (uniformRing)
+    {
+        drawRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        drawRange.offset = 0;
+        drawRange.size = sizeof(DrawPushConstants);
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &uniformSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &drawRange;
+    }
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    graphicsPipeline = buildGraphicsPipeline(getShaderCode(getVertexShaderName()), getShaderCode(fragShaderName));
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Graphics pipeline created in " << elapsed.count() * 1000.0 << " ms ("
+              << (graphicsPipelineCreations++ == 0 ? "startup" : "swap chain recreation") << ", "
+              << (pipelineCache->getLoadedSize() > 0 ? "warm" : "cold") << " pipeline cache)" << std::endl;
+}
+
+VkPipeline HelloTriangleApplication::buildGraphicsPipeline(std::span<const uint8_t> vertShaderCode,
+                                                           std::span<const uint8_t> fragShaderCode) const
+{
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
     VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
@@ -392,17 +1397,33 @@ void HelloTriangleApplication::createGraphicsPipeline()
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
+    // UNORM targets (the headless images, or a surface without an sRGB format) get the shader variant that encodes.
+    // The HDR scene colour of post-processing stays linear, the tonemap pass encodes.
+    SpecializationConstants fragSpecialization;
+    fragSpecialization.set(shaderManifest->getConstantId(fragShaderName, "encodeSrgb"),
+                           settings.postProcessing || isSrgbFormat(swapChainImageFormat) ? VK_FALSE : VK_TRUE);
+    fragShaderStageInfo.pSpecializationInfo = fragSpecialization.get();
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions = {
+        VertexFormats::getBindingDescription(settings.vertexFormat)};
+    auto vertexAttributeDescriptions = VertexFormats::getAttributeDescriptions(settings.vertexFormat);
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributeDescriptions.begin(),
+                                                                         vertexAttributeDescriptions.end());
+    if (!instanceBuffers.empty())
+    {
+        bindingDescriptions.push_back(InstanceData::getBindingDescription());
+        auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions();
+        attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributeDescriptions.begin(),
+                                     instanceAttributeDescriptions.end());
+    }
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -410,24 +1431,19 @@ void HelloTriangleApplication::createGraphicsPipeline()
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)swapChainExtent.width;
-    viewport.height = (float)swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapChainExtent;
-
+    // Viewport and scissor are set while recording, so a resize does not invalidate the pipeline.
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
 
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -472,18 +1488,6 @@ void HelloTriangleApplication::createGraphicsPipeline()
     colorBlending.blendConstants[2] = 0.0f; // Optional
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;            // Optional
-    pipelineLayoutInfo.pSetLayouts = nullptr;         // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0;    // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
-
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = 2;
@@ -495,32 +1499,179 @@ void HelloTriangleApplication::createGraphicsPipeline()
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pDepthStencilState = nullptr; // Optional
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr; // Optional
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = pipelineLayout;
     pipelineInfo.renderPass = renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1;              // Optional
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    if (result != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
+    return pipeline;
+}
 
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+std::string HelloTriangleApplication::getVertexShaderName() const
+{
+    // GPU culling draws through the object buffer, its vertex shader applies the per-object transforms.
+    if (gpuCuller)
+    {
+        return "shaders/indirect.vert.spv";
+    }
+    if (!instanceBuffers.empty())
+    {
+        return "shaders/instanced.vert.spv";
+    }
+    if (uniformRing)
+    {
+        return "shaders/object.vert.spv";
+    }
+    return "shaders/shader.vert.spv";
+}
+
+std::span<const uint8_t> HelloTriangleApplication::getShaderCode(const std::string &name) const
+{
+    auto it = reloadedShaders.find(name);
+    if (it != reloadedShaders.end())
+    {
+        return it->second;
+    }
+    return assets->get(name);
+}
+
+void HelloTriangleApplication::updateShaderReload()
+{
+    PROFILE_FUNCTION();
+    if (!shaderWatcher)
+    {
+        return;
+    }
+    if (pendingShaderReload.valid())
+    {
+        if (pendingShaderReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+        applyShaderReload(pendingShaderReload.get(), true);
+    }
+
+    // Files written while a reload runs stay queued in the watcher and start the next one.
+    std::vector<std::string> changes = shaderWatcher->takeChanges();
+    if (changes.empty())
+    {
+        return;
+    }
+    std::string vertShaderName = getVertexShaderName();
+    std::span<const uint8_t> vertShaderCode = getShaderCode(vertShaderName);
+    std::span<const uint8_t> fragShaderCode = getShaderCode(fragShaderName);
+    pendingShaderReload = std::async(std::launch::async, &HelloTriangleApplication::reloadShaders, this,
+                                     std::move(changes), std::move(vertShaderName),
+                                     std::vector<uint8_t>(vertShaderCode.begin(), vertShaderCode.end()),
+                                     std::vector<uint8_t>(fragShaderCode.begin(), fragShaderCode.end()));
+}
+
+HelloTriangleApplication::ShaderReload HelloTriangleApplication::reloadShaders(
+    const std::vector<std::string> &changes, const std::string &vertShaderName, std::vector<uint8_t> vertShaderCode,
+    std::vector<uint8_t> fragShaderCode) const
+{
+    PROFILE_THREAD_NAME("shader reload");
+    PROFILE_FUNCTION();
+    ShaderReload reload;
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        for (const std::string &change : changes)
+        {
+            // GLSL sources compile to <source>.spv, the same asset name the build gives them. Only the graphics
+            // pipeline is rebuilt, cull.comp changes still need a restart.
+            std::filesystem::path source = std::filesystem::path(settings.shaderWatchPath) / change;
+            bool isSpirv = source.extension() == ".spv";
+            std::string assetName = isSpirv ? change : change + ".spv";
+            if (assetName != vertShaderName && assetName != fragShaderName)
+            {
+                continue;
+            }
+            if (!isSpirv)
+            {
+                // Outside the watched directory, or writing it would trigger another reload.
+                std::filesystem::path output =
+                    std::filesystem::temp_directory_path() / source.filename().concat(".hot_reload.spv");
+                std::string command = "glslc --target-env=vulkan1.2 -O \"" + source.string() + "\" -o \"" +
+                                      output.string() + "\"";
+                if (std::system(command.c_str()) != 0)
+                {
+                    throw std::runtime_error("glslc failed on " + change);
+                }
+                source = output;
+            }
+            reload.shaders[assetName] = readBinaryFile(source);
+        }
+
+        auto vertShader = reload.shaders.find(vertShaderName);
+        auto fragShader = reload.shaders.find(fragShaderName);
+        if (vertShader != reload.shaders.end() || fragShader != reload.shaders.end())
+        {
+            reload.pipeline =
+                buildGraphicsPipeline(vertShader != reload.shaders.end() ? vertShader->second : vertShaderCode,
+                                      fragShader != reload.shaders.end() ? fragShader->second : fragShaderCode);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        reload.error = e.what();
+    }
+    reload.duration = std::chrono::steady_clock::now() - start;
+    return reload;
+}
+
+void HelloTriangleApplication::applyShaderReload(ShaderReload reload, bool swapPipeline)
+{
+    if (!reload.error.empty())
+    {
+        std::cout << "Shader reload failed, keeping the current shaders: " << reload.error << std::endl;
+        return;
+    }
+    for (auto &[name, code] : reload.shaders)
+    {
+        std::cout << "Reloaded " << name << std::endl;
+        reloadedShaders[name] = std::move(code);
+    }
+    if (reload.pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    if (!swapPipeline)
+    {
+        // The caller rebuilds the pipeline itself, from reloadedShaders.
+        vkDestroyPipeline(device, reload.pipeline, nullptr);
+        return;
+    }
+    // Frames in flight still use the old pipeline, command buffers recorded from now on bind the new one.
+    VkPipeline oldPipeline = graphicsPipeline;
+    deferDeletion([this, oldPipeline]() { vkDestroyPipeline(device, oldPipeline, nullptr); });
+    graphicsPipeline = reload.pipeline;
+    std::cout << "Graphics pipeline rebuilt in the background in " << reload.duration.count() * 1000.0 << " ms"
+              << std::endl;
 }
 
 void HelloTriangleApplication::createRenderPass()
 {
     VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = swapChainImageFormat;
+    colorAttachment.format = settings.postProcessing ? PostProcessor::sceneColorFormat : swapChainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // The render graph transitions the image before and after the render pass.
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -538,26 +1689,13 @@ void HelloTriangleApplication::createRenderPass()
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
 
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
     if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create render pass!");
     }
 }
 
-VkShaderModule HelloTriangleApplication::createShaderModule(const std::vector<char> &code)
+VkShaderModule HelloTriangleApplication::createShaderModule(std::span<const uint8_t> code) const
 {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -597,11 +1735,10 @@ void HelloTriangleApplication::createImageViews()
     }
 }
 
-void HelloTriangleApplication::createSwapChain()
+void HelloTriangleApplication::createSwapChain(VkSurfaceFormatKHR surfaceFormat, VkSwapchainKHR oldSwapChain)
 {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
-    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -618,8 +1755,17 @@ void HelloTriangleApplication::createSwapChain()
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (settings.postProcessing)
+    {
+        // The post-processed output is blitted into the image.
+        if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+        {
+            throw std::runtime_error("swap chain images can not be transfer destinations!");
+        }
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
 
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
     if (indices.graphicsFamily != indices.presentFamily)
@@ -641,16 +1787,105 @@ void HelloTriangleApplication::createSwapChain()
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the driver hand resources over from the retired swap chain, frames using it keep presenting meanwhile.
+    createInfo.oldSwapchain = oldSwapChain;
     if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to create swap chain!");
+        throw std::runtime_error("failed to create swap chain!");
+    }
+    vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
+    swapChainImages.resize(imageCount);
+    vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
+    swapChainExtent = extent;
+}
+
+void HelloTriangleApplication::createOffscreenTargets(VkExtent2D extent)
+{
+    swapChainExtent = extent;
+
+    swapChainImages.resize(maxFramesInFlight);
+    offscreenImageAllocations.resize(maxFramesInFlight);
+    readbackBuffers.resize(maxFramesInFlight);
+    pendingReadbacks.assign(maxFramesInFlight, std::nullopt);
+
+    for (size_t i = 0; i < maxFramesInFlight; i++)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = swapChainImageFormat;
+        imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // Read back with a copy, post-processing blits its output into them.
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                          VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        offscreenImageAllocations[i] =
+            memoryAllocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i]);
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        // Cached memory makes the host-side reads fast, the allocator falls back to any host-visible type.
+        readbackBuffers[i] = memoryAllocator->createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                                           VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    }
+}
+
+void HelloTriangleApplication::destroyOffscreenTargets()
+{
+    for (size_t i = 0; i < swapChainImages.size(); i++)
+    {
+        memoryAllocator->destroyImage(swapChainImages[i], offscreenImageAllocations[i]);
+        memoryAllocator->destroyBuffer(readbackBuffers[i]);
+    }
+}
+
+void HelloTriangleApplication::resizeOffscreenTargets(VkExtent2D extent)
+{
+    PROFILE_FUNCTION();
+    // Readbacks are delivered with the current extent, so every frame still in flight has to land first. That also
+    // means nothing uses the old targets anymore and they can be destroyed right away.
+    vkWaitForFences(device, static_cast<uint32_t>(inFlightFences.size()), inFlightFences.data(), VK_TRUE,
+                    UINT64_MAX);
+    flushReadbacks();
+    lastReadbackSlot.reset();
+
+    for (VkFramebuffer framebuffer : swapChainFramebuffers)
+    {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
+    for (VkImageView imageView : swapChainImageViews)
+    {
+        vkDestroyImageView(device, imageView, nullptr);
+    }
+    destroyOffscreenTargets();
+
+    createOffscreenTargets(extent);
+    createImageViews();
+    if (postProcessor)
+    {
+        resizePostProcessor();
+        // Nothing is in flight anymore, the retired images can go right away.
+        flushDeletions();
     }
-    vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
-    swapChainImages.resize(imageCount);
-    vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
-    swapChainImageFormat = surfaceFormat.format;
-    swapChainExtent = extent;
+    createFramebuffers();
+    statistics.swapChainRecreations++;
+}
+
+void HelloTriangleApplication::resizePostProcessor()
+{
+    // The frame fences do not cover the compute queue, so it has to be done with the images before they are retired.
+    // The output still waiting to be copied has the old size and is dropped.
+    waitForPostProcessing(postProcessedFrames);
+    pendingPostOutput = VK_NULL_HANDLE;
+    postProcessor->resize(swapChainExtent);
 }
 
 void HelloTriangleApplication::createSurface()
@@ -663,25 +1898,61 @@ void HelloTriangleApplication::createSurface()
 
 void HelloTriangleApplication::createLogicalDevice()
 {
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    PROFILE_FUNCTION();
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, deviceCapabilities.queueFamilies);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    if (indices.transferFamily.has_value())
+    {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
+    bool asyncCompute = settings.postProcessing && settings.asyncCompute && indices.computeFamily.has_value();
+    if (asyncCompute)
+    {
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
+    }
+    else if (settings.postProcessing && settings.asyncCompute)
+    {
+        std::cout << "No second queue for async compute, post-processing runs on the graphics queue" << std::endl;
+    }
 
-    float queuePriority = 1.0f;
+    float queuePriorities[] = {1.0f, 1.0f};
     for (uint32_t queueFamily : uniqueQueueFamilies)
     {
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        // Two when the compute queue is the graphics family's second one.
+        queueCreateInfo.queueCount =
+            asyncCompute && queueFamily == indices.computeFamily.value() ? indices.computeQueueIndex + 1 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
     VkPhysicalDeviceFeatures deviceFeatures{};
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    if (settings.gpuCulling)
+    {
+        // Required by pickPhysicalDevice. The draw count is optional, culled draws fall back to zero instances.
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+        drawIndirectCountSupported = deviceCapabilities.drawIndirectCount;
+        vulkan12Features.drawIndirectCount = drawIndirectCountSupported ? VK_TRUE : VK_FALSE;
+    }
+    if (settings.gpuProfiling)
+    {
+        // Both optional, the profiler measures time without them.
+        pipelineStatisticsQuerySupported = deviceCapabilities.features.pipelineStatisticsQuery == VK_TRUE;
+        inheritedQueriesSupported = deviceCapabilities.features.inheritedQueries == VK_TRUE;
+        deviceFeatures.pipelineStatisticsQuery = deviceCapabilities.features.pipelineStatisticsQuery;
+        deviceFeatures.inheritedQueries = deviceCapabilities.features.inheritedQueries;
+    }
     VkDeviceCreateInfo createInfo{};
 
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &vulkan12Features;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -706,10 +1977,16 @@ void HelloTriangleApplication::createLogicalDevice()
     }
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, indices.transferFamily.value_or(indices.graphicsFamily.value()), 0, &transferQueue);
+    if (asyncCompute)
+    {
+        vkGetDeviceQueue(device, indices.computeFamily.value(), indices.computeQueueIndex, &computeQueue);
+    }
 }
 
 void HelloTriangleApplication::pickPhysicalDevice()
 {
+    PROFILE_FUNCTION();
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
     if (deviceCount == 0)
@@ -718,81 +1995,77 @@ void HelloTriangleApplication::pickPhysicalDevice()
     }
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
-    for (const auto &device : devices)
-    {
-        if (isDeviceSuitable(device))
-        {
-            physicalDevice = device;
-            break;
-        }
-    }
 
-    if (physicalDevice == VK_NULL_HANDLE)
+    DeviceSelector::Requirements requirements;
+    // Uploads are tracked with timeline semaphores, a core Vulkan 1.2 feature.
+    requirements.apiVersion = VK_API_VERSION_1_2;
+    requirements.timelineSemaphore = true;
+    requirements.extensions = deviceExtensions;
+    if (settings.gpuCulling)
     {
-        throw std::runtime_error("failed to find a suitable GPU!");
+        requirements.features.multiDrawIndirect = VK_TRUE;
+        requirements.features.drawIndirectFirstInstance = VK_TRUE;
     }
-}
-
-bool HelloTriangleApplication::isDeviceSuitable(VkPhysicalDevice device)
-{
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
-    QueueFamilyIndices indices = findQueueFamilies(device);
-    VkPhysicalDeviceProperties deviceProperties;
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
-    bool swapChainAdequate = false;
-    if (extensionsSupported)
+    // Headless nodes without a GPU fall back to a software ICD such as lavapipe.
+    requirements.allowSoftware = settings.headless;
+
+    DeviceSelector selector(settings.deviceCachePath);
+    auto filter = [this](VkPhysicalDevice device, const DeviceSelector::Capabilities &capabilities) {
+        return isDeviceSuitable(device, capabilities) ? std::string() : std::string("can not present to the window");
+    };
+    const DeviceSelector::Candidate *selected = selector.select(devices, requirements, filter);
+    std::cout << "Physical devices:" << std::endl;
+    selector.printCandidates(std::cout);
+    if (!selected)
     {
-        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        throw std::runtime_error("failed to find a suitable GPU!");
     }
-    return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && indices.isComplete() &&
-           extensionsSupported && swapChainAdequate;
-    return true;
+    physicalDevice = selected->device;
+    deviceCapabilities = selected->capabilities;
+    std::cout << "Using " << deviceCapabilities.properties.deviceName << std::endl;
 }
 
-bool HelloTriangleApplication::checkDeviceExtensionSupport(VkPhysicalDevice device)
+bool HelloTriangleApplication::isDeviceSuitable(VkPhysicalDevice device,
+                                                const DeviceSelector::Capabilities &capabilities)
 {
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-    for (const auto &extension : availableExtensions)
+    // The queue families come from the device cache, only what depends on the surface is queried.
+    QueueFamilyIndices indices = findQueueFamilies(device, capabilities.queueFamilies);
+    if (settings.headless)
     {
-        requiredExtensions.erase(extension.extensionName);
+        return indices.isComplete();
     }
 
-    return requiredExtensions.empty();
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+    return indices.isComplete() && !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 }
 
-HelloTriangleApplication::QueueFamilyIndices HelloTriangleApplication::findQueueFamilies(VkPhysicalDevice device)
+HelloTriangleApplication::QueueFamilyIndices HelloTriangleApplication::findQueueFamilies(
+    VkPhysicalDevice device, const std::vector<VkQueueFamilyProperties> &queueFamilies)
 {
     QueueFamilyIndices indices;
 
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+    uint32_t queueFamilyCount = static_cast<uint32_t>(queueFamilies.size());
     int i = 0;
     for (const auto &queueFamily : queueFamilies)
     {
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport)
-        {
-            indices.presentFamily = i;
-        }
         if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
         {
             indices.graphicsFamily = i;
         }
+        if (settings.headless)
+        {
+            // Nothing is presented, the graphics queue doubles as the present queue.
+            indices.presentFamily = indices.graphicsFamily;
+        }
+        else
+        {
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (presentSupport)
+            {
+                indices.presentFamily = i;
+            }
+        }
         if (indices.isComplete())
         {
             break;
@@ -800,6 +2073,34 @@ HelloTriangleApplication::QueueFamilyIndices HelloTriangleApplication::findQueue
 
         i++;
     }
+
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            indices.transferFamily = family;
+            break;
+        }
+    }
+
+    // A compute-only family usually feeds the shader cores from its own hardware queue, which is what lets compute
+    // work fill the gaps rasterisation leaves.
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            indices.computeFamily = family;
+            break;
+        }
+    }
+    if (!indices.computeFamily.has_value() && indices.graphicsFamily.has_value() &&
+        queueFamilies[indices.graphicsFamily.value()].queueCount > 1)
+    {
+        indices.computeFamily = indices.graphicsFamily;
+        indices.computeQueueIndex = 1;
+    }
     return indices;
 }
 
@@ -880,13 +2181,15 @@ VkExtent2D HelloTriangleApplication::chooseSwapExtent(const VkSurfaceCapabilitie
 
 void HelloTriangleApplication::initWindow()
 {
-    glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
     window = glfwCreateWindow(Width, Height, "Vulkan", nullptr, nullptr);
 
     glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+#ifdef ENABLE_PROFILER
+    glfwSetKeyCallback(window, keyCallback);
+#endif
 }
 
 void HelloTriangleApplication::framebufferResizeCallback(GLFWwindow *window, int width, int height)
@@ -895,24 +2198,211 @@ void HelloTriangleApplication::framebufferResizeCallback(GLFWwindow *window, int
     app->framebufferResized = true;
 }
 
+void HelloTriangleApplication::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+    {
+        auto app = reinterpret_cast<HelloTriangleApplication *>(glfwGetWindowUserPointer(window));
+        try
+        {
+            app->writeCpuTrace();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+}
+
 void HelloTriangleApplication::mainLoop()
 {
-    while (!glfwWindowShouldClose(window))
+    if (settings.headless)
+    {
+        uint32_t frameCount =
+            settings.frameCount != 0 ? settings.frameCount : ApplicationSettings::defaultHeadlessFrameCount;
+
+        auto start = std::chrono::steady_clock::now();
+        auto frameStart = start;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            PROFILE_ZONE("frame");
+            if (settings.resizeInterval != 0 && i != 0 && i % settings.resizeInterval == 0)
+            {
+                // Like a window being dragged around the requested size.
+                static constexpr float scales[] = {0.5f, 0.75f, 1.25f, 1.0f};
+                float scale = scales[(i / settings.resizeInterval - 1) % std::size(scales)];
+                resizeOffscreenTargets({std::max(1u, static_cast<uint32_t>(Width * scale)),
+                                        std::max(1u, static_cast<uint32_t>(Height * scale))});
+            }
+            updateShaderReload();
+            drawOffscreenFrame();
+
+            auto frameEnd = std::chrono::steady_clock::now();
+            statistics.frameMilliseconds.push_back(
+                std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+            frameStart = frameEnd;
+        }
+        vkDeviceWaitIdle(device);
+        flushReadbacks();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        collectStatistics();
+
+        std::cout << "Rendered " << frameCount << " offscreen frames with " << maxFramesInFlight
+                  << " frames in flight in " << elapsed.count() * 1000.0 << " ms (" << frameCount / elapsed.count()
+                  << " fps)" << std::endl;
+        printRecordingStatistics();
+        printRenderGraphStatistics();
+        printGpuStatistics();
+        printMemoryStatistics();
+        writeCpuTrace();
+
+        if (!settings.dumpFramePath.empty() && lastReadbackSlot.has_value())
+        {
+            writeFrameToPpm(settings.dumpFramePath, lastReadbackSlot.value());
+        }
+        return;
+    }
+
+    auto frameStart = std::chrono::steady_clock::now();
+    while (!glfwWindowShouldClose(window) && (settings.frameCount == 0 || frameNumber < settings.frameCount))
     {
+        PROFILE_ZONE("frame");
         glfwPollEvents();
+        updateShaderReload();
         drawFrame();
+        frameNumber++;
+
+        auto frameEnd = std::chrono::steady_clock::now();
+        statistics.frameMilliseconds.push_back(
+            std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        frameStart = frameEnd;
     }
 
     vkDeviceWaitIdle(device);
+    collectStatistics();
+    printRecordingStatistics();
+    printRenderGraphStatistics();
+    printGpuStatistics();
+    writeCpuTrace();
+}
+
+void HelloTriangleApplication::collectStatistics()
+{
+    if (frameNumber != 0)
+    {
+        statistics.averageRecordingMilliseconds = recordingTime.count() * 1000.0 / frameNumber;
+    }
+    if (gpuProfiler)
+    {
+        // The device is idle, the last frames of every slot have finished.
+        gpuProfiler->collectFinishedFrames();
+        statistics.gpuFrameMilliseconds = gpuProfiler->getFrameMilliseconds();
+        statistics.gpuZoneMilliseconds = gpuProfiler->getZoneMilliseconds();
+        statistics.gpuZoneVertexInvocations = gpuProfiler->getZoneVertexInvocations();
+    }
+    for (size_t slot = 0; slot < maxFramesInFlight; slot++)
+    {
+        collectCullingStatistics(slot);
+    }
+    if (culledFrames != 0)
+    {
+        statistics.averageCulledObjects = static_cast<double>(culledObjects) / culledFrames;
+    }
+    statistics.deviceAllocationCount = memoryAllocator->getDeviceAllocationCount();
+    statistics.graphicsPipelineCreations = graphicsPipelineCreations;
+}
+
+const HelloTriangleApplication::RunStatistics &HelloTriangleApplication::getStatistics() const
+{
+    return statistics;
+}
+
+void HelloTriangleApplication::printRecordingStatistics()
+{
+    if (frameNumber == 0)
+    {
+        return;
+    }
+    std::cout << "Recorded " << drawList.size() << " draw calls per frame on "
+              << (jobSystem ? jobSystem->getWorkerCount() : 1) << " thread(s) in "
+              << recordingTime.count() * 1000.0 / frameNumber << " ms on average" << std::endl;
+    if (gpuCuller)
+    {
+        std::cout << "GPU culling rejected " << statistics.averageCulledObjects << " of " << gpuCuller->getObjectCount()
+                  << " objects per frame on average" << std::endl;
+    }
+}
+
+void HelloTriangleApplication::printGpuStatistics()
+{
+    if (gpuProfiler)
+    {
+        gpuProfiler->printStatistics(std::cout);
+    }
+}
+
+void HelloTriangleApplication::printRenderGraphStatistics()
+{
+    const RenderGraph::Statistics &graphStatistics = renderGraph->getStatistics();
+    std::cout << "Render graph: " << graphStatistics.passCount << " passes (" << graphStatistics.culledPassCount
+              << " culled), " << graphStatistics.barrierCount << " barriers with " << graphStatistics.imageBarrierCount
+              << " image and " << graphStatistics.bufferBarrierCount << " buffer barriers, "
+              << graphStatistics.transientImageCount << " transient images in " << graphStatistics.transientBytes
+              << " bytes (" << graphStatistics.unaliasedTransientBytes << " without aliasing)" << std::endl;
+}
+
+void HelloTriangleApplication::writeCpuTrace()
+{
+    if (!settings.cpuTracePath.empty())
+    {
+        PROFILE_WRITE_TRACE(settings.cpuTracePath);
+        std::cout << "Wrote CPU trace to " << settings.cpuTracePath << std::endl;
+    }
+}
+
+void HelloTriangleApplication::printMemoryStatistics()
+{
+    std::cout << "Device memory: " << memoryAllocator->getDeviceAllocationCount() << " vkAllocateMemory allocations"
+              << std::endl;
+    std::vector<DeviceMemoryAllocator::HeapStatistics> statistics = memoryAllocator->getHeapStatistics();
+    for (size_t i = 0; i < statistics.size(); i++)
+    {
+        if (statistics[i].blockCount == 0)
+        {
+            continue;
+        }
+        std::cout << "\theap " << i << ": " << statistics[i].allocationCount << " allocations in "
+                  << statistics[i].blockCount << " blocks, " << statistics[i].requestedBytes << " of "
+                  << statistics[i].blockBytes << " bytes used, fragmentation " << statistics[i].fragmentation
+                  << std::endl;
+    }
 }
 
 void HelloTriangleApplication::drawFrame()
 {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    PROFILE_FUNCTION();
+    {
+        PROFILE_ZONE("wait for frame fence");
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    collectCullingStatistics(currentFrame);
+    collectDeletions();
+
+    // With async compute the first frame, and the first after a resize, have no post-processed output to present yet.
+    if (computeQueue != VK_NULL_HANDLE && pendingPostOutput == VK_NULL_HANDLE)
+    {
+        submitWithAsyncCompute(recordCommandBuffer(0), VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE);
+        currentFrame = (currentFrame + 1) % maxFramesInFlight;
+        return;
+    }
 
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
-                                            VK_NULL_HANDLE, &imageIndex);
+    VkResult result;
+    {
+        PROFILE_ZONE("acquire image");
+        result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
+                                       VK_NULL_HANDLE, &imageIndex);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
     {
@@ -932,34 +2422,57 @@ void HelloTriangleApplication::drawFrame()
     // Mark the image as now being in use by this frame
     imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    VkCommandBuffer commandBuffer = recordCommandBuffer(imageIndex);
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+    if (computeQueue != VK_NULL_HANDLE)
     {
-        throw std::runtime_error("failed to submit draw command buffer!");
+        submitWithAsyncCompute(commandBuffer, recordComposite(imageIndex), imageAvailableSemaphores[currentFrame],
+                               renderFinishedSemaphores[currentFrame]);
+    }
+    else
+    {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        // The timeline wait is a no-op once the uploads have landed, binary semaphores ignore their value.
+        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame],
+                                        stagingUploader->getTimelineSemaphore()};
+        // The first write to the image is the post-processing copy when there is one.
+        VkPipelineStageFlags waitStages[] = {
+            postProcessor ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+        uint64_t waitValues[] = {0, uploadsReadyValue};
+        submitInfo.waitSemaphoreCount = 2;
+        submitInfo.pWaitSemaphores = waitSemaphores;
+        submitInfo.pWaitDstStageMask = waitStages;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 2;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        submitInfo.pNext = &timelineInfo;
+
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        submittedFrames++;
     }
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
     VkSwapchainKHR swapChains[] = {swapChain};
     presentInfo.swapchainCount = 1;
@@ -967,10 +2480,15 @@ void HelloTriangleApplication::drawFrame()
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr; // Optional
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        PROFILE_ZONE("present");
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    // Not every platform reports a resize through the present result, so the GLFW callback is honoured too.
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
     {
+        framebufferResized = false;
         recreateSwapChain();
     }
     else if (result != VK_SUCCESS)
@@ -978,11 +2496,226 @@ void HelloTriangleApplication::drawFrame()
         throw std::runtime_error("failed to present swap chain image!");
     }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % maxFramesInFlight;
+}
+
+void HelloTriangleApplication::drawOffscreenFrame()
+{
+    PROFILE_FUNCTION();
+    {
+        PROFILE_ZONE("wait for frame fence");
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    collectCullingStatistics(currentFrame);
+    collectDeletions();
+
+    // The frame previously rendered from this slot has finished, its pixels are ready in host memory.
+    deliverReadback(currentFrame);
+
+    VkCommandBuffer commandBuffer = recordCommandBuffer(static_cast<uint32_t>(currentFrame));
+
+    // The slot's target receives the previous frame, once it is post-processed. The first frame and the first after
+    // a resize have nothing to read back.
+    if (computeQueue != VK_NULL_HANDLE)
+    {
+        bool composite = pendingPostOutput != VK_NULL_HANDLE;
+        submitWithAsyncCompute(commandBuffer,
+                               composite ? recordComposite(static_cast<uint32_t>(currentFrame)) : VK_NULL_HANDLE,
+                               VK_NULL_HANDLE, VK_NULL_HANDLE);
+        if (composite)
+        {
+            pendingReadbacks[currentFrame] = frameNumber - 1;
+        }
+        frameNumber++;
+        currentFrame = (currentFrame + 1) % maxFramesInFlight;
+        return;
+    }
+
+    VkSemaphore waitSemaphore = stagingUploader->getTimelineSemaphore();
+    VkPipelineStageFlags waitStage =
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &uploadsReadyValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &waitSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    submittedFrames++;
+
+    pendingReadbacks[currentFrame] = frameNumber++;
+    currentFrame = (currentFrame + 1) % maxFramesInFlight;
+}
+
+void HelloTriangleApplication::submitWithAsyncCompute(VkCommandBuffer commandBuffer,
+                                                      VkCommandBuffer compositeCommandBuffer,
+                                                      VkSemaphore imageAvailableSemaphore,
+                                                      VkSemaphore renderFinishedSemaphore)
+{
+    PROFILE_FUNCTION();
+    // Of the frame recordCommandBuffer just recorded.
+    VkSemaphore sceneReadySemaphore = sceneReadySemaphores[postProcessor->getFrameIndex()];
+    VkCommandBuffer computeCommandBuffer = recordPostProcessing();
+
+    // The timeline waits are no-ops once reached, binary semaphores ignore their value.
+    VkSemaphore uploadSemaphore = stagingUploader->getTimelineSemaphore();
+    VkPipelineStageFlags uploadStage =
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    uint64_t binaryValue = 0;
+    VkTimelineSemaphoreSubmitInfo sceneTimelineInfo{};
+    sceneTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    sceneTimelineInfo.waitSemaphoreValueCount = 1;
+    sceneTimelineInfo.pWaitSemaphoreValues = &uploadsReadyValue;
+    sceneTimelineInfo.signalSemaphoreValueCount = 1;
+    sceneTimelineInfo.pSignalSemaphoreValues = &binaryValue;
+
+    // First batch: the scene, handed to the compute queue once rendered.
+    VkSubmitInfo submitInfos[2]{};
+    submitInfos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfos[0].pNext = &sceneTimelineInfo;
+    submitInfos[0].waitSemaphoreCount = 1;
+    submitInfos[0].pWaitSemaphores = &uploadSemaphore;
+    submitInfos[0].pWaitDstStageMask = &uploadStage;
+    submitInfos[0].commandBufferCount = 1;
+    submitInfos[0].pCommandBuffers = &commandBuffer;
+    submitInfos[0].signalSemaphoreCount = 1;
+    submitInfos[0].pSignalSemaphores = &sceneReadySemaphore;
+
+    // Second batch: the copy of the previous frame's output, which waits for the compute queue and the swap chain
+    // image. Only the copy waits, the scene of this frame already runs alongside the previous post-processing.
+    std::vector<VkSemaphore> compositeWaits = {postProcessSemaphore};
+    std::vector<uint64_t> compositeWaitValues = {pendingPostValue};
+    if (imageAvailableSemaphore != VK_NULL_HANDLE)
+    {
+        compositeWaits.push_back(imageAvailableSemaphore);
+        compositeWaitValues.push_back(0);
+    }
+    std::vector<VkPipelineStageFlags> compositeWaitStages(compositeWaits.size(), VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkTimelineSemaphoreSubmitInfo compositeTimelineInfo{};
+    compositeTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    compositeTimelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(compositeWaitValues.size());
+    compositeTimelineInfo.pWaitSemaphoreValues = compositeWaitValues.data();
+    compositeTimelineInfo.signalSemaphoreValueCount = renderFinishedSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    compositeTimelineInfo.pSignalSemaphoreValues = &binaryValue;
+
+    submitInfos[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfos[1].pNext = &compositeTimelineInfo;
+    submitInfos[1].waitSemaphoreCount = static_cast<uint32_t>(compositeWaits.size());
+    submitInfos[1].pWaitSemaphores = compositeWaits.data();
+    submitInfos[1].pWaitDstStageMask = compositeWaitStages.data();
+    submitInfos[1].commandBufferCount = 1;
+    submitInfos[1].pCommandBuffers = &compositeCommandBuffer;
+    submitInfos[1].signalSemaphoreCount = renderFinishedSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    submitInfos[1].pSignalSemaphores = &renderFinishedSemaphore;
+
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+    uint32_t batchCount = compositeCommandBuffer != VK_NULL_HANDLE ? 2 : 1;
+    if (vkQueueSubmit(graphicsQueue, batchCount, submitInfos, inFlightFences[currentFrame]) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    submittedFrames++;
+
+    // Frame n signals n + 1, postProcessedFrames already counts this frame.
+    VkPipelineStageFlags sceneReadyStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    uint64_t postProcessedValue = postProcessedFrames;
+    VkTimelineSemaphoreSubmitInfo computeTimelineInfo{};
+    computeTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    computeTimelineInfo.waitSemaphoreValueCount = 1;
+    computeTimelineInfo.pWaitSemaphoreValues = &binaryValue;
+    computeTimelineInfo.signalSemaphoreValueCount = 1;
+    computeTimelineInfo.pSignalSemaphoreValues = &postProcessedValue;
+
+    VkSubmitInfo computeSubmitInfo{};
+    computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    computeSubmitInfo.pNext = &computeTimelineInfo;
+    computeSubmitInfo.waitSemaphoreCount = 1;
+    computeSubmitInfo.pWaitSemaphores = &sceneReadySemaphore;
+    computeSubmitInfo.pWaitDstStageMask = &sceneReadyStage;
+    computeSubmitInfo.commandBufferCount = 1;
+    computeSubmitInfo.pCommandBuffers = &computeCommandBuffer;
+    computeSubmitInfo.signalSemaphoreCount = 1;
+    computeSubmitInfo.pSignalSemaphores = &postProcessSemaphore;
+    if (vkQueueSubmit(computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit post-processing command buffer!");
+    }
+
+    pendingPostOutput = postProcessor->getOutputImage();
+    pendingPostValue = postProcessedValue;
+}
+
+void HelloTriangleApplication::waitForPostProcessing(uint64_t value)
+{
+    if (computeQueue == VK_NULL_HANDLE || value == 0)
+    {
+        return;
+    }
+    PROFILE_ZONE("wait for post-processing");
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &postProcessSemaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+}
+
+void HelloTriangleApplication::deliverReadback(size_t slot)
+{
+    if (!pendingReadbacks[slot].has_value())
+    {
+        return;
+    }
+
+    memoryAllocator->invalidate(readbackBuffers[slot]);
+
+    if (frameReadbackCallback)
+    {
+        frameReadbackCallback(static_cast<const uint8_t *>(readbackBuffers[slot]->mapped), swapChainExtent,
+                              pendingReadbacks[slot].value());
+    }
+    pendingReadbacks[slot].reset();
+    lastReadbackSlot = slot;
+}
+
+void HelloTriangleApplication::flushReadbacks()
+{
+    // Oldest frame first, so callbacks keep seeing frames in submission order.
+    for (size_t i = 0; i < maxFramesInFlight; i++)
+    {
+        deliverReadback((currentFrame + i) % maxFramesInFlight);
+    }
+}
 
-    vkQueueWaitIdle(presentQueue);
+void HelloTriangleApplication::writeFrameToPpm(const std::string &path, size_t slot)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open frame dump file!");
+    }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    file << "P6\n" << swapChainExtent.width << " " << swapChainExtent.height << "\n255\n";
+    const uint8_t *pixels = static_cast<const uint8_t *>(readbackBuffers[slot]->mapped);
+    size_t pixelCount = static_cast<size_t>(swapChainExtent.width) * swapChainExtent.height;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        file.write(reinterpret_cast<const char *>(&pixels[i * 4]), 3);
+    }
 }
 
 void HelloTriangleApplication::cleanupSwapChain()
@@ -992,8 +2725,6 @@ void HelloTriangleApplication::cleanupSwapChain()
         vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
     }
 
-    vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
@@ -1003,25 +2734,72 @@ void HelloTriangleApplication::cleanupSwapChain()
         vkDestroyImageView(device, swapChainImageViews[i], nullptr);
     }
 
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
+    if (settings.headless)
+    {
+        destroyOffscreenTargets();
+    }
+    else
+    {
+        vkDestroySwapchainKHR(device, swapChain, nullptr);
+    }
 }
 
 void HelloTriangleApplication::cleanup()
 {
+    PROFILE_FUNCTION();
+    shaderWatcher.reset();
+    if (pendingShaderReload.valid())
+    {
+        applyShaderReload(pendingShaderReload.get(), false);
+    }
+    flushDeletions();
+    textureLoader.reset();
     cleanupSwapChain();
 
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    for (DeviceMemoryAllocator::Allocation *instanceBuffer : instanceBuffers)
+    {
+        memoryAllocator->destroyBuffer(instanceBuffer);
+    }
+    gpuCuller.reset();
+    if (uniformRing)
+    {
+        vkDestroyDescriptorPool(device, uniformDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, uniformSetLayout, nullptr);
+        uniformRing.reset();
+    }
+    if (objectBuffer)
+    {
+        memoryAllocator->destroyBuffer(objectBuffer);
+    }
+    memoryAllocator->destroyBuffer(indexBuffer);
+    memoryAllocator->destroyBuffer(vertexBuffer);
+    stagingUploader.reset();
+    postProcessor.reset();
+    compositeGraph.reset();
+    computeGraph.reset();
+    renderGraph.reset();
+    for (VkSemaphore sceneReadySemaphore : sceneReadySemaphores)
+    {
+        vkDestroySemaphore(device, sceneReadySemaphore, nullptr);
+    }
+    vkDestroySemaphore(device, postProcessSemaphore, nullptr);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < maxFramesInFlight; i++)
     {
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
 
-    vkDestroyCommandPool(device, commandPool, nullptr);
+    gpuProfiler.reset();
+    workerCommandAllocators.clear();
+    jobSystem.reset();
+    computeCommandAllocator.reset();
+    commandAllocator.reset();
 
+    pipelineCache->save();
+    pipelineCache.reset();
+    memoryAllocator.reset();
     vkDestroyDevice(device, nullptr);
 
     if (enableValidationLayers)
@@ -1029,31 +2807,45 @@ void HelloTriangleApplication::cleanup()
         DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (!settings.headless)
+    {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
+    if (!settings.headless)
+    {
+        glfwDestroyWindow(window);
 
-    glfwTerminate();
+        glfwTerminate();
+    }
 }
 
-std::vector<char> HelloTriangleApplication::readFile(const std::string &filename)
+void HelloTriangleApplication::setFrameReadbackCallback(FrameReadbackCallback callback)
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open())
-    {
-        throw std::runtime_error("failed to open file!");
-    }
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-
-    return buffer;
+    frameReadbackCallback = std::move(callback);
 }
 
-HelloTriangleApplication::HelloTriangleApplication(uint32_t width, uint32_t height) : Width(width), Height(height)
+HelloTriangleApplication::HelloTriangleApplication(uint32_t width, uint32_t height,
+                                                   const ApplicationSettings &settings)
+    : Width(width), Height(height), settings(settings), maxFramesInFlight(settings.framesInFlight)
 {
+    if (maxFramesInFlight < 1 || maxFramesInFlight > ApplicationSettings::maxFramesInFlightLimit)
+    {
+        throw std::runtime_error("frames in flight must be between 1 and 4!");
+    }
+    if (settings.gpuCulling && settings.instanceCount > 0)
+    {
+        // Culled draws identify their object through the instance index.
+        throw std::runtime_error("GPU culling can not be combined with instancing!");
+    }
+    if (settings.objectUniforms && (settings.gpuCulling || settings.instanceCount > 0))
+    {
+        // Both bring their own per-object data and pipeline layout.
+        throw std::runtime_error("object uniforms can not be combined with GPU culling or instancing!");
+    }
+    if (!settings.headless)
+    {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 }
\ No newline at end of file
@@ -2,21 +2,46 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
+#include "ApplicationSettings.h"
+#include "AssetPack.h"
+#include "CpuProfiler.h"
+#include "DeviceMemoryAllocator.h"
+#include "DeviceSelector.h"
+#include "FileWatcher.h"
+#include "FrameCommandAllocator.h"
+#include "GpuCuller.h"
+#include "GpuProfiler.h"
+#include "InstanceData.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "PipelineCache.h"
+#include "PostProcessor.h"
+#include "RenderGraph.h"
+#include "ShaderManifest.h"
+#include "StagingUploader.h"
+#include "StartupScheduler.h"
+#include "TextureLoader.h"
+#include "UniformRing.h"
 #include "Vertex.h"
 #include <algorithm> // Necessary for std::min/std::max
+#include <chrono>
 #include <cstdint>   // Necessary for UINT32_MAX
 #include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <nameof.hpp>
 #include <optional>
 #include <set>
+#include <span>
 #include <stb.h>
 #include <stdexcept>
 #include <vector>
@@ -34,24 +59,135 @@
 class HelloTriangleApplication
 {
   public:
-    HelloTriangleApplication(uint32_t width, uint32_t height);
+    using FrameReadbackCallback =
+        std::function<void(const uint8_t *pixels, VkExtent2D extent, uint64_t frameNumber)>;
+
+    HelloTriangleApplication(uint32_t width, uint32_t height, const ApplicationSettings &settings = {});
 
     void run();
 
+    // Headless only: called with the RGBA8 pixels of every frame once the GPU has finished writing them.
+    void setFrameReadbackCallback(FrameReadbackCallback callback);
+
+    struct RunStatistics
+    {
+        // CPU time of every frame of the main loop, from the start of one frame to the start of the next.
+        std::vector<double> frameMilliseconds;
+        double averageRecordingMilliseconds = 0.0;
+        // GPU profiling only: the last frames' GPU times and the average time of every GPU zone.
+        std::vector<double> gpuFrameMilliseconds;
+        std::map<std::string, double> gpuZoneMilliseconds;
+        // GPU profiling with pipeline statistics only: average vertex shader invocations of every zone counting them.
+        std::map<std::string, uint64_t> gpuZoneVertexInvocations;
+        // GPU culling only: objects outside the frustum per frame, averaged over the frames read back.
+        double averageCulledObjects = 0.0;
+        // Size of the vertex buffer in settings.vertexFormat.
+        uint64_t vertexBufferBytes = 0;
+        // Live vkAllocateMemory allocations when the main loop returned.
+        uint32_t deviceAllocationCount = 0;
+        uint32_t graphicsPipelineCreations = 0;
+        uint32_t swapChainRecreations = 0;
+    };
+
+    // Filled in when the main loop returns, valid after run().
+    const RunStatistics &getStatistics() const;
+
   private:
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer vertexBuffer;
-    const std::vector<Vertex> vertices = {
-        {{0.0f, -0.5f}, {1.0f, 1.0f, 1.0f}}, {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}}, {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
+    // Every shader is read from here, mapped once at startup.
+    std::unique_ptr<AssetPack> assets;
+    std::unique_ptr<ShaderManifest> shaderManifest;
+    std::unique_ptr<DeviceMemoryAllocator> memoryAllocator;
+    // Rebuilt every frame in recordCommandBuffer, orders the passes of the frame.
+    std::unique_ptr<RenderGraph> renderGraph;
+    std::unique_ptr<StagingUploader> stagingUploader;
+    std::unique_ptr<PipelineCache> pipelineCache;
+    std::unique_ptr<FrameCommandAllocator> commandAllocator;
+    // Only created when draws are recorded into secondary command buffers, with one allocator per worker.
+    std::unique_ptr<JobSystem> jobSystem;
+    std::vector<std::unique_ptr<FrameCommandAllocator>> workerCommandAllocators;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
+    std::chrono::duration<double> recordingTime{0};
+    RunStatistics statistics;
+    uint32_t graphicsPipelineCreations = 0;
+    // Shader hot reload, only when settings.shaderWatchPath is set. A reload compiles and builds the new pipeline on
+    // a worker thread, the render loop swaps it in once it is ready.
+    struct ShaderReload
+    {
+        std::map<std::string, std::vector<uint8_t>> shaders;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::string error;
+        std::chrono::duration<double> duration{0};
+    };
+    std::unique_ptr<FileWatcher> shaderWatcher;
+    std::future<ShaderReload> pendingShaderReload;
+    // Replace the pack's asset of the same name.
+    std::map<std::string, std::vector<uint8_t>> reloadedShaders;
+    // Timeline value of the upload batch the recorded frames depend on.
+    uint64_t uploadsReadyValue = 0;
+    std::vector<DeviceMemoryAllocator::Allocation *> offscreenImageAllocations;
+    std::vector<DeviceMemoryAllocator::Allocation *> readbackBuffers;
+    std::vector<std::optional<uint64_t>> pendingReadbacks;
+    std::optional<size_t> lastReadbackSlot;
+    FrameReadbackCallback frameReadbackCallback;
+    uint64_t frameNumber = 0;
+    DeviceMemoryAllocator::Allocation *vertexBuffer = nullptr;
+    DeviceMemoryAllocator::Allocation *indexBuffer = nullptr;
+    VkIndexType indexType;
+    Mesh mesh;
+    std::vector<VkDrawIndexedIndirectCommand> drawList;
+    // GPU culling only: one object per draw list entry.
+    std::unique_ptr<GpuCuller> gpuCuller;
+    DeviceMemoryAllocator::Allocation *objectBuffer = nullptr;
+    bool drawIndirectCountSupported = false;
+    uint64_t culledObjects = 0;
+    uint64_t culledFrames = 0;
+    // GPU profiling only.
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    bool pipelineStatisticsQuerySupported = false;
+    bool inheritedQueriesSupported = false;
+    // Updated at the start of every recorded frame, see updateCamera.
+    glm::mat4 viewProjection{1.0f};
+    // Instancing only: rewritten on the CPU every frame and copied into that frame in flight's buffer.
+    std::vector<InstanceData> instances;
+    std::vector<DeviceMemoryAllocator::Allocation *> instanceBuffers;
+    // Object uniforms only: one set with two dynamic uniform buffer bindings into the ring, the frame's uniforms and
+    // the draw's. The offsets are those of the frame being recorded.
+    std::unique_ptr<UniformRing> uniformRing;
+    VkDescriptorSetLayout uniformSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool uniformDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet uniformDescriptorSet = VK_NULL_HANDLE;
+    uint32_t frameUniformOffset = 0;
+    std::vector<uint32_t> objectUniformOffsets;
+    // Only when settings.textureDirectory is set. Uploads are recorded at the start of every frame until none are
+    // pending.
+    std::unique_ptr<TextureLoader> textureLoader;
+    std::vector<TextureLoader::Handle> textures;
+    std::chrono::steady_clock::time_point textureLoadStart;
+    // Post-processing only. The main pass renders into the post processor's scene colour image, the compute passes
+    // write its output and the output is copied into the swap chain or offscreen image.
+    std::unique_ptr<PostProcessor> postProcessor;
+    uint64_t postProcessedFrames = 0;
+    // Async compute only: a frame's post-processing is recorded from computeGraph and submitted to computeQueue once
+    // its scene is rendered, the next frame copies the output out with compositeGraph. postProcessSemaphore is a
+    // timeline that reaches n + 1 when frame n is post-processed, sceneReadySemaphores hand the scene colour over.
+    std::unique_ptr<RenderGraph> computeGraph;
+    std::unique_ptr<RenderGraph> compositeGraph;
+    std::unique_ptr<FrameCommandAllocator> computeCommandAllocator;
+    VkSemaphore postProcessSemaphore = VK_NULL_HANDLE;
+    std::vector<VkSemaphore> sceneReadySemaphores;
+    // The output the next frame copies out and the timeline value it is ready at, none on the first frame and after
+    // a resize.
+    VkImage pendingPostOutput = VK_NULL_HANDLE;
+    uint64_t pendingPostValue = 0;
     bool framebufferResized = false;
+    uint64_t submittedFrames = 0;
+    // Destructors for resources retired while frames may still use them, keyed by submittedFrames at retirement.
+    std::deque<std::pair<uint64_t, std::function<void()>>> deletionQueue;
     std::vector<VkFence> inFlightFences;
     std::vector<VkFence> imagesInFlight;
     size_t currentFrame = 0;
-    const int MAX_FRAMES_IN_FLIGHT = 2;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkCommandBuffer> commandBuffers;
-    VkCommandPool commandPool;
     std::vector<VkFramebuffer> swapChainFramebuffers;
     VkPipeline graphicsPipeline;
     VkRenderPass renderPass;
@@ -64,18 +200,31 @@ class HelloTriangleApplication
     VkQueue presentQueue;
     VkSurfaceKHR surface;
     VkQueue graphicsQueue;
+    VkQueue transferQueue;
+    // Async compute only, VK_NULL_HANDLE when post-processing runs on the graphics queue.
+    VkQueue computeQueue = VK_NULL_HANDLE;
     VkDevice device;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    // What physicalDevice supports, from the device cache or probed by pickPhysicalDevice.
+    DeviceSelector::Capabilities deviceCapabilities;
     GLFWwindow *window;
     const uint32_t Width;
     const uint32_t Height;
+    const ApplicationSettings settings;
+    const size_t maxFramesInFlight;
     VkInstance instance;
     const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-    const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char *> deviceExtensions;
     VkDebugUtilsMessengerEXT debugMessenger;
 
     void recreateSwapChain();
 
+    void deferDeletion(std::function<void()> deletion);
+
+    void collectDeletions();
+
+    void flushDeletions();
+
     bool checkValidationLayerSupport();
 
     void createInstance();
@@ -91,29 +240,92 @@ class HelloTriangleApplication
 
     std::vector<const char *> getRequiredExtensions();
 
+    // Creates everything up to the first frame, including the window, as steps of a StartupScheduler.
     void initVulkan();
 
+    void loadMesh();
+
+    DeviceMemoryAllocator::Allocation *createDeviceLocalBuffer(VkBufferUsageFlags usage, const void *data,
+                                                               VkDeviceSize size);
+
     void createVertexBuffer();
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    void createIndexBuffer();
+
+    void createGpuCuller();
+
+    void createInstanceBuffers();
+
+    void updateInstances();
+
+    void createUniformRing();
+
+    void updateObjectUniforms();
+
+    void updateCamera();
+
+    void collectCullingStatistics(size_t slot);
+
+    void loadTextures();
+
+    void createPostProcessor();
 
     void createSyncObjects();
 
-    void createCommandBuffers();
+    VkCommandBuffer recordCommandBuffer(uint32_t imageIndex);
+
+    void recordDraws(VkCommandBuffer commandBuffer, size_t firstDraw, size_t drawCount);
+
+    // The swap chain or offscreen image the frame ends up in, as the first access after acquiring it sees it.
+    RenderGraph::Resource importTarget(RenderGraph &graph, uint32_t imageIndex);
+    void addCopyPass(RenderGraph &graph, RenderGraph::Resource output, VkImage outputImage,
+                     RenderGraph::Resource target, uint32_t imageIndex, GpuProfiler *profiler);
+    void addReadbackPass(RenderGraph &graph, RenderGraph::Resource target, uint32_t imageIndex, GpuProfiler *profiler);
 
-    void createCommandPool();
+    // Async compute only.
+    VkCommandBuffer recordPostProcessing();
+    VkCommandBuffer recordComposite(uint32_t imageIndex);
+    // Submits the frame's scene and, unless compositeCommandBuffer is null, the copy of the previous frame's output to
+    // the graphics queue, then the frame's post-processing to the compute queue. The semaphores may be null headless.
+    void submitWithAsyncCompute(VkCommandBuffer commandBuffer, VkCommandBuffer compositeCommandBuffer,
+                                VkSemaphore imageAvailableSemaphore, VkSemaphore renderFinishedSemaphore);
+    // Blocks until postProcessSemaphore reaches value, returns right away without async compute.
+    void waitForPostProcessing(uint64_t value);
+
+    void createCommandAllocator();
 
     void createFramebuffers();
 
     void createGraphicsPipeline();
+    // Only reads state that is fixed after startup or changed with the worker finished, safe on a worker thread.
+    VkPipeline buildGraphicsPipeline(std::span<const uint8_t> vertShaderCode,
+                                     std::span<const uint8_t> fragShaderCode) const;
+    std::string getVertexShaderName() const;
+    std::span<const uint8_t> getShaderCode(const std::string &name) const;
+
+    void updateShaderReload();
+    ShaderReload reloadShaders(const std::vector<std::string> &changes, const std::string &vertShaderName,
+                               std::vector<uint8_t> vertShaderCode, std::vector<uint8_t> fragShaderCode) const;
+    void applyShaderReload(ShaderReload reload, bool swapPipeline);
 
     void createRenderPass();
 
-    VkShaderModule createShaderModule(const std::vector<char> &code);
+    VkShaderModule createShaderModule(std::span<const uint8_t> code) const;
 
     void createImageViews();
 
-    void createSwapChain();
+    // Leaves swapChainImageFormat to the caller, startup sets it before the swap chain exists.
+    void createSwapChain(VkSurfaceFormatKHR surfaceFormat, VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+
+    void createOffscreenTargets(VkExtent2D extent);
+
+    void destroyOffscreenTargets();
+
+    // Headless counterpart of recreateSwapChain, waits for the frames in flight to deliver their readbacks first.
+    void resizeOffscreenTargets(VkExtent2D extent);
+
+    // Follows swapChainExtent, after the swap chain or the offscreen targets were recreated.
+    void resizePostProcessor();
 
     void createSurface();
 
@@ -121,9 +333,8 @@ class HelloTriangleApplication
 
     void pickPhysicalDevice();
 
-    bool isDeviceSuitable(VkPhysicalDevice device);
-
-    bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    // The checks DeviceSelector can not cache: queue families and swap chain support for the window surface.
+    bool isDeviceSuitable(VkPhysicalDevice device, const DeviceSelector::Capabilities &capabilities);
 
     struct SwapChainSupportDetails
     {
@@ -136,11 +347,19 @@ class HelloTriangleApplication
     {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // A transfer-only family, typically backed by a DMA engine. Optional, uploads fall back to the graphics queue.
+        std::optional<uint32_t> transferFamily;
+        // A compute family without graphics, or else the graphics family if it has a second queue. Optional, the
+        // post-processing falls back to the graphics queue.
+        std::optional<uint32_t> computeFamily;
+        uint32_t computeQueueIndex = 0;
 
         bool isComplete();
     };
 
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+    // queueFamilies are the device's, as cached by DeviceSelector. Only present support is queried.
+    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
+                                         const std::vector<VkQueueFamilyProperties> &queueFamilies);
 
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
@@ -150,17 +369,33 @@ class HelloTriangleApplication
 
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
+    // Main thread only, after glfwInit.
     void initWindow();
 
     static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+    // Profiler builds only: F12 writes the CPU trace so far.
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
     void mainLoop();
 
     void drawFrame();
 
+    void drawOffscreenFrame();
+
+    void deliverReadback(size_t slot);
+
+    void flushReadbacks();
+
+    void printRecordingStatistics();
+    void printGpuStatistics();
+    void printRenderGraphStatistics();
+    void collectStatistics();
+    void writeCpuTrace();
+    void printMemoryStatistics();
+
+    void writeFrameToPpm(const std::string &path, size_t slot);
+
     void cleanupSwapChain();
 
     void cleanup();
-
-    static std::vector<char> readFile(const std::string &filename);
 };
\ No newline at end of file
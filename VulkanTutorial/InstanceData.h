@@ -0,0 +1,38 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+#include <array>
+// Per-instance attributes, streamed to the GPU every frame as a tightly packed array.
+struct InstanceData
+{
+    glm::vec2 offset;
+    float scale;
+    float rotation;
+    glm::vec3 color;
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescription;
+    }
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+    {
+        // Locations continue after Vertex's. offset, scale and rotation are read as one vec4.
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        attributeDescriptions[0].binding = 1;
+        attributeDescriptions[0].location = 2;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(InstanceData, offset);
+
+        attributeDescriptions[1].binding = 1;
+        attributeDescriptions[1].location = 3;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(InstanceData, color);
+
+        return attributeDescriptions;
+    }
+};
\ No newline at end of file
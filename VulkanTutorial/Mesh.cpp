@@ -0,0 +1,72 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+VkIndexType Mesh::getIndexType() const
+{
+    return vertices.size() <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::vector<uint8_t> Mesh::getIndexData() const
+{
+    if (getIndexType() == VK_INDEX_TYPE_UINT32)
+    {
+        std::vector<uint8_t> data(indices.size() * sizeof(uint32_t));
+        memcpy(data.data(), indices.data(), data.size());
+        return data;
+    }
+
+    std::vector<uint8_t> data(indices.size() * sizeof(uint16_t));
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        uint16_t index = static_cast<uint16_t>(indices[i]);
+        memcpy(&data[i * sizeof(uint16_t)], &index, sizeof(uint16_t));
+    }
+    return data;
+}
+
+Mesh Mesh::createTriangle()
+{
+    Mesh mesh;
+    mesh.vertices = {
+        {{0.0f, -0.5f}, {1.0f, 1.0f, 1.0f}}, {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}}, {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
+    mesh.indices = {0, 1, 2};
+    return mesh;
+}
+
+Mesh Mesh::createGrid(uint32_t size)
+{
+    auto gridVertex = [size](uint32_t x, uint32_t y) {
+        float u = static_cast<float>(x) / size;
+        float v = static_cast<float>(y) / size;
+        return Vertex{{u * 1.8f - 0.9f, v * 1.8f - 0.9f}, {u, v, 1.0f - u}};
+    };
+
+    std::vector<std::array<Vertex, 3>> triangles;
+    triangles.reserve(static_cast<size_t>(size) * size * 2);
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            triangles.push_back({gridVertex(x, y), gridVertex(x + 1, y), gridVertex(x + 1, y + 1)});
+            triangles.push_back({gridVertex(x + 1, y + 1), gridVertex(x, y + 1), gridVertex(x, y)});
+        }
+    }
+    // Fixed seed so every run benchmarks the same input.
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1234));
+
+    Mesh mesh;
+    mesh.vertices.reserve(triangles.size() * 3);
+    mesh.indices.reserve(triangles.size() * 3);
+    for (const auto &triangle : triangles)
+    {
+        for (const Vertex &vertex : triangle)
+        {
+            mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    return mesh;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include "Vertex.h"
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+struct Mesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // 16-bit indices halve index fetch bandwidth, 0xFFFF stays free so primitive restart can never be triggered.
+    VkIndexType getIndexType() const;
+    // The indices packed to getIndexType(), ready to be copied into an index buffer.
+    std::vector<uint8_t> getIndexData() const;
+
+    static Mesh createTriangle();
+    // A size x size grid of quads emitted as an unindexed triangle list in shuffled order, the worst case input for
+    // the vertex cache and a stand-in for meshes straight out of an exporter.
+    static Mesh createGrid(uint32_t size);
+};
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+// Scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+constexpr uint32_t maxCacheSize = 32;
+constexpr float cacheDecayPower = 1.5f;
+constexpr float lastTriangleScore = 0.75f;
+constexpr float valenceBoostScale = 2.0f;
+constexpr float valenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+        {
+            // The vertices of the triangle that was just emitted, deliberately not the highest score so the
+            // optimiser does not keep walking a strip.
+            score = lastTriangleScore;
+        }
+        else
+        {
+            float scaler = 1.0f / (maxCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+        }
+    }
+    // Vertices with few triangles left are worth finishing off so they leave the working set.
+    score += valenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -valenceBoostPower);
+    return score;
+}
+
+struct VertexHash
+{
+    size_t operator()(const Vertex &vertex) const
+    {
+        // FNV-1a over the raw bytes, Vertex is made of floats only and has no padding.
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&vertex);
+        size_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(Vertex); i++)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+struct VertexEqual
+{
+    bool operator()(const Vertex &a, const Vertex &b) const
+    {
+        return memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+} // namespace
+
+void MeshOptimizer::deduplicateVertices(Mesh &mesh)
+{
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+    uniqueVertices.reserve(mesh.vertices.size());
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t &index : mesh.indices)
+    {
+        auto [it, inserted] = uniqueVertices.emplace(mesh.vertices[index], static_cast<uint32_t>(vertices.size()));
+        if (inserted)
+        {
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = it->second;
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Per vertex adjacency lists packed into one array. The first remainingTriangles[v] entries of a vertex's range
+    // are the triangles that still have to be emitted.
+    std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        remainingTriangles[index]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(maxCacheSize + 3);
+    newCache.reserve(maxCacheSize + 3);
+
+    int64_t bestTriangle = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (bestTriangle < 0)
+        {
+            // Nothing in the cache has triangles left, start over at the best triangle anywhere.
+            float bestScore = -1.0f;
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                if (!emitted[t] && triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = static_cast<int64_t>(t);
+                }
+            }
+        }
+
+        const uint32_t *triangle = &indices[bestTriangle * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[bestTriangle] = true;
+
+        newCache.assign(triangle, triangle + 3);
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint32_t vertex = triangle[corner];
+            uint32_t *begin = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t *end = begin + remainingTriangles[vertex];
+            std::iter_swap(std::find(begin, end, static_cast<uint32_t>(bestTriangle)), end - 1);
+            remainingTriangles[vertex]--;
+        }
+        for (uint32_t vertex : cache)
+        {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+            {
+                newCache.push_back(vertex);
+            }
+        }
+
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            uint32_t vertex = newCache[i];
+            cachePositions[vertex] = i < maxCacheSize ? static_cast<int>(i) : -1;
+            vertexScores[vertex] = vertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+        }
+
+        // Only triangles touching the cache changed score, the best of them is the next one to emit.
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : newCache)
+        {
+            for (uint32_t i = 0; i < remainingTriangles[vertex]; i++)
+            {
+                uint32_t t = adjacency[adjacencyOffsets[vertex] + i];
+                float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                              vertexScores[indices[t * 3 + 2]];
+                triangleScores[t] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        newCache.resize(std::min<size_t>(newCache.size(), maxCacheSize));
+        std::swap(cache, newCache);
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // A triangle whose three vertices all miss the cache costs the same wherever it goes, so those are the points
+    // where the triangle order can be cut without hurting the cache (Sander et al., "Fast Triangle Reordering").
+    const uint32_t cacheSize = 16;
+    std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+    uint32_t timestamp = cacheSize + 1;
+    std::vector<size_t> clusterStarts;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint32_t vertex = indices[t * 3 + corner];
+            if (timestamp - cacheTimestamps[vertex] > cacheSize)
+            {
+                cacheTimestamps[vertex] = timestamp++;
+                misses++;
+            }
+        }
+        if (misses == 3 || t == 0)
+        {
+            clusterStarts.push_back(t);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    auto position = [&vertices](uint32_t index) { return glm::vec3(vertices[index].pos, 0.0f); };
+
+    glm::vec3 meshCentroid(0.0f);
+    for (uint32_t index : indices)
+    {
+        meshCentroid = meshCentroid + position(index);
+    }
+    meshCentroid = meshCentroid / static_cast<float>(indices.size());
+
+    struct Cluster
+    {
+        size_t begin;
+        size_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    for (size_t c = 0; c + 1 < clusterStarts.size(); c++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            glm::vec3 p0 = position(indices[t * 3]);
+            glm::vec3 p1 = position(indices[t * 3 + 1]);
+            glm::vec3 p2 = position(indices[t * 3 + 2]);
+            glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(areaNormal);
+            centroid = centroid + (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal = normal + areaNormal;
+            area += triangleArea;
+        }
+        float sortKey = 0.0f;
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+        {
+            // Clusters far out along their own normal are likely to occlude the rest of the mesh.
+            sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+        }
+        clusters.push_back({clusterStarts[c], clusterStarts[c + 1], sortKey});
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster &cluster : clusters)
+    {
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(Mesh &mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t &index : mesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    // Vertices no triangle references are dropped on the way.
+    mesh.vertices = std::move(vertices);
+}
+
+void MeshOptimizer::optimize(Mesh &mesh)
+{
+    deduplicateVertices(mesh);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh);
+}
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                                                       size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStatistics statistics;
+    if (indices.empty())
+    {
+        return statistics;
+    }
+
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+    for (uint32_t index : indices)
+    {
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            statistics.transformedVertices++;
+        }
+    }
+
+    statistics.acmr = static_cast<float>(statistics.transformedVertices) / (indices.size() / 3);
+    statistics.atvr = static_cast<float>(statistics.transformedVertices) / vertexCount;
+    return statistics;
+}
\ No newline at end of file
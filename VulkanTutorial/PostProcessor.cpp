@@ -0,0 +1,389 @@
+#include "PostProcessor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+// Must match local_size_x and local_size_y of the post-processing shaders.
+constexpr uint32_t workgroupSize = 8;
+constexpr float exposure = 1.0f;
+constexpr float bloomStrength = 0.35f;
+// Four sets per frame, downsample, two blurs and tonemap, each with the samplers and the storage image of the layout.
+constexpr uint32_t setsPerFrame = 4;
+} // namespace
+
+PostProcessor::PostProcessor(VkDevice device, DeviceMemoryAllocator &allocator, VkPipelineCache pipelineCache,
+                             const AssetPack &assets, std::vector<uint32_t> queueFamilyIndices, uint32_t frameCount,
+                             VkExtent2D extent, std::function<void(std::function<void()>)> retire)
+    : device(device), allocator(allocator), queueFamilyIndices(std::move(queueFamilyIndices)),
+      frameCount(frameCount), extent(extent), retire(std::move(retire))
+{
+    std::sort(this->queueFamilyIndices.begin(), this->queueFamilyIndices.end());
+    this->queueFamilyIndices.erase(std::unique(this->queueFamilyIndices.begin(), this->queueFamilyIndices.end()),
+                                   this->queueFamilyIndices.end());
+
+    createImages();
+    createDescriptors();
+    createPipelines(pipelineCache, assets);
+}
+
+PostProcessor::~PostProcessor()
+{
+    vkDestroyPipeline(device, tonemapPipeline, nullptr);
+    vkDestroyPipeline(device, blurPipeline, nullptr);
+    vkDestroyPipeline(device, downsamplePipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    for (VkDescriptorPool descriptorPool : descriptorPools)
+    {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    }
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    for (std::vector<Image> *images : {&sceneColors, &outputs})
+    {
+        for (Image &image : *images)
+        {
+            vkDestroyImageView(device, image.view, nullptr);
+            allocator.destroyImage(image.image, image.allocation);
+        }
+    }
+}
+
+void PostProcessor::resize(VkExtent2D newExtent)
+{
+    std::vector<Image> oldImages = std::move(sceneColors);
+    oldImages.insert(oldImages.end(), outputs.begin(), outputs.end());
+    outputs.clear();
+    retire([this, oldImages]() {
+        for (const Image &image : oldImages)
+        {
+            vkDestroyImageView(device, image.view, nullptr);
+            allocator.destroyImage(image.image, image.allocation);
+        }
+    });
+
+    extent = newExtent;
+    createImages();
+}
+
+uint32_t PostProcessor::getFrameCount() const
+{
+    return frameCount;
+}
+
+VkImageView PostProcessor::getSceneColorView(uint32_t index) const
+{
+    return sceneColors[index].view;
+}
+
+void PostProcessor::beginFrame(uint64_t frame)
+{
+    frameIndex = static_cast<uint32_t>(frame % frameCount);
+    outputIndex = static_cast<uint32_t>(frame % outputCount);
+    vkResetDescriptorPool(device, descriptorPools[frameIndex], 0);
+}
+
+uint32_t PostProcessor::getFrameIndex() const
+{
+    return frameIndex;
+}
+
+VkImage PostProcessor::getSceneColorImage() const
+{
+    return sceneColors[frameIndex].image;
+}
+
+VkImage PostProcessor::getOutputImage() const
+{
+    return outputs[outputIndex].image;
+}
+
+void PostProcessor::addPasses(RenderGraph &graph, RenderGraph::Resource sceneColor, RenderGraph::Resource output,
+                              bool encodeSrgb, GpuProfiler *profiler)
+{
+    // The bloom chain runs at half resolution. The blurred image can take the memory of the downsampled one, which
+    // is dead by then.
+    VkExtent2D halfExtent = {std::max(1u, (extent.width + 1) / 2), std::max(1u, (extent.height + 1) / 2)};
+    RenderGraph::ImageDescription bloomDescription;
+    bloomDescription.format = outputFormat;
+    bloomDescription.extent = halfExtent;
+    bloomDescription.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    RenderGraph::Resource downsampled = graph.createImage("downsampled", bloomDescription);
+    RenderGraph::Resource blurredHorizontally = graph.createImage("blurred horizontally", bloomDescription);
+    RenderGraph::Resource bloom = graph.createImage("bloom", bloomDescription);
+
+    constexpr VkPipelineStageFlags stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkImageView sceneColorView = sceneColors[frameIndex].view;
+    VkImageView outputView = outputs[outputIndex].view;
+
+    graph
+        .addPass("downsample",
+                 [this, &graph, profiler, sceneColorView, downsampled, halfExtent](VkCommandBuffer commandBuffer) {
+                     GpuProfiler::Zone zone(profiler, commandBuffer, "downsample");
+                     VkDescriptorSet descriptorSet =
+                         allocateDescriptorSet(sceneColorView, graph.getImageView(downsampled));
+                     dispatch(commandBuffer, downsamplePipeline, descriptorSet, {}, halfExtent);
+                 })
+        .read(sceneColor, stage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+        .write(downsampled, stage, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+
+    // Two passes of the same shader, one texel apart along x and then along y.
+    auto addBlur = [&](const char *name, RenderGraph::Resource input, RenderGraph::Resource blurred, float x,
+                       float y) {
+        PushConstants pushConstants{};
+        pushConstants.direction[0] = x / static_cast<float>(halfExtent.width);
+        pushConstants.direction[1] = y / static_cast<float>(halfExtent.height);
+        graph
+            .addPass(name,
+                     [this, &graph, profiler, name, input, blurred, pushConstants,
+                      halfExtent](VkCommandBuffer commandBuffer) {
+                         GpuProfiler::Zone zone(profiler, commandBuffer, name);
+                         VkDescriptorSet descriptorSet =
+                             allocateDescriptorSet(graph.getImageView(input), graph.getImageView(blurred));
+                         dispatch(commandBuffer, blurPipeline, descriptorSet, pushConstants, halfExtent);
+                     })
+            .read(input, stage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+            .write(blurred, stage, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+    };
+    addBlur("blur horizontal", downsampled, blurredHorizontally, 1.0f, 0.0f);
+    addBlur("blur vertical", blurredHorizontally, bloom, 0.0f, 1.0f);
+
+    PushConstants tonemapConstants{};
+    tonemapConstants.exposure = exposure;
+    tonemapConstants.bloomStrength = bloomStrength;
+    tonemapConstants.encodeSrgb = encodeSrgb ? 1 : 0;
+    VkExtent2D fullExtent = extent;
+    graph
+        .addPass("tonemap",
+                 [this, &graph, profiler, sceneColorView, outputView, bloom, tonemapConstants,
+                  fullExtent](VkCommandBuffer commandBuffer) {
+                     GpuProfiler::Zone zone(profiler, commandBuffer, "tonemap");
+                     VkDescriptorSet descriptorSet =
+                         allocateDescriptorSet(sceneColorView, outputView, graph.getImageView(bloom));
+                     dispatch(commandBuffer, tonemapPipeline, descriptorSet, tonemapConstants, fullExtent);
+                 })
+        .read(sceneColor, stage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+        .read(bloom, stage, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+        .write(output, stage, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+}
+
+void PostProcessor::createImages()
+{
+    // Rendered to and sampled, possibly on different queues.
+    sceneColors.resize(frameCount);
+    for (Image &sceneColor : sceneColors)
+    {
+        sceneColor =
+            createImage(sceneColorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    }
+    // Written by the tonemap pass and copied into the presented or read back image.
+    outputs.resize(outputCount);
+    for (Image &output : outputs)
+    {
+        output = createImage(outputFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    }
+}
+
+PostProcessor::Image PostProcessor::createImage(VkFormat format, VkImageUsageFlags usage)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    // Concurrent sharing avoids ownership transfers between the graphics and the compute queue.
+    if (queueFamilyIndices.size() > 1)
+    {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+        imageInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    }
+    else
+    {
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    Image image;
+    image.allocation = allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &image.view) != VK_SUCCESS)
+    {
+        allocator.destroyImage(image.image, image.allocation);
+        throw std::runtime_error("failed to create post-processing image view!");
+    }
+    return image;
+}
+
+void PostProcessor::createDescriptors()
+{
+    // Clamped so the blur and the bilinear taps at the border do not wrap around.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create post-processing sampler!");
+    }
+
+    // Every pass uses the same layout: the input, the output and, for the tonemap pass, the bloom.
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = &sampler;
+    }
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    // One pool per frame, reset by beginFrame once the GPU is done with the frame's previous sets.
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = 2 * setsPerFrame;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = setsPerFrame;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = setsPerFrame;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    descriptorPools.resize(frameCount);
+    for (VkDescriptorPool &descriptorPool : descriptorPools)
+    {
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+    }
+}
+
+void PostProcessor::createPipelines(VkPipelineCache pipelineCache, const AssetPack &assets)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create post-processing pipeline layout!");
+    }
+
+    downsamplePipeline = createPipeline(pipelineCache, assets.get(downsampleShaderName));
+    blurPipeline = createPipeline(pipelineCache, assets.get(blurShaderName));
+    tonemapPipeline = createPipeline(pipelineCache, assets.get(tonemapShaderName));
+}
+
+VkPipeline PostProcessor::createPipeline(VkPipelineCache pipelineCache, std::span<const uint8_t> shaderCode)
+{
+    VkShaderModuleCreateInfo shaderInfo{};
+    shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderInfo.codeSize = shaderCode.size();
+    shaderInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &shaderInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create shader module!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create post-processing pipeline!");
+    }
+    return pipeline;
+}
+
+VkDescriptorSet PostProcessor::allocateDescriptorSet(VkImageView input, VkImageView output, VkImageView bloom)
+{
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPools[frameIndex];
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate descriptor set!");
+    }
+
+    VkDescriptorImageInfo imageInfos[3]{};
+    imageInfos[0].imageView = input;
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[1].imageView = output;
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfos[2].imageView = bloom;
+    imageInfos[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet writes[3]{};
+    uint32_t writeCount = bloom != VK_NULL_HANDLE ? 3 : 2;
+    for (uint32_t i = 0; i < writeCount; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType =
+            i == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    vkUpdateDescriptorSets(device, writeCount, writes, 0, nullptr);
+    return descriptorSet;
+}
+
+void PostProcessor::dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet descriptorSet,
+                             const PushConstants &pushConstants, VkExtent2D dispatchExtent)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                       &pushConstants);
+    vkCmdDispatch(commandBuffer, (dispatchExtent.width + workgroupSize - 1) / workgroupSize,
+                  (dispatchExtent.height + workgroupSize - 1) / workgroupSize, 1);
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include "AssetPack.h"
+#include "DeviceMemoryAllocator.h"
+#include "GpuProfiler.h"
+#include "RenderGraph.h"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+// HDR post-processing as a chain of compute dispatches: the scene colour is downsampled to half resolution, blurred
+// horizontally and vertically into a bloom image, and tonemapped together with it into the output image. The passes
+// only use compute, so they can be recorded into a command buffer for a dedicated compute queue and run alongside the
+// next frame's rasterisation, or into the frame's graphics command buffer on devices with a single queue.
+class PostProcessor
+{
+  public:
+    // What the main pass renders into and the output is written as, both sampled with linear filtering.
+    static constexpr VkFormat sceneColorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static constexpr VkFormat outputFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    // Asset names of the compute shaders.
+    static constexpr const char *downsampleShaderName = "shaders/downsample.comp.spv";
+    static constexpr const char *blurShaderName = "shaders/blur.comp.spv";
+    static constexpr const char *tonemapShaderName = "shaders/tonemap.comp.spv";
+
+    // queueFamilyIndices are the families that render the scene colour, post-process it and copy the output; with
+    // more than one the images are shared concurrently. frameCount frames may be in flight at once, each with its own
+    // scene colour image and descriptor pool. retire is called with the destruction of images replaced by resize().
+    PostProcessor(VkDevice device, DeviceMemoryAllocator &allocator, VkPipelineCache pipelineCache,
+                  const AssetPack &assets, std::vector<uint32_t> queueFamilyIndices, uint32_t frameCount,
+                  VkExtent2D extent, std::function<void(std::function<void()>)> retire);
+    // The owner waits for the device to be idle first.
+    ~PostProcessor();
+
+    PostProcessor(const PostProcessor &) = delete;
+    PostProcessor &operator=(const PostProcessor &) = delete;
+
+    // Replaces the scene colour and output images, the caller makes sure no queue still uses the old ones once retire
+    // runs them down.
+    void resize(VkExtent2D extent);
+
+    uint32_t getFrameCount() const;
+    // For the framebuffers of the main pass, index is below getFrameCount().
+    VkImageView getSceneColorView(uint32_t index) const;
+
+    // frame counts up by one per post-processed frame and picks its scene colour image, descriptor pool and output.
+    // The GPU must be done with the post-processing of frame - getFrameCount(), whose descriptor pool is reset.
+    void beginFrame(uint64_t frame);
+    // Of the frame passed to beginFrame.
+    uint32_t getFrameIndex() const;
+    VkImage getSceneColorImage() const;
+    // Two outputs alternate, so the output of one frame can be copied out while the next frame's is written.
+    VkImage getOutputImage() const;
+
+    // Adds the post-processing passes of the current frame. sceneColor and output are its images imported into graph,
+    // the passes sample sceneColor in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and write all of output. With
+    // encodeSrgb the output is sRGB encoded, for copies into UNORM images. The profiler may be null.
+    void addPasses(RenderGraph &graph, RenderGraph::Resource sceneColor, RenderGraph::Resource output,
+                   bool encodeSrgb, GpuProfiler *profiler);
+
+  private:
+    // Mirrors the push constants of blur.comp and tonemap.comp.
+    struct PushConstants
+    {
+        float direction[2];
+        float exposure;
+        float bloomStrength;
+        uint32_t encodeSrgb;
+    };
+
+    struct Image
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        DeviceMemoryAllocator::Allocation *allocation = nullptr;
+    };
+
+    static constexpr uint32_t outputCount = 2;
+
+    VkDevice device;
+    DeviceMemoryAllocator &allocator;
+    std::vector<uint32_t> queueFamilyIndices;
+    uint32_t frameCount;
+    VkExtent2D extent;
+    std::function<void(std::function<void()>)> retire;
+    std::vector<Image> sceneColors;
+    std::vector<Image> outputs;
+    std::vector<VkDescriptorPool> descriptorPools;
+    uint32_t frameIndex = 0;
+    uint32_t outputIndex = 0;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline downsamplePipeline = VK_NULL_HANDLE;
+    VkPipeline blurPipeline = VK_NULL_HANDLE;
+    VkPipeline tonemapPipeline = VK_NULL_HANDLE;
+
+    void createImages();
+    Image createImage(VkFormat format, VkImageUsageFlags usage);
+    void createDescriptors();
+    void createPipelines(VkPipelineCache pipelineCache, const AssetPack &assets);
+    VkPipeline createPipeline(VkPipelineCache pipelineCache, std::span<const uint8_t> shaderCode);
+    // Allocates a set from the current frame's pool, bloom is only read by the tonemap pass.
+    VkDescriptorSet allocateDescriptorSet(VkImageView input, VkImageView output, VkImageView bloom = VK_NULL_HANDLE);
+    void dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet descriptorSet,
+                  const PushConstants &pushConstants, VkExtent2D dispatchExtent);
+};
\ No newline at end of file
@@ -0,0 +1,583 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+RenderGraph::Pass &RenderGraph::Pass::read(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access,
+                                           VkImageLayout layout)
+{
+    addUse(resource, {stages, access, layout}, true, false, false);
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::write(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access,
+                                            VkImageLayout layout, bool discard)
+{
+    addUse(resource, {stages, access, layout}, false, true, discard);
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::setSideEffects()
+{
+    sideEffects = true;
+    return *this;
+}
+
+void RenderGraph::Pass::addUse(Resource resource, const Access &access, bool read, bool write, bool discard)
+{
+    for (Use &use : uses)
+    {
+        if (use.resource != resource)
+        {
+            continue;
+        }
+        if (use.access.layout != access.layout)
+        {
+            throw std::runtime_error("pass " + name + " uses a resource in two layouts!");
+        }
+        use.access.stages |= access.stages;
+        use.access.access |= access.access;
+        use.discard = !use.read && !read && (use.discard || !use.write) && discard;
+        use.read = use.read || read;
+        use.write = use.write || write;
+        return;
+    }
+    uses.push_back({resource, access, read, write, discard});
+}
+
+RenderGraph::RenderGraph(VkDevice device, DeviceMemoryAllocator &allocator,
+                         std::function<void(std::function<void()>)> retire)
+    : device(device), allocator(allocator), retire(std::move(retire))
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    // The owner waits for the device to be idle before destroying the graph.
+    for (const TransientImage &transient : transients)
+    {
+        vkDestroyImageView(device, transient.view, nullptr);
+        vkDestroyImage(device, transient.image, nullptr);
+    }
+    for (const MemorySlot &slot : slots)
+    {
+        allocator.free(slot.allocation);
+    }
+}
+
+void RenderGraph::reset()
+{
+    resources.clear();
+    transientDescriptions.clear();
+    passes.clear();
+}
+
+RenderGraph::Resource RenderGraph::importImage(std::string name, VkImage image, VkImageAspectFlags aspect,
+                                               const Access &initial, std::optional<Access> final)
+{
+    ResourceInfo info;
+    info.name = std::move(name);
+    info.image = image;
+    info.aspect = aspect;
+    info.initial = initial;
+    info.final = final;
+    resources.push_back(std::move(info));
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(std::string name, VkBuffer buffer, const Access &initial,
+                                                std::optional<Access> final)
+{
+    ResourceInfo info;
+    info.name = std::move(name);
+    info.buffer = buffer;
+    info.initial = initial;
+    info.final = final;
+    resources.push_back(std::move(info));
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::createImage(std::string name, const ImageDescription &description)
+{
+    ResourceInfo info;
+    info.name = std::move(name);
+    info.aspect = description.aspect;
+    info.transientIndex = static_cast<uint32_t>(transientDescriptions.size());
+    transientDescriptions.push_back(description);
+    resources.push_back(std::move(info));
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Pass &RenderGraph::addPass(std::string name, std::function<void(VkCommandBuffer)> record)
+{
+    Pass &pass = passes.emplace_back();
+    pass.name = std::move(name);
+    pass.record = std::move(record);
+    return pass;
+}
+
+void RenderGraph::compile()
+{
+    statistics = {};
+    statistics.passCount = static_cast<uint32_t>(passes.size());
+    cullPasses();
+    allocateTransients();
+    planBarriers();
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        if (!livePasses[i])
+        {
+            continue;
+        }
+        recordBarriers(commandBuffer, passBarriers[i]);
+        passes[i].record(commandBuffer);
+    }
+    recordBarriers(commandBuffer, finalBarriers);
+}
+
+VkImage RenderGraph::getImage(Resource resource) const
+{
+    const ResourceInfo &info = resources.at(resource);
+    return info.transientIndex ? transients.at(*info.transientIndex).image : info.image;
+}
+
+VkImageView RenderGraph::getImageView(Resource resource) const
+{
+    const ResourceInfo &info = resources.at(resource);
+    return info.transientIndex ? transients.at(*info.transientIndex).view : VK_NULL_HANDLE;
+}
+
+VkBuffer RenderGraph::getBuffer(Resource resource) const
+{
+    return resources.at(resource).buffer;
+}
+
+const RenderGraph::Statistics &RenderGraph::getStatistics() const
+{
+    return statistics;
+}
+
+void RenderGraph::cullPasses()
+{
+    // Walking backwards from the outputs, a pass is needed if it writes something that is read later.
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+        needed[i] = resources[i].final.has_value();
+    }
+
+    livePasses.assign(passes.size(), false);
+    for (size_t i = passes.size(); i-- > 0;)
+    {
+        const Pass &pass = passes[i];
+        bool live = pass.sideEffects;
+        for (const Pass::Use &use : pass.uses)
+        {
+            live = live || (use.write && needed[use.resource]);
+        }
+        if (!live)
+        {
+            statistics.culledPassCount++;
+            continue;
+        }
+        livePasses[i] = true;
+
+        for (const Pass::Use &use : pass.uses)
+        {
+            // Earlier contents of an image matter unless this pass replaces them entirely. Buffer writes may be
+            // partial, so the earlier writers of a needed buffer are kept.
+            bool isBuffer = resources[use.resource].buffer != VK_NULL_HANDLE;
+            if (use.write && use.discard && !use.read)
+            {
+                needed[use.resource] = false;
+            }
+            if (use.read || (use.write && !use.discard && !isBuffer))
+            {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::allocateTransients()
+{
+    std::vector<TransientImage> plan(transientDescriptions.size());
+    for (size_t i = 0; i < plan.size(); i++)
+    {
+        plan[i].description = transientDescriptions[i];
+    }
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        if (!livePasses[i])
+        {
+            continue;
+        }
+        for (const Pass::Use &use : passes[i].uses)
+        {
+            const ResourceInfo &info = resources[use.resource];
+            if (!info.transientIndex)
+            {
+                continue;
+            }
+            TransientImage &transient = plan[*info.transientIndex];
+            if (transient.firstPass < 0)
+            {
+                if (use.read || !use.write)
+                {
+                    throw std::runtime_error("pass " + passes[i].name + " reads transient image " + info.name +
+                                             " before it is written!");
+                }
+                transient.firstPass = static_cast<int>(i);
+            }
+            transient.lastPass = static_cast<int>(i);
+        }
+    }
+
+    bool samePlan = plan.size() == transients.size();
+    for (size_t i = 0; samePlan && i < plan.size(); i++)
+    {
+        samePlan = plan[i].description == transients[i].description && plan[i].firstPass == transients[i].firstPass &&
+                   plan[i].lastPass == transients[i].lastPass;
+    }
+    if (!samePlan)
+    {
+        destroyTransients();
+
+        std::vector<VkMemoryRequirements> requirements(plan.size());
+        for (size_t i = 0; i < plan.size(); i++)
+        {
+            TransientImage &transient = plan[i];
+            if (transient.firstPass < 0)
+            {
+                continue;
+            }
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = transient.description.format;
+            imageInfo.extent = {transient.description.extent.width, transient.description.extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = transient.description.usage;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (vkCreateImage(device, &imageInfo, nullptr, &transient.image) != VK_SUCCESS)
+            {
+                transients = std::move(plan);
+                destroyTransients();
+                throw std::runtime_error("failed to create transient image!");
+            }
+            vkGetImageMemoryRequirements(device, transient.image, &requirements[i]);
+            transient.size = requirements[i].size;
+        }
+
+        // Largest first, each image goes into the first slot of a compatible memory type that is free for its
+        // whole lifetime.
+        std::vector<size_t> order(plan.size());
+        std::iota(order.begin(), order.end(), size_t{0});
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return plan[a].size > plan[b].size; });
+        std::vector<std::vector<size_t>> slotImages;
+        for (size_t i : order)
+        {
+            TransientImage &transient = plan[i];
+            if (transient.firstPass < 0)
+            {
+                continue;
+            }
+            size_t slotIndex = 0;
+            for (; slotIndex < slots.size(); slotIndex++)
+            {
+                if ((slots[slotIndex].requirements.memoryTypeBits & requirements[i].memoryTypeBits) == 0)
+                {
+                    continue;
+                }
+                bool overlaps = false;
+                for (size_t other : slotImages[slotIndex])
+                {
+                    overlaps = overlaps || (transient.firstPass <= plan[other].lastPass &&
+                                            plan[other].firstPass <= transient.lastPass);
+                }
+                if (!overlaps)
+                {
+                    break;
+                }
+            }
+            if (slotIndex == slots.size())
+            {
+                slots.push_back({requirements[i]});
+                slotImages.emplace_back();
+            }
+            MemorySlot &slot = slots[slotIndex];
+            slot.requirements.size = std::max(slot.requirements.size, requirements[i].size);
+            slot.requirements.alignment = std::max(slot.requirements.alignment, requirements[i].alignment);
+            slot.requirements.memoryTypeBits &= requirements[i].memoryTypeBits;
+            slotImages[slotIndex].push_back(i);
+            transient.slot = static_cast<uint32_t>(slotIndex);
+        }
+
+        transients = std::move(plan);
+        try
+        {
+            for (MemorySlot &slot : slots)
+            {
+                slot.allocation = allocator.allocate(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                                     DeviceMemoryAllocator::ResourceKind::Optimal);
+            }
+            for (TransientImage &transient : transients)
+            {
+                if (transient.image == VK_NULL_HANDLE)
+                {
+                    continue;
+                }
+                const DeviceMemoryAllocator::Allocation *allocation = slots[transient.slot].allocation;
+                vkBindImageMemory(device, transient.image, allocation->memory, allocation->offset);
+
+                VkImageViewCreateInfo viewInfo{};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = transient.image;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = transient.description.format;
+                viewInfo.subresourceRange = {transient.description.aspect, 0, 1, 0, 1};
+                if (vkCreateImageView(device, &viewInfo, nullptr, &transient.view) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create transient image view!");
+                }
+            }
+        }
+        catch (...)
+        {
+            destroyTransients();
+            throw;
+        }
+    }
+
+    for (const TransientImage &transient : transients)
+    {
+        if (transient.image != VK_NULL_HANDLE)
+        {
+            statistics.transientImageCount++;
+            statistics.unaliasedTransientBytes += transient.size;
+        }
+    }
+    for (const MemorySlot &slot : slots)
+    {
+        statistics.transientBytes += slot.requirements.size;
+    }
+}
+
+void RenderGraph::destroyTransients()
+{
+    if (transients.empty() && slots.empty())
+    {
+        return;
+    }
+    std::vector<VkImage> images;
+    std::vector<VkImageView> views;
+    for (const TransientImage &transient : transients)
+    {
+        images.push_back(transient.image);
+        views.push_back(transient.view);
+    }
+    std::vector<DeviceMemoryAllocator::Allocation *> allocations;
+    for (const MemorySlot &slot : slots)
+    {
+        allocations.push_back(slot.allocation);
+    }
+    transients.clear();
+    slots.clear();
+
+    retire([device = device, &allocator = allocator, images = std::move(images), views = std::move(views),
+            allocations = std::move(allocations)]() {
+        for (VkImageView view : views)
+        {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        for (VkImage image : images)
+        {
+            vkDestroyImage(device, image, nullptr);
+        }
+        for (DeviceMemoryAllocator::Allocation *allocation : allocations)
+        {
+            allocator.free(allocation);
+        }
+    });
+}
+
+void RenderGraph::planBarriers()
+{
+    passBarriers.assign(passes.size(), {});
+    finalBarriers = {};
+
+    std::vector<ResourceState> states(resources.size());
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+        // An initial access without writes only has to finish before the next write.
+        const Access &initial = resources[i].initial;
+        ResourceState &state = states[i];
+        state.layout = initial.layout;
+        if (initial.access != 0)
+        {
+            state.writeStages = initial.stages;
+            state.writeAccess = initial.access;
+        }
+        else
+        {
+            state.readStages = initial.stages;
+        }
+    }
+
+    // A transient image starts out as whatever last used its memory.
+    std::vector<bool> touched(resources.size(), false);
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        if (!livePasses[i])
+        {
+            continue;
+        }
+        BarrierBatch &batch = passBarriers[i];
+        for (const Pass::Use &use : passes[i].uses)
+        {
+            const ResourceInfo &info = resources[use.resource];
+            ResourceState &state = states[use.resource];
+            MemorySlot *slot = info.transientIndex ? &slots[transients[*info.transientIndex].slot] : nullptr;
+            if (slot && !touched[use.resource])
+            {
+                state = {};
+                state.writeStages = slot->lastStages;
+                state.writeAccess = slot->lastWrites;
+            }
+            touched[use.resource] = true;
+
+            if (use.write)
+            {
+                bool isImage = info.buffer == VK_NULL_HANDLE;
+                VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+                VkImageLayout oldLayout = use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                if (srcStages != 0 || (isImage && use.access.layout != state.layout))
+                {
+                    addBarrier(batch, use.resource, srcStages, state.writeAccess, use.access, oldLayout);
+                }
+                state.layout = use.access.layout;
+                state.writeStages = use.access.stages;
+                state.writeAccess = use.access.access;
+                state.syncedStages = use.access.stages;
+                state.syncedAccess = use.access.access;
+                state.readStages = 0;
+            }
+            else
+            {
+                planRead(batch, use.resource, state, use.access);
+            }
+
+            if (slot)
+            {
+                slot->lastStages = state.writeStages | state.readStages;
+                slot->lastWrites = state.writeAccess;
+            }
+        }
+        if (batch.srcStages != 0)
+        {
+            statistics.barrierCount++;
+        }
+    }
+
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+        const std::optional<Access> &final = resources[i].final;
+        if (final && (final->access != 0 || final->layout != states[i].layout))
+        {
+            planRead(finalBarriers, static_cast<Resource>(i), states[i], *final);
+        }
+    }
+    if (finalBarriers.srcStages != 0)
+    {
+        statistics.barrierCount++;
+    }
+}
+
+void RenderGraph::planRead(BarrierBatch &batch, Resource resource, ResourceState &state, const Access &access)
+{
+    bool isImage = resources[resource].buffer == VK_NULL_HANDLE;
+    if (isImage && access.layout != state.layout)
+    {
+        // The layout transition is itself a write every later access has to wait for.
+        addBarrier(batch, resource, state.writeStages | state.readStages, state.writeAccess, access, state.layout);
+        state.layout = access.layout;
+        state.writeStages = access.stages;
+        state.writeAccess = 0;
+        state.syncedStages = access.stages;
+        state.syncedAccess = access.access;
+    }
+    else if (state.writeStages != 0 &&
+             ((access.stages & ~state.syncedStages) != 0 || (access.access & ~state.syncedAccess) != 0))
+    {
+        addBarrier(batch, resource, state.writeStages, state.writeAccess, access, state.layout);
+        state.syncedStages |= access.stages;
+        state.syncedAccess |= access.access;
+    }
+    state.readStages |= access.stages;
+}
+
+void RenderGraph::addBarrier(BarrierBatch &batch, Resource resource, VkPipelineStageFlags srcStages,
+                             VkAccessFlags srcAccess, const Access &access, VkImageLayout oldLayout)
+{
+    const ResourceInfo &info = resources[resource];
+    batch.srcStages |= srcStages != 0 ? srcStages : VkPipelineStageFlags{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+    batch.dstStages |= access.stages != 0 ? access.stages : VkPipelineStageFlags{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+
+    if (info.buffer != VK_NULL_HANDLE)
+    {
+        // Without writes to make visible the stage masks alone order the accesses.
+        if (srcAccess == 0)
+        {
+            return;
+        }
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = access.access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = info.buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        batch.bufferBarriers.push_back(barrier);
+        statistics.bufferBarrierCount++;
+        return;
+    }
+
+    if (srcAccess == 0 && oldLayout == access.layout)
+    {
+        return;
+    }
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = access.access;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = access.layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = getImage(resource);
+    barrier.subresourceRange = {info.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+    batch.imageBarriers.push_back(barrier);
+    statistics.imageBarrierCount++;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch)
+{
+    if (batch.srcStages == 0)
+    {
+        return;
+    }
+    vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr,
+                         static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+                         static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include "DeviceMemoryAllocator.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Orders the GPU work of a frame from what every pass reads and writes. Passes are added in submission order and
+// declare their resource accesses, compile() then drops passes whose results nobody uses, places transient images
+// whose lifetimes do not overlap in the same memory, and plans the pipeline barriers and layout transitions between
+// passes: at most one vkCmdPipelineBarrier in front of a pass, none where the previous accesses are already ordered.
+//
+// The graph is rebuilt every frame with reset(), the transient images are kept for as long as the passes ask for the
+// same ones. Barriers inside a pass, such as between a clear and a dispatch, stay the pass's business.
+class RenderGraph
+{
+  public:
+    using Resource = uint32_t;
+
+    // How a resource is accessed, or was last accessed before the frame for an imported one.
+    struct Access
+    {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        // Ignored for buffers.
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct ImageDescription
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        VkImageUsageFlags usage = 0;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        bool operator==(const ImageDescription &other) const
+        {
+            return format == other.format && extent.width == other.extent.width &&
+                   extent.height == other.extent.height && usage == other.usage && aspect == other.aspect;
+        }
+    };
+
+    struct Statistics
+    {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        // vkCmdPipelineBarrier calls and the image and buffer barriers in them.
+        uint32_t barrierCount = 0;
+        uint32_t imageBarrierCount = 0;
+        uint32_t bufferBarrierCount = 0;
+        uint32_t transientImageCount = 0;
+        VkDeviceSize transientBytes = 0;
+        // What the transient images would take without aliasing.
+        VkDeviceSize unaliasedTransientBytes = 0;
+    };
+
+    class Pass
+    {
+      public:
+        Pass &read(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access,
+                   VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+        // With discard the previous contents of an image are not needed, e.g. because the pass clears it, so its
+        // layout transition may start from VK_IMAGE_LAYOUT_UNDEFINED.
+        Pass &write(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access,
+                    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED, bool discard = false);
+        // Keeps the pass even if nothing reads what it writes.
+        Pass &setSideEffects();
+
+      private:
+        friend class RenderGraph;
+
+        // Every access of a pass to one resource, merged.
+        struct Use
+        {
+            Resource resource;
+            Access access;
+            bool read;
+            bool write;
+            bool discard;
+        };
+
+        void addUse(Resource resource, const Access &access, bool read, bool write, bool discard);
+
+        std::string name;
+        std::function<void(VkCommandBuffer)> record;
+        std::vector<Use> uses;
+        bool sideEffects = false;
+    };
+
+    // retire is called with the destruction of transient images that frames in flight may still use.
+    RenderGraph(VkDevice device, DeviceMemoryAllocator &allocator,
+                std::function<void(std::function<void()>)> retire);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    // Forgets the passes and imported resources of the previous frame.
+    void reset();
+
+    // A resource owned by the caller. initial is its last access before this frame, as seen from the queue; a final
+    // access makes it an output of the frame, it is transitioned to that state after the last pass using it.
+    Resource importImage(std::string name, VkImage image, VkImageAspectFlags aspect, const Access &initial,
+                         std::optional<Access> final = std::nullopt);
+    Resource importBuffer(std::string name, VkBuffer buffer, const Access &initial,
+                          std::optional<Access> final = std::nullopt);
+    // An image that only lives during the frame. Its first use must be a write.
+    Resource createImage(std::string name, const ImageDescription &description);
+
+    // record is called from execute() with the barriers the pass needs already recorded. The returned reference stays
+    // valid until reset().
+    Pass &addPass(std::string name, std::function<void(VkCommandBuffer)> record);
+
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+
+    // Valid after compile(), for transient images too.
+    VkImage getImage(Resource resource) const;
+    // Transient images only, a view of the whole image.
+    VkImageView getImageView(Resource resource) const;
+    VkBuffer getBuffer(Resource resource) const;
+
+    const Statistics &getStatistics() const;
+
+  private:
+    struct ResourceInfo
+    {
+        std::string name;
+        VkImage image = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        Access initial;
+        std::optional<Access> final;
+        // Transient images only: index into transientDescriptions and, after compile(), into transients.
+        std::optional<uint32_t> transientIndex;
+    };
+
+    // Where a transient image lives. Images whose first to last pass ranges do not overlap share a memory slot.
+    struct TransientImage
+    {
+        ImageDescription description;
+        // Live passes using the image, -1 when all of them were culled and the image is not created.
+        int firstPass = -1;
+        int lastPass = -1;
+        uint32_t slot = 0;
+        VkDeviceSize size = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    struct MemorySlot
+    {
+        VkMemoryRequirements requirements{};
+        DeviceMemoryAllocator::Allocation *allocation = nullptr;
+        // Stages and writes of the slot's last use, which the next image placed in it has to wait for. Carried
+        // over from frame to frame.
+        VkPipelineStageFlags lastStages = 0;
+        VkAccessFlags lastWrites = 0;
+    };
+
+    struct BarrierBatch
+    {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    };
+
+    // What the planning in compile() knows about a resource at a point in the frame.
+    struct ResourceState
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // The last write, or layout transition, and the reads since that have been made to wait for it.
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags syncedStages = 0;
+        VkAccessFlags syncedAccess = 0;
+        // Reads since the last write, which the next write has to wait for.
+        VkPipelineStageFlags readStages = 0;
+    };
+
+    VkDevice device;
+    DeviceMemoryAllocator &allocator;
+    std::function<void(std::function<void()>)> retire;
+
+    std::vector<ResourceInfo> resources;
+    std::vector<ImageDescription> transientDescriptions;
+    std::deque<Pass> passes;
+
+    // The transient images and memory of the current plan, kept across reset() while the plan stays the same.
+    std::vector<TransientImage> transients;
+    std::vector<MemorySlot> slots;
+
+    // Filled by compile(): the barriers in front of each live pass and after the last one.
+    std::vector<bool> livePasses;
+    std::vector<BarrierBatch> passBarriers;
+    BarrierBatch finalBarriers;
+    Statistics statistics;
+
+    void cullPasses();
+    void allocateTransients();
+    void destroyTransients();
+    void planBarriers();
+    void addBarrier(BarrierBatch &batch, Resource resource, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                    const Access &access, VkImageLayout oldLayout);
+    // Plans the barrier a read needs and updates state, also used for the final access of outputs.
+    void planRead(BarrierBatch &batch, Resource resource, ResourceState &state, const Access &access);
+    void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch);
+};
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+StagingUploader::StagingUploader(VkDevice device, DeviceMemoryAllocator &allocator, uint32_t queueFamilyIndex,
+                                 VkQueue queue, VkDeviceSize ringSize)
+    : device(device), allocator(allocator), queue(queue), ringSize(ringSize)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS)
+    {
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        throw std::runtime_error("failed to create upload timeline semaphore!");
+    }
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = ringSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ring = allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+StagingUploader::~StagingUploader()
+{
+    wait(submittedValue);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroySemaphore(device, timelineSemaphore, nullptr);
+    allocator.destroyBuffer(ring);
+}
+
+uint64_t StagingUploader::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const char *source = static_cast<const char *>(data);
+    for (VkDeviceSize copied = 0; copied < size;)
+    {
+        VkDeviceSize chunkSize = std::min(maxChunkSize(), size - copied);
+        VkDeviceSize stagingOffset = reserve(chunkSize, 16);
+        memcpy(static_cast<char *>(ring->mapped) + stagingOffset, source + copied, (size_t)chunkSize);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = offset + copied;
+        copyRegion.size = chunkSize;
+        vkCmdCopyBuffer(currentBatch().commandBuffer, ring->buffer, buffer, 1, &copyRegion);
+        copied += chunkSize;
+    }
+    return submittedValue + 1;
+}
+
+uint64_t StagingUploader::uploadImage(VkImage image, VkExtent3D extent, uint32_t bytesPerTexel, const void *data,
+                                      VkImageLayout finalLayout, uint32_t mipLevel)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VkDeviceSize rowPitch = static_cast<VkDeviceSize>(extent.width) * bytesPerTexel;
+    if (rowPitch > maxChunkSize())
+    {
+        throw std::runtime_error("image row does not fit into the staging ring!");
+    }
+    uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(maxChunkSize() / rowPitch, extent.height));
+    // bufferOffset has to be a multiple of both 4 and the texel size.
+    VkDeviceSize alignment = std::lcm<VkDeviceSize>(bytesPerTexel, 4);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = mipLevel;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(currentBatch().commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    const char *source = static_cast<const char *>(data);
+    for (uint32_t z = 0; z < extent.depth; z++)
+    {
+        for (uint32_t y = 0; y < extent.height; y += rowsPerChunk)
+        {
+            uint32_t rowCount = std::min(rowsPerChunk, extent.height - y);
+            VkDeviceSize chunkSize = rowPitch * rowCount;
+            VkDeviceSize stagingOffset = reserve(chunkSize, alignment);
+            memcpy(static_cast<char *>(ring->mapped) + stagingOffset,
+                   source + (static_cast<VkDeviceSize>(z) * extent.height + y) * rowPitch, (size_t)chunkSize);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = stagingOffset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = mipLevel;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, static_cast<int32_t>(y), static_cast<int32_t>(z)};
+            region.imageExtent = {extent.width, rowCount, 1};
+            vkCmdCopyBufferToImage(currentBatch().commandBuffer, ring->buffer, image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+    }
+
+    // The consumer's wait on the timeline semaphore makes the writes visible, no access on this queue follows.
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    vkCmdPipelineBarrier(currentBatch().commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    return submittedValue + 1;
+}
+
+uint64_t StagingUploader::submit()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return submitLocked();
+}
+
+VkSemaphore StagingUploader::getTimelineSemaphore() const
+{
+    return timelineSemaphore;
+}
+
+uint64_t StagingUploader::getCompletedValue() const
+{
+    uint64_t value;
+    vkGetSemaphoreCounterValue(device, timelineSemaphore, &value);
+    return value;
+}
+
+void StagingUploader::wait(uint64_t value) const
+{
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelineSemaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+}
+
+VkDeviceSize StagingUploader::maxChunkSize() const
+{
+    // Half the ring always fits once everything before it has been retired, so large uploads cannot deadlock.
+    return ringSize / 2;
+}
+
+StagingUploader::Batch &StagingUploader::currentBatch()
+{
+    if (!recording.has_value())
+    {
+        Batch batch;
+        if (!idleCommandBuffers.empty())
+        {
+            batch.commandBuffer = idleCommandBuffers.back();
+            idleCommandBuffers.pop_back();
+        }
+        else
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording upload command buffer!");
+        }
+        batch.ringEnd = ringHead;
+        recording = batch;
+    }
+    return recording.value();
+}
+
+VkDeviceSize StagingUploader::reserve(VkDeviceSize size, VkDeviceSize alignment)
+{
+    for (;;)
+    {
+        reclaim();
+        std::optional<VkDeviceSize> offset = tryReserve(size, alignment);
+        if (offset.has_value())
+        {
+            currentBatch().ringEnd = ringHead;
+            return offset.value();
+        }
+
+        // Out of room: push out what is staged so far, then wait for the oldest batch to retire.
+        if (recording.has_value())
+        {
+            submitLocked();
+        }
+        else if (!inFlight.empty())
+        {
+            wait(inFlight.front().timelineValue);
+        }
+        else
+        {
+            throw std::runtime_error("upload does not fit into the staging ring!");
+        }
+    }
+}
+
+std::optional<VkDeviceSize> StagingUploader::tryReserve(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = (ringHead + alignment - 1) / alignment * alignment;
+    if (ringEmpty || ringHead > ringTail)
+    {
+        // Free space is [head, end) followed by [0, tail).
+        if (offset + size > ringSize)
+        {
+            if (ringEmpty || size > ringTail)
+            {
+                return std::nullopt;
+            }
+            offset = 0;
+        }
+    }
+    else if (ringHead < ringTail)
+    {
+        if (offset + size > ringTail)
+        {
+            return std::nullopt;
+        }
+    }
+    else
+    {
+        return std::nullopt;
+    }
+
+    ringHead = offset + size;
+    ringEmpty = false;
+    return offset;
+}
+
+void StagingUploader::reclaim()
+{
+    if (inFlight.empty())
+    {
+        return;
+    }
+
+    uint64_t completedValue = getCompletedValue();
+    while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue)
+    {
+        ringTail = inFlight.front().ringEnd;
+        vkResetCommandBuffer(inFlight.front().commandBuffer, 0);
+        idleCommandBuffers.push_back(inFlight.front().commandBuffer);
+        inFlight.pop_front();
+    }
+    if (inFlight.empty() && !recording.has_value())
+    {
+        ringEmpty = true;
+        ringHead = 0;
+        ringTail = 0;
+    }
+}
+
+uint64_t StagingUploader::submitLocked()
+{
+    if (!recording.has_value())
+    {
+        return submittedValue;
+    }
+
+    Batch batch = recording.value();
+    recording.reset();
+    if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    batch.timelineValue = submittedValue + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch.timelineValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timelineSemaphore;
+    if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+
+    submittedValue = batch.timelineValue;
+    inFlight.push_back(batch);
+    return submittedValue;
+}
\ No newline at end of file
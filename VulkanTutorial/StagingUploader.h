@@ -0,0 +1,72 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include "DeviceMemoryAllocator.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Streams data into DEVICE_LOCAL buffers and images through a persistently mapped staging ring. Copies are batched
+// into one command buffer until submit() is called, and every submit signals the next value of a timeline semaphore.
+// Consumers wait on that value on the GPU instead of stalling the CPU.
+class StagingUploader
+{
+  public:
+    // queue may be a dedicated transfer queue; resources written from it must then be created with concurrent sharing
+    // between queueFamilyIndex and the queue families that read them.
+    StagingUploader(VkDevice device, DeviceMemoryAllocator &allocator, uint32_t queueFamilyIndex, VkQueue queue,
+                    VkDeviceSize ringSize = 16ull * 1024 * 1024);
+    ~StagingUploader();
+
+    StagingUploader(const StagingUploader &) = delete;
+    StagingUploader &operator=(const StagingUploader &) = delete;
+
+    // Both return the timeline value that signals completion once the batch holding the copy is submitted. Data larger
+    // than half the ring is split into several copies, which may submit and wait on earlier batches to make room.
+    uint64_t uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+    // Uploads tightly packed texels into one mip level and transitions it from UNDEFINED to finalLayout.
+    uint64_t uploadImage(VkImage image, VkExtent3D extent, uint32_t bytesPerTexel, const void *data,
+                         VkImageLayout finalLayout, uint32_t mipLevel = 0);
+
+    // Submits the batched copies, returns the timeline value they signal or the last submitted value if nothing was
+    // pending.
+    uint64_t submit();
+
+    VkSemaphore getTimelineSemaphore() const;
+    uint64_t getCompletedValue() const;
+    void wait(uint64_t value) const;
+
+  private:
+    struct Batch
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t timelineValue = 0;
+        // Ring offset just past the last byte this batch staged, the tail moves here once the batch completes.
+        VkDeviceSize ringEnd = 0;
+    };
+
+    VkDevice device;
+    DeviceMemoryAllocator &allocator;
+    VkQueue queue;
+    VkCommandPool commandPool;
+    VkSemaphore timelineSemaphore;
+    DeviceMemoryAllocator::Allocation *ring;
+    VkDeviceSize ringSize;
+    VkDeviceSize ringHead = 0;
+    VkDeviceSize ringTail = 0;
+    bool ringEmpty = true;
+    uint64_t submittedValue = 0;
+    std::optional<Batch> recording;
+    std::deque<Batch> inFlight;
+    std::vector<VkCommandBuffer> idleCommandBuffers;
+    std::mutex mutex;
+
+    VkDeviceSize maxChunkSize() const;
+    Batch &currentBatch();
+    VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment);
+    std::optional<VkDeviceSize> tryReserve(VkDeviceSize size, VkDeviceSize alignment);
+    void reclaim();
+    uint64_t submitLocked();
+};
\ No newline at end of file
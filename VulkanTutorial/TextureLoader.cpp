@@ -0,0 +1,333 @@
+#include "TextureLoader.h"
+
+#include "CpuProfiler.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <stdexcept>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+TextureLoader::TextureLoader(VkPhysicalDevice physicalDevice, VkDevice device, DeviceMemoryAllocator &allocator,
+                             StagingUploader &uploader, std::vector<uint32_t> queueFamilyIndices,
+                             uint32_t decodeThreads, VkDeviceSize uploadBudget)
+    : device(device), allocator(allocator), uploader(uploader), queueFamilyIndices(std::move(queueFamilyIndices)),
+      decodeThreads(decodeThreads), uploadBudget(uploadBudget)
+{
+    std::sort(this->queueFamilyIndices.begin(), this->queueFamilyIndices.end());
+    this->queueFamilyIndices.erase(std::unique(this->queueFamilyIndices.begin(), this->queueFamilyIndices.end()),
+                                   this->queueFamilyIndices.end());
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+    mipFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0
+                    ? VK_FILTER_LINEAR
+                    : VK_FILTER_NEAREST;
+
+    loaderThread = std::thread(&TextureLoader::loaderLoop, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    requestCondition.notify_one();
+    loaderThread.join();
+
+    for (Entry &entry : textures)
+    {
+        if (entry.allocation)
+        {
+            vkDestroyImageView(device, entry.texture.view, nullptr);
+            allocator.destroyImage(entry.texture.image, entry.allocation);
+        }
+    }
+}
+
+TextureLoader::Handle TextureLoader::load(const std::filesystem::path &path)
+{
+    return addRequest({0, path, {}}, path.string());
+}
+
+TextureLoader::Handle TextureLoader::load(std::string name, std::span<const uint8_t> encoded)
+{
+    return addRequest({0, {}, encoded}, std::move(name));
+}
+
+TextureLoader::Handle TextureLoader::addRequest(Request request, std::string name)
+{
+    Handle handle = static_cast<Handle>(textures.size());
+    Entry &entry = textures.emplace_back();
+    entry.name = std::move(name);
+    pendingCount++;
+
+    request.handle = handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(std::move(request));
+    }
+    requestCondition.notify_one();
+    return handle;
+}
+
+uint64_t TextureLoader::recordUploads(VkCommandBuffer commandBuffer)
+{
+    PROFILE_FUNCTION();
+    std::vector<Decoded> images;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // At least one image per call, so one larger than the budget still gets through.
+        VkDeviceSize bytes = 0;
+        while (!decoded.empty() && (images.empty() || bytes + 4ull * decoded.front().width * decoded.front().height <=
+                                                             uploadBudget))
+        {
+            bytes += 4ull * decoded.front().width * decoded.front().height;
+            images.push_back(std::move(decoded.front()));
+            decoded.pop_front();
+        }
+    }
+    if (images.empty())
+    {
+        return 0;
+    }
+
+    std::vector<Entry *> uploaded;
+    for (const Decoded &image : images)
+    {
+        Entry &entry = textures[image.handle];
+        pendingCount--;
+        if (!image.pixels)
+        {
+            entry.state = State::Failed;
+            entry.error = entry.name + ": " + image.error;
+            continue;
+        }
+        createTexture(entry, image);
+        uploaded.push_back(&entry);
+    }
+    if (uploaded.empty())
+    {
+        return 0;
+    }
+
+    uint64_t uploadValue = uploader.submit();
+    for (Entry *entry : uploaded)
+    {
+        recordMipChain(commandBuffer, entry->texture);
+        entry->state = State::Ready;
+    }
+    return uploadValue;
+}
+
+TextureLoader::State TextureLoader::getState(Handle handle) const
+{
+    return textures.at(handle).state;
+}
+
+const TextureLoader::Texture &TextureLoader::getTexture(Handle handle) const
+{
+    const Entry &entry = textures.at(handle);
+    if (entry.state != State::Ready)
+    {
+        throw std::runtime_error("texture " + entry.name + " is not ready!");
+    }
+    return entry.texture;
+}
+
+const std::string &TextureLoader::getError(Handle handle) const
+{
+    return textures.at(handle).error;
+}
+
+uint32_t TextureLoader::getPendingCount() const
+{
+    return pendingCount;
+}
+
+void TextureLoader::loaderLoop()
+{
+    PROFILE_THREAD_NAME("texture loader");
+    // The loader thread is worker 0, so parallelFor is called from the thread that created the job system.
+    JobSystem jobSystem(decodeThreads);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        requestCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+        if (stopping)
+        {
+            return;
+        }
+        std::vector<Request> batch = std::move(requests);
+        requests.clear();
+        lock.unlock();
+
+        std::vector<Decoded> results(batch.size());
+        jobSystem.parallelFor(static_cast<uint32_t>(batch.size()),
+                              [&](uint32_t index, uint32_t) { results[index] = decode(batch[index]); });
+
+        lock.lock();
+        for (Decoded &result : results)
+        {
+            decoded.push_back(std::move(result));
+        }
+    }
+}
+
+TextureLoader::Decoded TextureLoader::decode(const Request &request)
+{
+    PROFILE_FUNCTION();
+    Decoded result;
+    result.handle = request.handle;
+    // Runs on job system workers, where an escaping exception would terminate the process.
+    try
+    {
+        std::vector<uint8_t> fileData;
+        std::span<const uint8_t> encoded = request.encoded;
+        if (!request.path.empty())
+        {
+            std::ifstream file(request.path, std::ios::ate | std::ios::binary);
+            if (!file.is_open())
+            {
+                result.error = "failed to open file!";
+                return result;
+            }
+            fileData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(fileData.data()), static_cast<std::streamsize>(fileData.size()));
+            encoded = fileData;
+        }
+
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height,
+                                                &channels, STBI_rgb_alpha);
+        if (!pixels)
+        {
+            result.error = std::string("failed to decode image: ") + stbi_failure_reason();
+            return result;
+        }
+        result.pixels = {pixels, stbi_image_free};
+        result.width = static_cast<uint32_t>(width);
+        result.height = static_cast<uint32_t>(height);
+    }
+    catch (const std::exception &e)
+    {
+        result.pixels.reset();
+        result.error = e.what();
+    }
+    return result;
+}
+
+void TextureLoader::createTexture(Entry &entry, const Decoded &image)
+{
+    Texture &texture = entry.texture;
+    texture.extent = {image.width, image.height};
+    texture.mipLevels = static_cast<uint32_t>(std::bit_width(std::max(image.width, image.height)));
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.extent = {image.width, image.height, 1};
+    imageInfo.mipLevels = texture.mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // Written on the uploader's queue and read on the graphics queue, concurrent sharing avoids ownership transfers.
+    if (queueFamilyIndices.size() > 1)
+    {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+        imageInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    }
+    else
+    {
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    entry.allocation = allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &texture.view) != VK_SUCCESS)
+    {
+        allocator.destroyImage(texture.image, entry.allocation);
+        entry.allocation = nullptr;
+        throw std::runtime_error("failed to create texture image view!");
+    }
+
+    // Level 0 is left as the source of the first blit.
+    uploader.uploadImage(texture.image, {image.width, image.height, 1}, 4, image.pixels.get(),
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+}
+
+void TextureLoader::recordMipChain(VkCommandBuffer commandBuffer, const Texture &texture)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    if (texture.mipLevels > 1)
+    {
+        barrier.subresourceRange.baseMipLevel = 1;
+        barrier.subresourceRange.levelCount = texture.mipLevels - 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // Every level is blitted from the one above it, which is then made readable for the next blit.
+    int32_t width = static_cast<int32_t>(texture.extent.width);
+    int32_t height = static_cast<int32_t>(texture.extent.height);
+    barrier.subresourceRange.levelCount = 1;
+    for (uint32_t level = 1; level < texture.mipLevels; level++)
+    {
+        int32_t levelWidth = std::max(width / 2, 1);
+        int32_t levelHeight = std::max(height / 2, 1);
+
+        VkImageBlit blit{};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.srcOffsets[1] = {width, height, 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        blit.dstOffsets[1] = {levelWidth, levelHeight, 1};
+        vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, mipFilter);
+
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+
+        width = levelWidth;
+        height = levelHeight;
+    }
+
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = texture.mipLevels;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+}
\ No newline at end of file
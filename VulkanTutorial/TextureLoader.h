@@ -0,0 +1,123 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include "DeviceMemoryAllocator.h"
+#include "StagingUploader.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads RGBA8 sRGB textures without stalling the render loop. Files are read and decoded by a background thread that
+// spreads every batch of requests over a JobSystem, the render thread then uploads the decoded level 0 of a few
+// textures per frame through the StagingUploader and generates the rest of the mip chain on the GPU with a blit chain
+// recorded into its frame command buffer.
+class TextureLoader
+{
+  public:
+    using Handle = uint32_t;
+
+    enum class State
+    {
+        Loading,
+        Ready,
+        Failed
+    };
+
+    struct Texture
+    {
+        VkImage image = VK_NULL_HANDLE;
+        // All mip levels, the image is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL once ready.
+        VkImageView view = VK_NULL_HANDLE;
+        VkExtent2D extent{};
+        uint32_t mipLevels = 0;
+    };
+
+    // queueFamilyIndices are the families that access the textures, the uploader's and the one recordUploads is
+    // submitted to; with more than one the images are shared concurrently. decodeThreads includes the loader thread,
+    // 0 uses one per hardware thread. At most uploadBudget bytes of texels are uploaded per recordUploads call.
+    TextureLoader(VkPhysicalDevice physicalDevice, VkDevice device, DeviceMemoryAllocator &allocator,
+                  StagingUploader &uploader, std::vector<uint32_t> queueFamilyIndices, uint32_t decodeThreads = 0,
+                  VkDeviceSize uploadBudget = 8ull * 1024 * 1024);
+    // The owner waits for the device to be idle first.
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+
+    // The file is read on the loader thread.
+    Handle load(const std::filesystem::path &path);
+    // encoded is a PNG, JPEG, TGA or BMP image and must stay valid until the texture is ready or has failed.
+    Handle load(std::string name, std::span<const uint8_t> encoded);
+
+    // Called once per frame on the render thread with the frame's command buffer, outside a render pass. Uploads the
+    // textures decoded so far, within the budget, and records their mip generation. Returns the timeline value of the
+    // uploader's semaphore that the command buffer has to wait on at VK_PIPELINE_STAGE_TRANSFER_BIT, 0 without uploads.
+    // Textures it made ready may be sampled from the fragment and compute stages later in the same command buffer.
+    uint64_t recordUploads(VkCommandBuffer commandBuffer);
+
+    State getState(Handle handle) const;
+    // Throws unless the texture is ready.
+    const Texture &getTexture(Handle handle) const;
+    // Why the texture failed, prefixed with its path or name, empty otherwise.
+    const std::string &getError(Handle handle) const;
+    // Textures requested but neither ready nor failed.
+    uint32_t getPendingCount() const;
+
+  private:
+    struct Entry
+    {
+        std::string name;
+        State state = State::Loading;
+        Texture texture;
+        DeviceMemoryAllocator::Allocation *allocation = nullptr;
+        std::string error;
+    };
+
+    struct Request
+    {
+        Handle handle;
+        std::filesystem::path path;
+        std::span<const uint8_t> encoded;
+    };
+
+    struct Decoded
+    {
+        Handle handle = 0;
+        std::unique_ptr<uint8_t, void (*)(void *)> pixels{nullptr, nullptr};
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::string error;
+    };
+
+    VkDevice device;
+    DeviceMemoryAllocator &allocator;
+    StagingUploader &uploader;
+    std::vector<uint32_t> queueFamilyIndices;
+    uint32_t decodeThreads;
+    VkDeviceSize uploadBudget;
+    VkFilter mipFilter;
+    // Only touched by the render thread.
+    std::deque<Entry> textures;
+    uint32_t pendingCount = 0;
+
+    // Shared with the loader thread.
+    std::mutex mutex;
+    std::condition_variable requestCondition;
+    std::vector<Request> requests;
+    std::deque<Decoded> decoded;
+    bool stopping = false;
+    std::thread loaderThread;
+
+    Handle addRequest(Request request, std::string name);
+    void loaderLoop();
+    static Decoded decode(const Request &request);
+    void createTexture(Entry &entry, const Decoded &image);
+    void recordMipChain(VkCommandBuffer commandBuffer, const Texture &texture);
+};
\ No newline at end of file
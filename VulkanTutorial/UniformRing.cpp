@@ -0,0 +1,66 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+UniformRing::UniformRing(VkPhysicalDevice physicalDevice, DeviceMemoryAllocator &allocator, uint32_t frameCount,
+                         VkDeviceSize regionSize)
+    : allocator(allocator)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+    this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+    if (this->regionSize * frameCount > UINT32_MAX)
+    {
+        throw std::runtime_error("uniform ring does not fit 32-bit dynamic offsets!");
+    }
+
+    // Device local host visible memory lets shaders read the uniforms without a PCIe round trip where the platform
+    // has it.
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = this->regionSize * frameCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer =
+        allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+UniformRing::~UniformRing()
+{
+    allocator.destroyBuffer(buffer);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{
+    regionOffset = regionSize * frameIndex;
+    head.store(0, std::memory_order_relaxed);
+}
+
+void UniformRing::endFrame()
+{
+    // Only the bytes this frame allocated, not the whole ring.
+    allocator.flush(buffer, regionOffset, getUsedBytes());
+}
+
+UniformRing::Range UniformRing::allocate(VkDeviceSize size)
+{
+    VkDeviceSize alignedSize = (size + alignment - 1) / alignment * alignment;
+    VkDeviceSize offset = head.fetch_add(alignedSize, std::memory_order_relaxed);
+    if (offset + alignedSize > regionSize)
+    {
+        throw std::runtime_error("uniform ring region is full!");
+    }
+    return {static_cast<uint32_t>(regionOffset + offset), static_cast<char *>(buffer->mapped) + regionOffset + offset};
+}
+
+VkBuffer UniformRing::getBuffer() const
+{
+    return buffer->buffer;
+}
+
+VkDeviceSize UniformRing::getUsedBytes() const
+{
+    return std::min(head.load(std::memory_order_relaxed), regionSize);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include "DeviceMemoryAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Per-frame uniform data in one persistently mapped buffer with a region per frame in flight. Data is bump allocated
+// from the current frame's region and bound through VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptors that point
+// at the whole buffer, so every object can get fresh uniforms each frame without mapping memory, creating buffers or
+// updating descriptor sets.
+class UniformRing
+{
+  public:
+    struct Range
+    {
+        // Dynamic offset to bind the data with.
+        uint32_t offset;
+        void *data;
+    };
+
+    UniformRing(VkPhysicalDevice physicalDevice, DeviceMemoryAllocator &allocator, uint32_t frameCount,
+                VkDeviceSize regionSize = 4ull * 1024 * 1024);
+    ~UniformRing();
+
+    UniformRing(const UniformRing &) = delete;
+    UniformRing &operator=(const UniformRing &) = delete;
+
+    // Starts writing into frameIndex's region, after the frame that last used it has been waited on.
+    void beginFrame(uint32_t frameIndex);
+    // Makes the frame's writes visible to the device, must be called before the frame is submitted.
+    void endFrame();
+
+    // Safe to call from several threads between beginFrame and endFrame. Throws when the frame's region is full.
+    Range allocate(VkDeviceSize size);
+
+    template <typename T> uint32_t push(const T &value)
+    {
+        Range range = allocate(sizeof(T));
+        memcpy(range.data, &value, sizeof(T));
+        return range.offset;
+    }
+
+    VkBuffer getBuffer() const;
+    // Bytes allocated from the current frame's region, including alignment padding.
+    VkDeviceSize getUsedBytes() const;
+
+  private:
+    DeviceMemoryAllocator &allocator;
+    DeviceMemoryAllocator::Allocation *buffer;
+    VkDeviceSize alignment;
+    VkDeviceSize regionSize;
+    VkDeviceSize regionOffset = 0;
+    std::atomic<VkDeviceSize> head{0};
+};
\ No newline at end of file
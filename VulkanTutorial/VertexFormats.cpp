@@ -0,0 +1,349 @@
+#include "VertexFormats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_FORMATS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+uint32_t floatBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int16_t floatToSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lrint(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint32_t packUnorm8(glm::vec3 color)
+{
+    uint32_t r = static_cast<uint32_t>(std::lrint(std::clamp(color.x, 0.0f, 1.0f) * 255.0f));
+    uint32_t g = static_cast<uint32_t>(std::lrint(std::clamp(color.y, 0.0f, 1.0f) * 255.0f));
+    uint32_t b = static_cast<uint32_t>(std::lrint(std::clamp(color.z, 0.0f, 1.0f) * 255.0f));
+    return r | g << 8 | b << 16 | 0xFFu << 24;
+}
+
+#ifdef VERTEX_FORMATS_SSE2
+// Four floats to four halves in the low 16 bits of each lane, the same steps as floatToHalf without branches.
+__m128i floatToHalf4(__m128 value)
+{
+    const __m128i signMask = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i infinity = _mm_set1_epi32(255 << 23);
+    const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i smallestNormal = _mm_set1_epi32(113 << 23);
+    const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i rebias = _mm_set1_epi32(static_cast<int>((15u - 127u) << 23) + 0xFFF);
+
+    __m128i bits = _mm_castps_si128(value);
+    __m128i sign = _mm_and_si128(bits, signMask);
+    __m128i magnitude = _mm_xor_si128(bits, sign);
+
+    // Denormal results: adding the magic number lets the FPU do the shift and the rounding.
+    __m128i denormal = _mm_sub_epi32(
+        _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), _mm_castsi128_ps(denormMagic))), denormMagic);
+
+    // Normal results: rebias the exponent and round to nearest even by hand.
+    __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(magnitude, rebias), mantissaOdd), 13);
+
+    // Magnitudes are below 0x80000000, so the signed compares are safe.
+    __m128i isNaN = _mm_cmpgt_epi32(magnitude, infinity);
+    __m128i isInfOrNaN = _mm_cmpgt_epi32(magnitude, _mm_sub_epi32(halfMax, _mm_set1_epi32(1)));
+    __m128i isDenormal = _mm_cmpgt_epi32(smallestNormal, magnitude);
+    __m128i special = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(isNaN, _mm_set1_epi32(0x0200)));
+
+    __m128i result = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+    result = _mm_or_si128(_mm_and_si128(isInfOrNaN, special), _mm_andnot_si128(isInfOrNaN, result));
+    return _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+}
+
+// Packs the low 16 bits of every lane of a and b into eight 16-bit lanes. SSE2 only has a saturating pack, sign
+// extending first keeps the bits intact.
+__m128i packLow16(__m128i a, __m128i b)
+{
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+// r, g and b in the first three lanes, the fourth is ignored.
+uint32_t packUnorm8(__m128 color)
+{
+    // Force alpha to one, then round, saturate and narrow 32 -> 16 -> 8 bits.
+    const __m128 alphaOne = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, static_cast<int>(0x3F800000u)));
+    const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    color = _mm_or_ps(_mm_and_ps(color, rgbMask), alphaOne);
+    color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128i rounded = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+    __m128i words = _mm_packs_epi32(rounded, rounded);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+
+__m128 loadPositions(const Vertex *vertices)
+{
+    // The positions of two vertices in one register.
+    __m128 positions = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(&vertices[0].pos)));
+    return _mm_loadh_pi(positions, reinterpret_cast<const __m64 *>(&vertices[1].pos));
+}
+
+__m128 loadColor(const Vertex &vertex, bool last)
+{
+    if (last)
+    {
+        // A 16 byte load would read past the end of the array.
+        return _mm_setr_ps(vertex.color.x, vertex.color.y, vertex.color.z, 0.0f);
+    }
+    return _mm_loadu_ps(&vertex.color.x);
+}
+#endif
+} // namespace
+
+uint32_t VertexFormats::getStride(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Float:
+        return sizeof(Vertex);
+    case VertexFormat::Half:
+        return sizeof(HalfVertex);
+    case VertexFormat::Snorm16:
+        return sizeof(Snorm16Vertex);
+    }
+    throw std::runtime_error("unknown vertex format!");
+}
+
+VkVertexInputBindingDescription VertexFormats::getBindingDescription(VertexFormat format)
+{
+    VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
+    bindingDescription.stride = getStride(format);
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 2> VertexFormats::getAttributeDescriptions(VertexFormat format)
+{
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = Vertex::getAttributeDescriptions();
+    if (format == VertexFormat::Float)
+    {
+        return attributeDescriptions;
+    }
+
+    // Both packed formats share one layout, they only differ in how the position is stored.
+    attributeDescriptions[0].format =
+        format == VertexFormat::Half ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[0].offset = offsetof(HalfVertex, pos);
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[1].offset = offsetof(HalfVertex, color);
+    return attributeDescriptions;
+}
+
+std::vector<uint8_t> VertexFormats::encode(const std::vector<Vertex> &vertices, VertexFormat format)
+{
+    std::vector<uint8_t> data(static_cast<size_t>(getStride(format)) * vertices.size());
+    switch (format)
+    {
+    case VertexFormat::Float:
+        memcpy(data.data(), vertices.data(), data.size());
+        break;
+    case VertexFormat::Half:
+        encodeHalf(vertices.data(), vertices.size(), reinterpret_cast<HalfVertex *>(data.data()));
+        break;
+    case VertexFormat::Snorm16:
+        encodeSnorm16(vertices.data(), vertices.size(), reinterpret_cast<Snorm16Vertex *>(data.data()));
+        break;
+    }
+    return data;
+}
+
+void VertexFormats::encodeHalf(const Vertex *vertices, size_t count, HalfVertex *output)
+{
+    size_t i = 0;
+#ifdef VERTEX_FORMATS_SSE2
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i halves = floatToHalf4(loadPositions(&vertices[i]));
+        __m128i packed = packLow16(halves, halves);
+        uint32_t positions[2];
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(positions), packed);
+
+        memcpy(output[i].pos, &positions[0], sizeof(positions[0]));
+        memcpy(output[i + 1].pos, &positions[1], sizeof(positions[1]));
+        output[i].color = packUnorm8(loadColor(vertices[i], false));
+        output[i + 1].color = packUnorm8(loadColor(vertices[i + 1], i + 2 == count));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        output[i].pos[0] = floatToHalf(vertices[i].pos.x);
+        output[i].pos[1] = floatToHalf(vertices[i].pos.y);
+        output[i].color = packUnorm8(vertices[i].color);
+    }
+}
+
+void VertexFormats::encodeSnorm16(const Vertex *vertices, size_t count, Snorm16Vertex *output)
+{
+    size_t i = 0;
+#ifdef VERTEX_FORMATS_SSE2
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128 positions = loadPositions(&vertices[i]);
+        positions = _mm_min_ps(_mm_max_ps(positions, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+        __m128i rounded = _mm_cvtps_epi32(_mm_mul_ps(positions, _mm_set1_ps(32767.0f)));
+        __m128i packed = _mm_packs_epi32(rounded, rounded);
+        uint32_t packedPositions[2];
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(packedPositions), packed);
+
+        memcpy(output[i].pos, &packedPositions[0], sizeof(packedPositions[0]));
+        memcpy(output[i + 1].pos, &packedPositions[1], sizeof(packedPositions[1]));
+        output[i].color = packUnorm8(loadColor(vertices[i], false));
+        output[i + 1].color = packUnorm8(loadColor(vertices[i + 1], i + 2 == count));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        output[i].pos[0] = floatToSnorm16(vertices[i].pos.x);
+        output[i].pos[1] = floatToSnorm16(vertices[i].pos.y);
+        output[i].color = packUnorm8(vertices[i].color);
+    }
+}
+
+uint16_t VertexFormats::floatToHalf(float value)
+{
+    uint32_t bits = floatBits(value);
+    uint32_t sign = bits & 0x80000000u;
+    uint32_t magnitude = bits ^ sign;
+
+    uint32_t result;
+    if (magnitude >= (127u + 16u) << 23)
+    {
+        // Too large for a half or already infinite, NaNs stay quiet NaNs.
+        result = magnitude > 255u << 23 ? 0x7E00u : 0x7C00u;
+    }
+    else if (magnitude < 113u << 23)
+    {
+        // Denormal or zero as a half. Adding 0.5 shifts the mantissa into place and the FPU rounds it.
+        const uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        result = floatBits(bitsFloat(magnitude) + bitsFloat(denormMagic)) - denormMagic;
+    }
+    else
+    {
+        uint32_t mantissaOdd = (magnitude >> 13) & 1u;
+        result = (magnitude + ((15u - 127u) << 23) + 0xFFFu + mantissaOdd) >> 13;
+    }
+    return static_cast<uint16_t>(result | sign >> 16);
+}
+
+float VertexFormats::halfToFloat(uint16_t value)
+{
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    if (exponent == 0)
+    {
+        // Zero or denormal, the value is mantissa * 2^-24.
+        float magnitude = static_cast<float>(mantissa) * bitsFloat(103u << 23);
+        return bitsFloat(floatBits(magnitude) | sign);
+    }
+    if (exponent == 31)
+    {
+        return bitsFloat(sign | 0x7F800000u | mantissa << 13);
+    }
+    return bitsFloat(sign | (exponent + 127u - 15u) << 23 | mantissa << 13);
+}
+
+void VertexFormats::encodeOctahedral(const glm::vec3 *normals, size_t count, uint32_t *output)
+{
+    size_t i = 0;
+#ifdef VERTEX_FORMATS_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        const glm::vec3 *n = &normals[i];
+        __m128 x = _mm_setr_ps(n[0].x, n[1].x, n[2].x, n[3].x);
+        __m128 y = _mm_setr_ps(n[0].y, n[1].y, n[2].y, n[3].y);
+        __m128 z = _mm_setr_ps(n[0].z, n[1].z, n[2].z, n[3].z);
+
+        __m128 inverseL1 =
+            _mm_div_ps(one, _mm_add_ps(_mm_add_ps(_mm_and_ps(x, absMask), _mm_and_ps(y, absMask)),
+                                       _mm_and_ps(z, absMask)));
+        __m128 px = _mm_mul_ps(x, inverseL1);
+        __m128 py = _mm_mul_ps(y, inverseL1);
+
+        // Lower hemisphere: fold over the diagonals, keeping the sign of the component (+1 for zero).
+        __m128 signX = _mm_or_ps(one, _mm_and_ps(px, signMask));
+        __m128 signY = _mm_or_ps(one, _mm_and_ps(py, signMask));
+        __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(py, absMask)), signX);
+        __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(px, absMask)), signY);
+        __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        px = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, px));
+        py = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, py));
+
+        __m128i ix = _mm_cvtps_epi32(_mm_mul_ps(px, _mm_set1_ps(32767.0f)));
+        __m128i iy = _mm_cvtps_epi32(_mm_mul_ps(py, _mm_set1_ps(32767.0f)));
+        // x0 x1 x2 x3 y0 y1 y2 y3 -> x0 y0 x1 y1 x2 y2 x3 y3
+        __m128i packed = _mm_packs_epi32(ix, iy);
+        __m128i interleaved = _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&output[i]), interleaved);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        glm::vec3 n = normals[i];
+        float inverseL1 = 1.0f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+        float px = n.x * inverseL1;
+        float py = n.y * inverseL1;
+        if (n.z < 0.0f)
+        {
+            float foldedX = std::copysign(1.0f - std::abs(py), px);
+            float foldedY = std::copysign(1.0f - std::abs(px), py);
+            px = foldedX;
+            py = foldedY;
+        }
+        uint32_t x = static_cast<uint16_t>(floatToSnorm16(px));
+        uint32_t y = static_cast<uint16_t>(floatToSnorm16(py));
+        output[i] = x | y << 16;
+    }
+}
+
+glm::vec3 VertexFormats::decodeOctahedral(uint32_t encoded)
+{
+    float ex = std::max(static_cast<int16_t>(encoded & 0xFFFFu) / 32767.0f, -1.0f);
+    float ey = std::max(static_cast<int16_t>(encoded >> 16) / 32767.0f, -1.0f);
+    glm::vec3 n(ex, ey, 1.0f - std::abs(ex) - std::abs(ey));
+    if (n.z < 0.0f)
+    {
+        float foldedX = std::copysign(1.0f - std::abs(n.y), n.x);
+        float foldedY = std::copysign(1.0f - std::abs(n.x), n.y);
+        n.x = foldedX;
+        n.y = foldedY;
+    }
+    return glm::normalize(n);
+}
+
+VkVertexInputAttributeDescription VertexFormats::getOctahedralNormalAttributeDescription(uint32_t location,
+                                                                                        uint32_t binding,
+                                                                                        uint32_t offset)
+{
+    VkVertexInputAttributeDescription attributeDescription{};
+    attributeDescription.location = location;
+    attributeDescription.binding = binding;
+    attributeDescription.format = VK_FORMAT_R16G16_SNORM;
+    attributeDescription.offset = offset;
+    return attributeDescription;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include "Vertex.h"
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Quantised alternatives to Vertex. Both cut a vertex from 20 to 8 bytes, the vertex fetch converts them back to
+// floats so the shaders stay the same. The encoders use SSE2 where the target has it.
+enum class VertexFormat
+{
+    // Vertex as is: 32-bit float position and colour.
+    Float,
+    // Half float position, UNORM8 colour.
+    Half,
+    // SNORM16 position, UNORM8 colour. Positions are clamped to [-1, 1], which is where this application's meshes
+    // live; larger meshes would need a scale and bias applied in the vertex shader.
+    Snorm16,
+};
+
+namespace VertexFormats
+{
+struct HalfVertex
+{
+    uint16_t pos[2];
+    uint32_t color;
+};
+
+struct Snorm16Vertex
+{
+    int16_t pos[2];
+    uint32_t color;
+};
+
+// Size of one vertex in the vertex buffer.
+uint32_t getStride(VertexFormat format);
+VkVertexInputBindingDescription getBindingDescription(VertexFormat format);
+// Same locations as Vertex::getAttributeDescriptions().
+std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(VertexFormat format);
+
+// Vertex buffer contents for the given format.
+std::vector<uint8_t> encode(const std::vector<Vertex> &vertices, VertexFormat format);
+
+void encodeHalf(const Vertex *vertices, size_t count, HalfVertex *output);
+void encodeSnorm16(const Vertex *vertices, size_t count, Snorm16Vertex *output);
+
+// IEEE 754 binary16 with round to nearest even, overflow goes to infinity.
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// Octahedral normal encoding (Meyer et al., "On Floating-Point Normal Vectors"): the unit sphere is projected onto an
+// octahedron and unfolded into a square, stored as two SNORM16 components in one uint32_t for a
+// VK_FORMAT_R16G16_SNORM attribute. The shader decodes with n = vec3(e, 1 - |e.x| - |e.y|); if n.z < 0 then
+// n.xy = (1 - |n.yx|) * sign(n.xy); n = normalize(n). Vertex has no normals yet, this is for meshes that do.
+void encodeOctahedral(const glm::vec3 *normals, size_t count, uint32_t *output);
+glm::vec3 decodeOctahedral(uint32_t encoded);
+// The attribute reading one encodeOctahedral output at offset.
+VkVertexInputAttributeDescription getOctahedralNormalAttributeDescription(uint32_t location, uint32_t binding,
+                                                                          uint32_t offset);
+} // namespace VertexFormats
\ No newline at end of file
@@ -1,10 +1,140 @@
 #include "VulkanTutorial.h"
-int main()
+
+ApplicationSettings parseArguments(int argc, char *argv[])
 {
-    HelloTriangleApplication app(800, 600);
+    ApplicationSettings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--headless")
+        {
+            settings.headless = true;
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            settings.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--resize-interval" && i + 1 < argc)
+        {
+            settings.resizeInterval = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--frames-in-flight" && i + 1 < argc)
+        {
+            settings.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--grid" && i + 1 < argc)
+        {
+            settings.meshGridSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--no-mesh-optimization")
+        {
+            settings.optimizeMesh = false;
+        }
+        else if (argument == "--pipeline-cache" && i + 1 < argc)
+        {
+            settings.pipelineCachePath = argv[++i];
+        }
+        else if (argument == "--device-cache" && i + 1 < argc)
+        {
+            settings.deviceCachePath = argv[++i];
+        }
+        else if (argument == "--assets" && i + 1 < argc)
+        {
+            settings.assetPackPath = argv[++i];
+        }
+        else if (argument == "--watch-shaders" && i + 1 < argc)
+        {
+            settings.shaderWatchPath = argv[++i];
+        }
+        else if (argument == "--secondary-command-buffers")
+        {
+            settings.useSecondaryCommandBuffers = true;
+        }
+        else if (argument == "--draws" && i + 1 < argc)
+        {
+            settings.drawCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            settings.recordingThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--gpu-culling")
+        {
+            settings.gpuCulling = true;
+        }
+        else if (argument == "--zoom" && i + 1 < argc)
+        {
+            settings.cameraZoom = std::stof(argv[++i]);
+        }
+        else if (argument == "--instances" && i + 1 < argc)
+        {
+            settings.instanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--object-uniforms")
+        {
+            settings.objectUniforms = true;
+        }
+        else if (argument == "--textures" && i + 1 < argc)
+        {
+            settings.textureDirectory = argv[++i];
+        }
+        else if (argument == "--vertex-format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "float")
+            {
+                settings.vertexFormat = VertexFormat::Float;
+            }
+            else if (format == "half")
+            {
+                settings.vertexFormat = VertexFormat::Half;
+            }
+            else if (format == "snorm16")
+            {
+                settings.vertexFormat = VertexFormat::Snorm16;
+            }
+            else
+            {
+                throw std::runtime_error("unknown vertex format: " + format);
+            }
+        }
+        else if (argument == "--post-process")
+        {
+            settings.postProcessing = true;
+        }
+        else if (argument == "--no-async-compute")
+        {
+            settings.asyncCompute = false;
+        }
+        else if (argument == "--gpu-profiler")
+        {
+            settings.gpuProfiling = true;
+        }
+        else if (argument == "--cpu-trace" && i + 1 < argc)
+        {
+#ifndef ENABLE_PROFILER
+            throw std::runtime_error("--cpu-trace needs a build configured with ENABLE_PROFILER");
+#else
+            settings.cpuTracePath = argv[++i];
+#endif
+        }
+        else if (argument == "--dump" && i + 1 < argc)
+        {
+            settings.dumpFramePath = argv[++i];
+        }
+        else
+        {
+            throw std::runtime_error("unknown argument: " + argument);
+        }
+    }
+    return settings;
+}
 
+int main(int argc, char *argv[])
+{
     try
     {
+        HelloTriangleApplication app(800, 600, parseArguments(argc, argv));
         app.run();
     }
     catch (const std::exception &e)
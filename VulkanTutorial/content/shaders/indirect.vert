@@ -0,0 +1,28 @@
+#version 450
+
+struct Object {
+    mat4 model;
+    vec4 boundingSphere;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint padding;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+layout(push_constant) uniform Camera {
+    mat4 viewProjection;
+};
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = viewProjection * objects[gl_InstanceIndex].model * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}
\ No newline at end of file
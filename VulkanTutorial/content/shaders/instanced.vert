@@ -0,0 +1,17 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// Per instance: offset in xy, scale in z, rotation in radians in w.
+layout(location = 2) in vec4 inTransform;
+layout(location = 3) in vec3 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    float s = sin(inTransform.w);
+    float c = cos(inTransform.w);
+    vec2 position = mat2(c, s, -s, c) * inPosition * inTransform.z + inTransform.xy;
+    gl_Position = vec4(position, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor;
+}
\ No newline at end of file
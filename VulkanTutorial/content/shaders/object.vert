@@ -0,0 +1,23 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform Frame {
+    mat4 viewProjection;
+};
+
+layout(set = 0, binding = 1) uniform Object {
+    mat4 model;
+};
+
+layout(push_constant) uniform Draw {
+    vec4 tint;
+};
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = viewProjection * model * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * tint.rgb;
+}
\ No newline at end of file
@@ -3,6 +3,14 @@
 layout(location = 0) out vec4 outColor;
 
 layout(location = 0) in vec3 fragColor;
+
+// Set when the colour attachment is UNORM, sRGB attachments encode on store.
+layout(constant_id = 0) const bool encodeSrgb = false;
+
+vec3 linearToSrgb(vec3 color) {
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, greaterThan(color, vec3(0.0031308)));
+}
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    outColor = vec4(encodeSrgb ? linearToSrgb(fragColor) : fragColor, 1.0);
 }
\ No newline at end of file
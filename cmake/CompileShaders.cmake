@@ -0,0 +1,60 @@
+# compile_shaders(<outputs variable> <source>...)
+#
+# Compiles GLSL sources to SPIR-V at build time. Each <name>.<stage> source becomes
+# ${CMAKE_CURRENT_BINARY_DIR}/compiled/shaders/<name>.<stage>.spv, optimised and stripped of debug info by spirv-opt
+# when it is installed, or by glslc's own optimiser otherwise. Next to them permutations.txt lists every
+# specialization constant the sources declare, one "<shader> <constant_id> <type> <name> <default>" line each, so the
+# runtime can pick variants with VkSpecializationInfo by name. The compiled directory is meant to be packed with
+# AssetPacker, which names the files shaders/<name>.<stage>.spv.
+#
+# The output files, manifest included, are stored in <outputs variable>.
+
+find_program(GLSLC_EXECUTABLE NAMES glslc HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin" REQUIRED)
+find_program(SPIRV_OPT_EXECUTABLE NAMES spirv-opt HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+
+function(compile_shaders OUTPUTS_VARIABLE)
+    set(OUTPUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/compiled/shaders)
+    # Kept out of OUTPUT_DIR, everything in there ends up in the pack.
+    set(INTERMEDIATE_DIR ${CMAKE_CURRENT_BINARY_DIR}/unoptimized_shaders)
+    set(OUTPUTS "")
+    set(MANIFEST "")
+    foreach(SOURCE ${ARGN})
+        get_filename_component(SOURCE_PATH ${SOURCE} ABSOLUTE)
+        get_filename_component(SOURCE_NAME ${SOURCE} NAME)
+        set(OUTPUT ${OUTPUT_DIR}/${SOURCE_NAME}.spv)
+        set(UNOPTIMIZED_OUTPUT ${INTERMEDIATE_DIR}/${SOURCE_NAME}.spv)
+
+        if(SPIRV_OPT_EXECUTABLE)
+            add_custom_command(
+                OUTPUT ${OUTPUT}
+                COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIR} ${INTERMEDIATE_DIR}
+                COMMAND ${GLSLC_EXECUTABLE} --target-env=vulkan1.2 -o ${UNOPTIMIZED_OUTPUT} ${SOURCE_PATH}
+                COMMAND ${SPIRV_OPT_EXECUTABLE} -O --strip-debug ${UNOPTIMIZED_OUTPUT} -o ${OUTPUT}
+                DEPENDS ${SOURCE_PATH}
+                COMMENT "Compiling ${SOURCE_NAME}")
+        else()
+            add_custom_command(
+                OUTPUT ${OUTPUT}
+                COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIR}
+                COMMAND ${GLSLC_EXECUTABLE} --target-env=vulkan1.2 -O -g0 -o ${OUTPUT} ${SOURCE_PATH}
+                DEPENDS ${SOURCE_PATH}
+                COMMENT "Compiling ${SOURCE_NAME}")
+        endif()
+        list(APPEND OUTPUTS ${OUTPUT})
+
+        # Specialization constants are read at configure time, editing a source configures again.
+        set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${SOURCE_PATH})
+        file(READ ${SOURCE_PATH} SOURCE_TEXT)
+        set(CONSTANT_PATTERN "constant_id *= *([0-9]+) *\\) *const +([A-Za-z0-9]+) +([A-Za-z0-9_]+) *= *([^; ]+)")
+        string(REGEX MATCHALL "${CONSTANT_PATTERN}" CONSTANTS "${SOURCE_TEXT}")
+        foreach(CONSTANT ${CONSTANTS})
+            string(REGEX REPLACE "${CONSTANT_PATTERN}" "shaders/${SOURCE_NAME}.spv \\1 \\2 \\3 \\4" LINE "${CONSTANT}")
+            string(APPEND MANIFEST "${LINE}\n")
+        endforeach()
+    endforeach()
+
+    # Only rewritten when the content changes, so the pack is not rebuilt on every configure.
+    file(CONFIGURE OUTPUT ${OUTPUT_DIR}/permutations.txt CONTENT "${MANIFEST}" @ONLY)
+    list(APPEND OUTPUTS ${OUTPUT_DIR}/permutations.txt)
+    set(${OUTPUTS_VARIABLE} ${OUTPUTS} PARENT_SCOPE)
+endfunction()
\ No newline at end of file